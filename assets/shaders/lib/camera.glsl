@@ -0,0 +1,12 @@
+// Shared by the terrain, depth and lighting programs, see
+// src/Camera/Camera.hpp.
+layout(std140, binding=1) uniform Camera {
+	mat4 view;
+	// Reverse-Z: depth 1 at the near plane, 0 at the far plane.
+	mat4 projection;
+	// Conventional projection of the whole image. Differs from projection
+	// in its depth mapping, and for poster tiles, whose lights and normals
+	// must still be placed as in the whole image.
+	mat4 frame_projection;
+	vec4 camera_position;
+};
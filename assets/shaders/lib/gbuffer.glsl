@@ -0,0 +1,30 @@
+// Packed G-buffer normal: a hemi-octahedral encoding of the unit normal,
+// 7 bits per axis, and 2 material bits in one 16-bit unsigned integer.
+// Lighting only uses the side of a surface facing the camera (negative z
+// in view space), so normals are folded onto that hemisphere, which
+// doubles the precision of a full octahedral encoding; the worst case
+// error is about a degree.
+
+const uint material_land = 0u;
+const uint material_water = 1u;
+
+uint pack_normal(vec3 n, uint material)
+{
+	n.z = -abs(n.z);
+	vec2 p = n.xy / (abs(n.x) + abs(n.y) + abs(n.z));
+	// The octahedron's lower half rotated by 45 degrees fills the square.
+	uvec2 q = uvec2(round(clamp(vec2(p.x + p.y, p.x - p.y)*0.5 + 0.5, 0.0, 1.0) * 127.0));
+	return q.x | (q.y << 7) | (material << 14);
+}
+
+vec3 unpack_normal(uint packed)
+{
+	vec2 e = vec2(packed & 127u, (packed >> 7) & 127u) / 127.0 * 2.0 - 1.0;
+	vec2 p = vec2(e.x + e.y, e.x - e.y) * 0.5;
+	return normalize(vec3(p, abs(p.x) + abs(p.y) - 1.0));
+}
+
+uint unpack_material(uint packed)
+{
+	return packed >> 14;
+}
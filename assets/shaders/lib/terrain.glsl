@@ -0,0 +1,40 @@
+// The terrain height function, shared by the terrain programs and the
+// horizon maps. src/Terrain/Terrain.cpp ports it to the CPU; the two have
+// to be changed together.
+
+#include "noise.glsl"
+
+const float terrain_reverse_period = 0.001;
+const float terrain_multiplier = 100.0;
+const float terrain_water_level = 0.0;
+
+float anoise_(vec2 P) {
+	return snoise(P);
+}
+
+float anoise(vec2 P) {
+	// float mountain = anoise_(P*0.125);
+	float land = anoise_(P*2.12124);
+	return (
+		anoise_(P) +
+		anoise_(P*2.22123135)/2.0 +
+		anoise_(P*3.14159)/4.0 +
+		anoise_(P*8.2545734565225)/8.0 +
+		anoise_(P*16.21231235)/16.0 +
+		anoise_(P*32.25123987)/32.0 +
+		anoise_(P*64.123123523425)/64.0 +
+		// anoise_(P*128.25)/128.0 +
+		// anoise_(P*256.25)/256.0 +
+		// anoise_(P*512.25)/512.0 +
+		// anoise_(P*1024.25)/1024.0 +
+		sign(land) * pow(abs(pow(abs(land), 3.0))*2.0, 3.0) +
+		// sign(mountain) * pow(abs(pow(abs(mountain), 100))*50.0, 7.0) +
+		0.0
+	) / 6.0;
+}
+
+// Ground height at a terrain position, before water is drawn over it.
+float terrain_height(vec2 position) {
+	float height = anoise(position*terrain_reverse_period)*terrain_multiplier;
+	return height < terrain_water_level ? height*10.0 : height;
+}
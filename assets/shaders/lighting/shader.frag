@@ -7,15 +7,30 @@
 in vec2 vTexcoords;
 in mat4 inverseProjection;
 in mat4 proj;
+in mat4 inverseView;
 
-uniform sampler2D normalsTex;
+uniform usampler2D normalsTex;
 uniform sampler2D colorTex;
 uniform sampler2D depthTex;
 uniform float intensity = 0.91;
 uniform float bias = 0.21;
 uniform float scale = 0.27;
 uniform float sample_radius = 0.20;
-uniform mat4  view;
+
+// Poster tiles render part of a larger image; the defaults describe a
+// whole frame.
+// The viewport as offset and size in texcoords of the whole image.
+uniform vec4 image_rect = vec4(0.0, 0.0, 1.0, 1.0);
+// The viewport's share of the G-buffer textures.
+uniform vec2 viewport_scale = vec2(1.0);
+// Largest SSAO sample offset in texcoords of the viewport, the tile apron.
+uniform vec2 max_sample_offset = vec2(1e6);
+
+// Straight to the window instead of into the lit frame: each pixel shades
+// the G-buffer texels a bilinear fetch from the lit frame would have
+// blended and blends them itself, background where nothing was drawn.
+uniform bool resolve = false;
+uniform vec3 background;
 
 struct Light {
 	vec4 position;
@@ -30,8 +45,43 @@ layout(std140, binding=0) uniform Lights {
 	Light lights[MAX_LIGHTS];
 };
 
+// Towards the sun, in terrain space.
+uniform vec3 sun_direction = vec3(-0.66, 0.66, 0.34);
+uniform vec3 sun_color = vec3(0.9, 0.85, 0.75);
+uniform vec3 sky_color = vec3(0.2, 0.24, 0.3);
+
+// Horizon maps of the regions around the camera, see
+// src/Horizon/HorizonMaps.hpp and horizon/shader.comp.
+layout(std140, binding=2) uniform Horizons {
+	// First region of the window, regions per window side, atlas slots per
+	// atlas side.
+	ivec4 horizon_window;
+	// Region size in terrain units, atlas texels per side, texels per slot
+	// side.
+	vec4 horizon_params;
+	// Atlas slot of each window region, row by row, -1 while not built.
+	ivec4 horizon_slots[16];
+};
+layout(binding=9) uniform sampler2D horizonsLow;
+layout(binding=10) uniform sampler2D horizonsHigh;
+
+// Cascaded sun shadow maps, see src/Shadow/ShadowCascades.hpp.
+layout(std140, binding=3) uniform Shadows {
+	// Terrain position to atlas texcoords and depth, nearest cascade first.
+	mat4 shadow_matrices[4];
+	// Where each cascade may be sampled in the atlas, empty while it has
+	// not been rendered.
+	vec4 shadow_rects[4];
+	vec4 shadow_bias;
+	int shadow_cascades;
+};
+layout(binding=12) uniform sampler2DShadow shadowMap;
+
 out vec4 outCol;
 
+#include "../lib/gbuffer.glsl"
+#include "../lib/camera.glsl"
+
 //Taken from http://byteblacksmith.com/improvements-to-the-canonical-one-liner-glsl-rand-for-opengl-es-2-0/
 highp float rand(vec2 co)
 {
@@ -46,7 +96,8 @@ highp float rand(vec2 co)
 vec4 depth_to_world(vec2 screenspace, float depth) {
 	vec4 position;
 	position.xy = screenspace;
-	position.z  = depth*2.0-1.0;
+	// Reverse-Z with glClipControl(GL_ZERO_TO_ONE): depth is NDC z.
+	position.z  = depth;
 	position.w  = 1.0;
 	position = inverseProjection * position;
 	position /= position.w;
@@ -54,9 +105,67 @@ vec4 depth_to_world(vec2 screenspace, float depth) {
 	return position;
 }
 
+vec4 gbuffer(sampler2D tex, vec2 uv)
+{
+	return texture(tex, uv*viewport_scale);
+}
+
+uint gbuffer_normal(vec2 uv)
+{
+	ivec2 size = textureSize(normalsTex, 0);
+	return texelFetch(normalsTex, clamp(ivec2(uv*viewport_scale*size), ivec2(0), size-1), 0).r;
+}
+
 vec3 get_position(vec2 uv)
 {
-	return depth_to_world(uv*2.0-1.0, texture(depthTex, uv).r).xyz;
+	return depth_to_world(uv*2.0-1.0, gbuffer(depthTex, uv).r).xyz;
+}
+
+// Sample offsets are chosen in texcoords of the whole image so tiles match
+// the whole frame.
+vec2 to_viewport(vec2 offset)
+{
+	return clamp(offset/image_rect.zw, -max_sample_offset, max_sample_offset);
+}
+
+// Horizon sines of the eight azimuths at a terrain position, false where
+// its region is not built.
+bool get_horizons(vec2 position, out float horizons[8])
+{
+	vec2 region = position/horizon_params.x;
+	ivec2 cell = ivec2(floor(region)) - horizon_window.xy;
+	if(any(lessThan(cell, ivec2(0))) || any(greaterThanEqual(cell, horizon_window.zz)))
+		return false;
+	int index = cell.y*horizon_window.z + cell.x;
+	int slot = horizon_slots[index/4][index%4];
+	if(slot < 0)
+		return false;
+	// Slots hold the region's edge texels too, so filtering stays inside.
+	vec2 texel = vec2(slot % horizon_window.w, slot / horizon_window.w)*horizon_params.z +
+		fract(region)*(horizon_params.z - 1.0) + 0.5;
+	vec4 low = textureLod(horizonsLow, texel/horizon_params.y, 0.0);
+	vec4 high = textureLod(horizonsHigh, texel/horizon_params.y, 0.0);
+	horizons = float[8](low.x, low.y, low.z, low.w, high.x, high.y, high.z, high.w);
+	return true;
+}
+
+// How much of the sun reaches a terrain position, from the nearest
+// cascade that covers it; 1 outside all of them.
+float get_sun_shadow(vec3 position)
+{
+	vec2 texel = 1.0/vec2(textureSize(shadowMap, 0));
+	for(int i = 0; i < shadow_cascades; ++i) {
+		vec3 coords = (shadow_matrices[i]*vec4(position, 1.0)).xyz;
+		if(any(lessThan(coords.xy, shadow_rects[i].xy)) || any(greaterThan(coords.xy, shadow_rects[i].zw)) ||
+				coords.z < 0.0 || coords.z > 1.0)
+			continue;
+		float lit = 0.0;
+		for(int y = -1; y <= 1; ++y)
+			for(int x = -1; x <= 1; ++x)
+				lit += texture(shadowMap, vec3(coords.xy + vec2(x, y)*texel, coords.z + shadow_bias[i]));
+		return lit/9.0;
+	}
+	return 1.0;
 }
 
 vec2 get_random(vec2 uv)
@@ -73,25 +182,23 @@ float calc_ao(vec2 tcoord,vec2 uv, vec3 p, vec3 cnorm)
 }
 
 
-void main()
+// False for empty texels.
+bool shade(vec2 uv, out vec4 color)
 {
-	// Discard empty fragments
-	float depth = texture(depthTex, vTexcoords).r;
-	if(depth >= 0.9999999) {
-		discard;
-	}
+	// Depth clears to 0, the far plane.
+	float depth = gbuffer(depthTex, uv).r;
+	if(depth <= 0.0)
+		return false;
 
 	vec3 Position;
-	vec4 position = depth_to_world(vTexcoords.xy * 2.0 - 1.0, depth);
+	vec4 position = depth_to_world(uv * 2.0 - 1.0, depth);
 	Position = position.xyz;
 
-	// Get normal Z from X and Y
-	vec3 Normal = vec3(texture(normalsTex, vTexcoords));
-	Normal.z = -sqrt(1-(Normal.x*Normal.x + Normal.y*Normal.y));
+	vec3 Normal = unpack_normal(gbuffer_normal(uv));
 
 	const vec2 vec[8] = {vec2(1,0),vec2(-1,0), vec2(0,1),vec2(0,-1), vec2(0.5,0.5), vec2(0.5,-0.5), vec2(-0.5,0.5), vec2(-0.5,-0.5)};
 
-	vec2 r = get_random(vTexcoords);
+	vec2 r = get_random(image_rect.xy + uv*image_rect.zw);
 
 	float ao = 0.0f;
 	float rad = sample_radius/sqrt(abs(Position.z));
@@ -101,10 +208,12 @@ void main()
 	{
 		vec2 coord1 = reflect(vec[j],r)*rad;
 		vec2 coord2 = vec2(coord1.x*0.707 - coord1.y*0.707, coord1.x*0.707 + coord1.y*0.707);
-		ao += calc_ao(vTexcoords,coord1*0.25, Position, Normal);
-		ao += calc_ao(vTexcoords,coord2*0.5, Position, Normal);
-		ao += calc_ao(vTexcoords,coord1*0.75, Position, Normal);
-		ao += calc_ao(vTexcoords,coord2, Position, Normal);
+		coord1 = to_viewport(coord1);
+		coord2 = to_viewport(coord2);
+		ao += calc_ao(uv,coord1*0.25, Position, Normal);
+		ao += calc_ao(uv,coord2*0.5, Position, Normal);
+		ao += calc_ao(uv,coord1*0.75, Position, Normal);
+		ao += calc_ao(uv,coord2, Position, Normal);
 	}
 	ao /= iterations*4.0;
 
@@ -129,9 +238,63 @@ void main()
 		light_color += brightness * lights[i].color.rgb * clamp(fade, 0.0, 1.0);
 	}
 
+	// The sun is hidden where it is lower than the horizon towards it, and
+	// the sky is seen through whatever the horizons leave open. Regions
+	// still being built are lit as if open.
+	float sun_visible = 1.0;
+	float sky_visible = 1.0;
+	float horizons[8];
+	vec3 terrain_position = (inverseView*vec4(Position.xy, -Position.z, 1.0)).xyz;
+	if(get_horizons(terrain_position.xy, horizons)) {
+		float azimuth = mod(atan(sun_direction.y, sun_direction.x)*(4.0/3.14159265), 8.0);
+		int a = int(azimuth) % 8;
+		float horizon = mix(horizons[a], horizons[(a+1) % 8], fract(azimuth));
+		sun_visible = smoothstep(-0.02, 0.02, sun_direction.z - horizon);
+		sky_visible = 0.0;
+		for(int i = 0; i < 8; ++i)
+			sky_visible += 1.0 - horizons[i];
+		sky_visible /= 8.0;
+	}
+	vec3 toSun = normalize(mat3(proj*view)*sun_direction);
+	float sun_brightness = clamp(dot(Normal, toSun), 0.0, 1.0) * sun_visible;
+	// Shadow maps for what the horizons are too coarse for.
+	if(sun_brightness > 0.0)
+		sun_brightness *= get_sun_shadow(terrain_position);
+	light_color += sun_color * sun_brightness;
+	light_color += sky_color * sky_visible;
+
 	// Mix colors
-	outCol = texture(colorTex, vTexcoords);
-	outCol.rgb *= 1.0-ao;
-	outCol.rgb *= light_color;
-	outCol.a = 1.0;
+	color = gbuffer(colorTex, uv);
+	color.rgb *= 1.0-ao;
+	color.rgb *= light_color;
+	color.a = 1.0;
+	return true;
+}
+
+vec4 shade_or_background(vec2 uv)
+{
+	vec4 color;
+	if(!shade(uv, color))
+		color = vec4(background, 1.0);
+	return color;
+}
+
+void main()
+{
+	if(!resolve) {
+		// Empty fragments keep the clear colour.
+		if(!shade(vTexcoords, outCol))
+			discard;
+		return;
+	}
+
+	vec2 size = vec2(textureSize(depthTex, 0))*viewport_scale;
+	vec2 t = vTexcoords*size - 0.5;
+	vec2 base = clamp(floor(t), vec2(0.0), size - 2.0);
+	vec2 f = clamp(t - base, 0.0, 1.0);
+	vec4 c00 = shade_or_background((base + vec2(0.5, 0.5))/size);
+	vec4 c10 = shade_or_background((base + vec2(1.5, 0.5))/size);
+	vec4 c01 = shade_or_background((base + vec2(0.5, 1.5))/size);
+	vec4 c11 = shade_or_background((base + vec2(1.5, 1.5))/size);
+	outCol = mix(mix(c00, c10, f.x), mix(c01, c11, f.x), f.y);
 }
@@ -0,0 +1,45 @@
+#version 430
+
+out vec4 color;
+in vec2 vTexcoords;
+
+// Recent frame times in milliseconds, oldest first. Row 0 is CPU time,
+// row 1 GPU time, row 2 the present interval.
+uniform sampler2D samples;
+// Milliseconds at the top of the graph.
+uniform float range_ms = 50.0;
+// Hitch thresholds in milliseconds, unused ones are 0.
+uniform vec4 hitch_ms = vec4(0.0);
+// Rolling p50 and p99 of the CPU frame time in milliseconds.
+uniform vec2 percentiles_ms = vec2(0.0);
+
+bool on_line(float ms, float y, float pixel)
+{
+	return ms > 0.0 && abs(ms/range_ms - y) < pixel;
+}
+
+void main()
+{
+	int width = textureSize(samples, 0).x;
+	int column = min(int(vTexcoords.x*width), width-1);
+	float cpu = texelFetch(samples, ivec2(column, 0), 0).r/range_ms;
+	float gpu = texelFetch(samples, ivec2(column, 1), 0).r/range_ms;
+	float present = texelFetch(samples, ivec2(column, 2), 0).r/range_ms;
+	float y = vTexcoords.y;
+	float pixel = fwidth(y);
+
+	color = vec4(0.0, 0.0, 0.0, 0.5);
+	if(y < cpu)
+		color = vec4(0.2, 0.8, 0.3, 0.85);
+	if(y < gpu)
+		color = mix(color, vec4(1.0, 0.55, 0.1, 1.0), 0.6);
+	for(int i=0;i<4;++i)
+		if(on_line(hitch_ms[i], y, pixel))
+			color = vec4(0.9, 0.1, 0.1, 1.0);
+	if(on_line(percentiles_ms.x, y, pixel))
+		color = vec4(0.2, 0.7, 1.0, 1.0);
+	if(on_line(percentiles_ms.y, y, pixel))
+		color = vec4(1.0, 0.3, 1.0, 1.0);
+	if(abs(present - y) < pixel)
+		color = vec4(1.0);
+}
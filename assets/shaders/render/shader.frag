@@ -1,19 +1,25 @@
 #version 430
 
 // layout(depth_unchanged) out float gl_FragDepth;
-// layout(early_fragment_tests) in;
+// Nothing here discards or writes depth, so testing first never changes
+// the result, and after a depth pre-pass only visible fragments run.
+layout(early_fragment_tests) in;
 
 in vec3 gNormal;
 in vec3 gTexcoords;
 in vec4 col;
-out vec4 outNormal;
+out uint outNormal;
 out vec4 outColor;
 
+uniform int draw_water;
+
 // uniform sampler2DArray spritesheet;
 
+#include "../lib/gbuffer.glsl"
+
 void main()
 {
-	outNormal = vec4(gNormal, 1.0);
+	outNormal = pack_normal(gNormal, draw_water == 1 ? material_water : material_land);
 	// outColor = texture(spritesheet, vTexcoords);
 	// outColor = vec4(1.0, 0.0, 0.0, 1.0);
 	outColor = col;
@@ -3,8 +3,6 @@
 layout(location=4) in vec3 pos;
 layout(location=1) in vec3 normal;
 layout(location=2) in vec3 texcoords;
-uniform mat4 view;
-uniform mat4 projection;
 uniform mat4 model;
 out vec3 vNormal;
 out vec3 vTexcoords;
@@ -12,10 +10,22 @@ out mat4 trans;
 out mat3 normaltrans;
 out vec3 vPosition;
 
+#include "../lib/camera.glsl"
+
+#ifdef SHADOW
+// The sun's view of a shadow cascade, see src/Shadow/ShadowCascades.hpp.
+uniform mat4 shadow_view_projection;
+#endif
+
 void main()
 {
+#ifdef SHADOW
+	trans = shadow_view_projection;
+#else
 	trans = projection*view;//*model;
-	normaltrans = transpose(inverse(mat3(trans)));
+#endif
+	// Normals must not depend on which poster tile is being rendered.
+	normaltrans = transpose(inverse(mat3(frame_projection*view)));
 	vTexcoords = texcoords;
 	gl_Position = vec4(pos, 1.0);
 	vPosition = vec3(gl_Position);
@@ -0,0 +1,315 @@
+#include <Asset/Asset.hpp>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char pack_magic[4] = {'I', 'T', 'A', 'P'};
+const uint32_t pack_version = 1;
+
+struct PackHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t count;
+	uint32_t reserved;
+};
+
+struct PackEntry {
+	uint64_t path_offset;
+	uint64_t path_size;
+	uint64_t data_offset;
+	uint64_t data_size;
+};
+
+uint64_t align16(uint64_t offset)
+{
+	return (offset + 15) & ~uint64_t(15);
+}
+
+}
+
+std::string normalize_path(const std::string &path)
+{
+	bool absolute = !path.empty() && path[0] == '/';
+	std::vector<std::string> parts;
+	std::string::size_type pos = 0;
+	while(pos <= path.size()) {
+		std::string::size_type next = path.find_first_of("/\\", pos);
+		if(next == std::string::npos)
+			next = path.size();
+		std::string part = path.substr(pos, next-pos);
+		if(part == "..") {
+			if(!parts.empty() && parts.back() != "..")
+				parts.pop_back();
+			else if(!absolute)
+				parts.push_back(part);
+		}
+		else if(!part.empty() && part != ".") {
+			parts.push_back(part);
+		}
+		pos = next+1;
+	}
+	std::string out = absolute ? "/" : "";
+	for(unsigned int i=0;i<parts.size();++i)
+		out += (i ? "/" : "") + parts[i];
+	return out.empty() ? "." : out;
+}
+
+bool MappedFile::open(const std::string &path) {
+	close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		return false;
+	}
+	m_file = file;
+	m_size = size.QuadPart;
+	if(m_size == 0) {
+		m_data = "";
+		return true;
+	}
+	m_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(!m_mapping) {
+		close();
+		return false;
+	}
+	m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if(!m_data) {
+		close();
+		return false;
+	}
+	return true;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return false;
+	struct stat st;
+	if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		::close(fd);
+		return false;
+	}
+	m_size = st.st_size;
+	if(m_size == 0) {
+		::close(fd);
+		m_data = "";
+		return true;
+	}
+	void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps the file referenced, the descriptor is not needed.
+	::close(fd);
+	if(data == MAP_FAILED) {
+		m_size = 0;
+		return false;
+	}
+	m_data = static_cast<const char*>(data);
+	return true;
+#endif
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+	if(m_data && m_size)
+		UnmapViewOfFile(m_data);
+	if(m_mapping)
+		CloseHandle(m_mapping);
+	if(m_file)
+		CloseHandle(m_file);
+	m_file = nullptr;
+	m_mapping = nullptr;
+#else
+	if(m_data && m_size)
+		munmap(const_cast<char*>(m_data), m_size);
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
+
+std::string_view MappedFile::data() const {
+	return {m_data, m_size};
+}
+
+MappedFile::operator bool() const {
+	return m_data != nullptr;
+}
+
+MappedFile::MappedFile():
+	m_data{nullptr},
+	m_size{0}
+#ifdef _WIN32
+	,m_file{nullptr},
+	m_mapping{nullptr}
+#endif
+{;}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+std::string_view Asset::data() const {
+	return m_data;
+}
+
+Asset::operator bool() const {
+	return m_file != nullptr;
+}
+
+Asset::Asset() {;}
+
+Asset::Asset(std::shared_ptr<const MappedFile> file, std::string_view data):
+	m_file{std::move(file)},
+	m_data{data}
+{;}
+
+bool AssetPack::open(const std::string &path) {
+	m_index.clear();
+	m_file = std::make_shared<MappedFile>();
+	if(!m_file->open(path))
+		return false;
+
+	std::string_view data = m_file->data();
+	PackHeader header;
+	if(data.size() < sizeof(header))
+		return false;
+	std::memcpy(&header, data.data(), sizeof(header));
+	if(std::memcmp(header.magic, pack_magic, sizeof(pack_magic)) != 0
+	|| header.version != pack_version
+	|| header.count > (data.size()-sizeof(header))/sizeof(PackEntry))
+		return false;
+
+	const char *entries = data.data() + sizeof(header);
+	for(uint32_t i=0;i<header.count;++i) {
+		PackEntry entry;
+		std::memcpy(&entry, entries + i*sizeof(PackEntry), sizeof(entry));
+		if(entry.path_offset > data.size() || entry.path_size > data.size()-entry.path_offset
+		|| entry.data_offset > data.size() || entry.data_size > data.size()-entry.data_offset) {
+			m_index.clear();
+			return false;
+		}
+		m_index.emplace(
+			data.substr(entry.path_offset, entry.path_size),
+			data.substr(entry.data_offset, entry.data_size)
+		);
+	}
+	return true;
+}
+
+Asset AssetPack::find(std::string_view path) const {
+	auto entry = m_index.find(path);
+	if(entry == m_index.end())
+		return {};
+	return {m_file, entry->second};
+}
+
+size_t AssetPack::size() const {
+	return m_index.size();
+}
+
+bool AssetPack::write(const std::string &path, const std::vector<std::string> &files, std::string &error) {
+	std::vector<std::string> paths;
+	std::vector<std::shared_ptr<MappedFile>> contents;
+	for(auto &file : files) {
+		auto mapped = std::make_shared<MappedFile>();
+		if(!mapped->open(file)) {
+			error = "Could not read " + file;
+			return false;
+		}
+		paths.push_back(normalize_path(file));
+		contents.push_back(mapped);
+	}
+
+	PackHeader header;
+	std::memcpy(header.magic, pack_magic, sizeof(pack_magic));
+	header.version = pack_version;
+	header.count = files.size();
+	header.reserved = 0;
+
+	std::vector<PackEntry> entries(files.size());
+	uint64_t offset = sizeof(header) + entries.size()*sizeof(PackEntry);
+	for(unsigned int i=0;i<entries.size();++i) {
+		entries[i].path_offset = offset;
+		entries[i].path_size = paths[i].size();
+		offset += paths[i].size();
+	}
+	for(unsigned int i=0;i<entries.size();++i) {
+		offset = align16(offset);
+		entries[i].data_offset = offset;
+		entries[i].data_size = contents[i]->data().size();
+		offset += entries[i].data_size;
+	}
+
+	std::ofstream f(path, std::ios::binary | std::ios::trunc);
+	if(!f.good()) {
+		error = "Could not write " + path;
+		return false;
+	}
+	f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	f.write(reinterpret_cast<const char*>(entries.data()), entries.size()*sizeof(PackEntry));
+	for(auto &p : paths)
+		f.write(p.data(), p.size());
+	for(unsigned int i=0;i<entries.size();++i) {
+		static const char zeros[16] = {};
+		f.write(zeros, entries[i].data_offset - f.tellp());
+		f.write(contents[i]->data().data(), contents[i]->data().size());
+	}
+	if(!f.good()) {
+		error = "Could not write " + path;
+		return false;
+	}
+	return true;
+}
+
+bool AssetStore::open_pack(const std::string &path) {
+	m_has_pack = m_pack.open(path);
+	return m_has_pack;
+}
+
+bool AssetStore::has_pack() const {
+	return m_has_pack;
+}
+
+Asset AssetStore::get(const std::string &path) {
+	auto start = std::chrono::high_resolution_clock::now();
+	std::string normalized = normalize_path(path);
+
+	Asset asset;
+	auto file = std::make_shared<MappedFile>();
+	if(file->open(normalized))
+		asset = Asset(file, file->data());
+	else if(m_has_pack)
+		asset = m_pack.find(normalized);
+
+	if(asset) {
+		++m_stats.files;
+		m_stats.bytes += asset.data().size();
+	}
+	m_stats.io_us += std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::high_resolution_clock::now()-start
+	).count();
+	return asset;
+}
+
+const AssetStats &AssetStore::stats() const {
+	return m_stats;
+}
+
+void AssetStore::reset_stats() {
+	m_stats = AssetStats{0, 0, 0};
+}
+
+AssetStore::AssetStore():
+	m_has_pack{false},
+	m_stats{0, 0, 0}
+{;}
@@ -0,0 +1,94 @@
+#ifndef ASSET_HEADER
+#define ASSET_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Read-only memory mapping of a whole file.
+class MappedFile
+{
+private:
+	const char *m_data;
+	size_t m_size;
+#ifdef _WIN32
+	void *m_file;
+	void *m_mapping;
+#endif
+public:
+	bool open(const std::string &path);
+	void close();
+	std::string_view data() const;
+	explicit operator bool() const;
+
+	MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile &operator=(const MappedFile&) = delete;
+	~MappedFile();
+};
+
+// The bytes of one asset, pointing straight into a mapping. The view stays
+// valid for as long as any copy of the Asset is alive.
+class Asset
+{
+private:
+	std::shared_ptr<const MappedFile> m_file;
+	std::string_view m_data;
+public:
+	std::string_view data() const;
+	explicit operator bool() const;
+
+	Asset();
+	Asset(std::shared_ptr<const MappedFile> file, std::string_view data);
+};
+
+// A single archive of assets with an index at the front:
+//   PackHeader, PackEntry[count], path strings, 16-byte aligned file data.
+// All offsets are relative to the start of the file.
+class AssetPack
+{
+private:
+	std::shared_ptr<MappedFile> m_file;
+	std::unordered_map<std::string_view, std::string_view> m_index;
+public:
+	bool open(const std::string &path);
+	Asset find(std::string_view path) const;
+	size_t size() const;
+
+	// Packs files (stored under their normalized paths) into a new archive.
+	static bool write(const std::string &path, const std::vector<std::string> &files, std::string &error);
+};
+
+struct AssetStats {
+	unsigned files;
+	uint64_t bytes;
+	long long io_us;
+};
+
+// Resolves asset paths to loose files first, so edits are picked up on the
+// next load, then to the pack if one is open.
+class AssetStore
+{
+private:
+	AssetPack m_pack;
+	bool m_has_pack;
+	AssetStats m_stats;
+public:
+	bool open_pack(const std::string &path);
+	bool has_pack() const;
+	Asset get(const std::string &path);
+
+	const AssetStats &stats() const;
+	void reset_stats();
+
+	AssetStore();
+};
+
+// Collapses "." and ".." components and duplicate separators.
+std::string normalize_path(const std::string &path);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef CAMERA_HPP
+#define CAMERA_HPP
+
+#include <glm/glm.hpp>
+#include <cmath>
+
+// The Camera uniform block (binding 1) shared by the terrain, depth and
+// lighting programs, see assets/shaders/lib/camera.glsl.
+struct CameraBlock {
+	glm::mat4 view;
+	// Reverse-Z, for rendering and depth reconstruction.
+	glm::mat4 projection;
+	// Conventional projection of the whole image. Lights and normals are
+	// placed with it, so they neither depend on the poster tile nor on the
+	// depth mapping.
+	glm::mat4 frame_projection;
+	glm::vec4 camera_position;
+};
+
+// Reverse-Z projections for glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE):
+// the near plane maps to depth 1 and the far plane to 0, which spreads
+// float depth precision evenly over distance. Depth clears to 0 and tests
+// with GL_GREATER.
+
+inline glm::mat4 reverse_z_frustum(float left, float right, float bottom, float top, float z_near, float z_far)
+{
+	glm::mat4 m(0.f);
+	m[0][0] = 2.f*z_near/(right-left);
+	m[1][1] = 2.f*z_near/(top-bottom);
+	m[2][0] = (right+left)/(right-left);
+	m[2][1] = (top+bottom)/(top-bottom);
+	m[2][2] = z_near/(z_far-z_near);
+	m[2][3] = -1.f;
+	m[3][2] = z_far*z_near/(z_far-z_near);
+	return m;
+}
+
+inline glm::mat4 reverse_z_perspective(float fovy, float aspect, float z_near, float z_far)
+{
+	float top = z_near*std::tan(fovy/2.f);
+	return reverse_z_frustum(-top*aspect, top*aspect, -top, top, z_near, z_far);
+}
+
+inline glm::mat4 reverse_z_ortho(float left, float right, float bottom, float top, float z_near, float z_far)
+{
+	glm::mat4 m(1.f);
+	m[0][0] = 2.f/(right-left);
+	m[1][1] = 2.f/(top-bottom);
+	m[2][2] = 1.f/(z_far-z_near);
+	m[3][0] = -(right+left)/(right-left);
+	m[3][1] = -(top+bottom)/(top-bottom);
+	m[3][2] = z_far/(z_far-z_near);
+	return m;
+}
+
+#endif
@@ -0,0 +1,229 @@
+#include <GL/glew.h>
+#include <Capture/Capture.hpp>
+#include <Image/Image.hpp>
+#include <PngWriter/PngWriter.hpp>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+// Raw YUV4MPEG2 stream. Frames may be converted on any thread in any order,
+// write() blocks until it is the frame's turn.
+class Y4mStream
+{
+private:
+	std::FILE *m_file;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	unsigned long long m_next;
+	int m_width;
+	int m_height;
+public:
+	bool open(const std::string &path, int width, int height, int fps) {
+		m_width = width;
+		m_height = height;
+		m_file = std::fopen(path.c_str(), "wb");
+		if(!m_file)
+			return false;
+		return std::fprintf(m_file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps) > 0;
+	}
+
+	bool write(unsigned long long frame, const uint8_t *rgba) {
+		size_t luma = static_cast<size_t>(m_width)*m_height;
+		std::vector<uint8_t> yuv(luma + luma/2);
+		rgba_to_i420(rgba, m_width, m_height, yuv.data(), yuv.data()+luma, yuv.data()+luma+luma/4);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cv.wait(lock, [&]{return m_next == frame;});
+		bool ok = std::fputs("FRAME\n", m_file) >= 0
+		       && std::fwrite(yuv.data(), 1, yuv.size(), m_file) == yuv.size();
+		++m_next;
+		m_cv.notify_all();
+		return ok;
+	}
+
+	Y4mStream():
+		m_file{nullptr},
+		m_next{0},
+		m_width{0},
+		m_height{0}
+	{;}
+
+	~Y4mStream() {
+		if(m_file)
+			std::fclose(m_file);
+	}
+};
+
+namespace {
+
+// Frames are already encoded in parallel, one per encoder thread, so each
+// one is written inline and as cheaply as possible.
+PngSettings png_settings()
+{
+	PngSettings settings;
+	settings.filter = PngFilter::none;
+	settings.level = 1;
+	return settings;
+}
+
+std::string frame_path(const std::string &directory, unsigned long long frame, const char *extension)
+{
+	char name[64];
+	std::snprintf(name, sizeof(name), "/frame_%06llu.%s", frame, extension);
+	return directory + name;
+}
+
+}
+
+bool parse_capture_format(const std::string &name, Capture::Format &format)
+{
+	if(name == "png")
+		format = Capture::Format::png;
+	else if(name == "qoi")
+		format = Capture::Format::qoi;
+	else if(name == "y4m")
+		format = Capture::Format::y4m;
+	else
+		return false;
+	return true;
+}
+
+void Capture::dispatch(Readback &readback, unsigned long long frame) {
+	Format format = m_format;
+	std::string directory = m_directory;
+	std::shared_ptr<Y4mStream> y4m = m_y4m;
+	++m_encoding;
+	m_jobs.spawn([this, &readback, frame, format, directory, y4m]{
+		int width = readback.width(), height = readback.height();
+		std::vector<uint8_t> pixels(readback.size());
+		flip_rows(readback.data(), pixels.data(), static_cast<size_t>(width)*4, height);
+		readback.release();
+
+		bool ok = false;
+		switch(format) {
+			case Format::png:
+				ok = write_png(frame_path(directory, frame, "png"), width, height, 4, pixels.data(), png_settings());
+				break;
+			case Format::qoi:
+				ok = write_qoi(frame_path(directory, frame, "qoi"), width, height, pixels.data());
+				break;
+			case Format::y4m:
+				ok = y4m->write(frame, pixels.data());
+				break;
+		}
+		++(ok ? m_encoded : m_failed);
+		--m_encoding;
+	});
+}
+
+void Capture::poll() {
+	// Readbacks complete in submission order, so only the front can be ready.
+	while(!m_in_flight.empty() && m_in_flight.front().first->ready()) {
+		dispatch(*m_in_flight.front().first, m_in_flight.front().second);
+		m_in_flight.pop_front();
+	}
+}
+
+bool Capture::start(std::string directory, Format format, int fps, int width, int height, std::string &error) {
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+	if(ec) {
+		error = "Could not create " + directory + ": " + ec.message();
+		return false;
+	}
+
+	m_y4m.reset();
+	if(format == Format::y4m) {
+		m_y4m = std::make_shared<Y4mStream>();
+		if(!m_y4m->open(directory + "/capture.y4m", width, height, fps)) {
+			error = "Could not open " + directory + "/capture.y4m";
+			m_y4m.reset();
+			return false;
+		}
+	}
+
+	m_directory = std::move(directory);
+	m_format = format;
+	m_fps = fps;
+	m_frame = 0;
+	m_encoded = 0;
+	m_failed = 0;
+	m_stalled_frames = 0;
+	m_stall_us = 0;
+	m_recording = true;
+	return true;
+}
+
+void Capture::stop() {
+	m_recording = false;
+	// In-flight encodes hold their own reference, the file closes after the
+	// last frame is written.
+	m_y4m.reset();
+}
+
+bool Capture::recording() {
+	return m_recording;
+}
+
+bool Capture::busy() {
+	return !m_in_flight.empty() || m_encoding > 0;
+}
+
+float Capture::timestep() {
+	return 1.f/m_fps;
+}
+
+const std::string &Capture::directory() {
+	return m_directory;
+}
+
+void Capture::update(GLuint texture, int width, int height, bool drawn) {
+	poll();
+	if(!m_recording || !drawn)
+		return;
+
+	Readback &slot = *m_ring[m_next_slot];
+	if(!slot.idle()) {
+		auto start = std::chrono::high_resolution_clock::now();
+		++m_stalled_frames;
+		while(!slot.idle()) {
+			poll();
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+		m_stall_us += std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::high_resolution_clock::now()-start
+		).count();
+	}
+
+	slot.start(texture, width, height);
+	m_in_flight.emplace_back(&slot, m_frame++);
+	m_next_slot = (m_next_slot+1) % m_ring.size();
+}
+
+Capture::Stats Capture::stats() {
+	return {
+		m_frame, m_encoded.load(), m_failed.load(),
+		m_stalled_frames, m_stall_us, m_encoding.load()
+	};
+}
+
+Capture::Capture(JobSystem &jobs, unsigned ring_size):
+	m_jobs{jobs},
+	m_next_slot{0},
+	m_format{Format::png},
+	m_fps{60},
+	m_recording{false},
+	m_frame{0},
+	m_encoding{0},
+	m_encoded{0},
+	m_failed{0},
+	m_stalled_frames{0},
+	m_stall_us{0}
+{
+	for(unsigned i=0;i<std::max(ring_size, 1u);++i)
+		m_ring.emplace_back(new Readback);
+}
@@ -0,0 +1,83 @@
+#ifndef CAPTURE_HEADER
+#define CAPTURE_HEADER
+
+#include <GL/gl.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <Readback/Readback.hpp>
+#include <Jobs/JobSystem.hpp>
+
+class Y4mStream;
+
+// Records every frame of a texture, for flythrough videos.
+//
+// Frames are read back through a ring of Readbacks and handed to the job
+// system for encoding as soon as their fence signalled. The simulation is meant
+// to advance by timestep() per frame while recording, so the output is
+// frame-accurate however long rendering or encoding takes. When all ring
+// slots are still waiting on the encoders the render thread waits for one
+// to free up; such stalls are counted and reported as back-pressure.
+class Capture
+{
+public:
+	enum class Format {
+		png,  // numbered frame_000000.png files, unfiltered for speed
+		qoi,  // numbered frame_000000.qoi files
+		y4m,  // a single raw capture.y4m stream
+	};
+	struct Stats {
+		unsigned long long captured;
+		unsigned long long encoded;
+		unsigned long long failed;
+		unsigned long long stalled_frames;
+		long long stall_us;
+		size_t encoder_queue;
+	};
+private:
+	JobSystem &m_jobs;
+	std::vector<std::unique_ptr<Readback>> m_ring;
+	std::deque<std::pair<Readback*, unsigned long long>> m_in_flight;
+	unsigned m_next_slot;
+
+	Format m_format;
+	std::string m_directory;
+	int m_fps;
+	bool m_recording;
+	unsigned long long m_frame;
+	std::shared_ptr<Y4mStream> m_y4m;
+
+	std::atomic<size_t> m_encoding;
+	std::atomic<unsigned long long> m_encoded;
+	std::atomic<unsigned long long> m_failed;
+	unsigned long long m_stalled_frames;
+	long long m_stall_us;
+
+	void dispatch(Readback &readback, unsigned long long frame);
+	void poll();
+public:
+	// Starts recording into directory (created if needed).
+	bool start(std::string directory, Format format, int fps, int width, int height, std::string &error);
+	// Stops recording; frames already in flight are still written.
+	void stop();
+	bool recording();
+	// Frames still being read back or encoded.
+	bool busy();
+	float timestep();
+	const std::string &directory();
+
+	// GL thread, once per frame after texture was rendered. Only frames
+	// that were drawn anew are recorded, finished readbacks are collected
+	// either way.
+	void update(GLuint texture, int width, int height, bool drawn);
+	Stats stats();
+
+	Capture(JobSystem &jobs, unsigned ring_size);
+};
+
+bool parse_capture_format(const std::string &name, Capture::Format &format);
+
+#endif
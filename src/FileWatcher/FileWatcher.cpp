@@ -0,0 +1,79 @@
+#include <FileWatcher/FileWatcher.hpp>
+#include <algorithm>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace {
+
+std::string directory_of(const std::string &path)
+{
+	std::string::size_type slash = path.find_last_of('/');
+	return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+}
+
+bool FileWatcher::enabled() {
+	return m_fd >= 0;
+}
+
+bool FileWatcher::watch(const std::string &path) {
+#ifdef __linux__
+	if(m_fd < 0)
+		return false;
+	if(m_files.count(path))
+		return true;
+	std::string dir = directory_of(path);
+	int wd = inotify_add_watch(m_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	if(wd < 0)
+		return false;
+	m_directories[wd] = dir;
+	m_files.insert(path);
+	return true;
+#else
+	(void)path;
+	return false;
+#endif
+}
+
+std::vector<std::string> FileWatcher::poll() {
+	std::vector<std::string> changed;
+#ifdef __linux__
+	if(m_fd < 0)
+		return changed;
+	alignas(inotify_event) char buffer[4096];
+	for(;;) {
+		ssize_t len = read(m_fd, buffer, sizeof(buffer));
+		if(len <= 0)
+			break;
+		for(char *p = buffer; p < buffer+len; p += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(p)->len) {
+			inotify_event *event = reinterpret_cast<inotify_event*>(p);
+			auto dir = m_directories.find(event->wd);
+			if(dir == m_directories.end() || event->len == 0)
+				continue;
+			std::string path = (dir->second == "." ? "" : dir->second + "/") + event->name;
+			if(m_files.count(path) && std::find(changed.begin(), changed.end(), path) == changed.end())
+				changed.push_back(path);
+		}
+	}
+#endif
+	return changed;
+}
+
+FileWatcher::FileWatcher():
+	m_fd{-1}
+{
+#ifdef __linux__
+	m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+	if(m_fd >= 0)
+		close(m_fd);
+#endif
+}
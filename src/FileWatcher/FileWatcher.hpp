@@ -0,0 +1,33 @@
+#ifndef FILE_WATCHER_HEADER
+#define FILE_WATCHER_HEADER
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Reports modifications of a set of files without blocking. Uses inotify on
+// Linux; elsewhere poll() never reports anything and reloads have to be
+// requested by hand.
+//
+// Directories are watched rather than the files themselves, since most
+// editors save by writing a new file and renaming it over the old one.
+class FileWatcher
+{
+private:
+	int m_fd;
+	std::map<int, std::string> m_directories;
+	std::set<std::string> m_files;
+public:
+	bool enabled();
+	bool watch(const std::string &path);
+	// Returns every watched path written since the last call, each once.
+	std::vector<std::string> poll();
+
+	FileWatcher();
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher &operator=(const FileWatcher&) = delete;
+	~FileWatcher();
+};
+
+#endif
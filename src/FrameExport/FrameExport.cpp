@@ -0,0 +1,199 @@
+#include <GL/glew.h>
+#include <FrameExport/FrameExport.hpp>
+#include <Image/Image.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+uint64_t round_up(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1)/alignment*alignment;
+}
+
+}
+
+bool FrameExport::open(std::string name, unsigned slots, int width, int height, std::string &error) {
+#ifdef _WIN32
+	(void)name; (void)slots; (void)width; (void)height;
+	error = "Frame export needs POSIX shared memory";
+	return false;
+#else
+	if(m_memory) {
+		error = "Still closing the previous export";
+		return false;
+	}
+	slots = std::max(slots, 1u);
+
+	uint64_t page = sysconf(_SC_PAGESIZE);
+	uint64_t slots_offset = round_up(sizeof(FrameRingHeader), alignof(FrameSlot));
+	uint64_t data_offset = round_up(slots_offset + slots*sizeof(FrameSlot), page);
+	uint64_t slot_stride = round_up(static_cast<uint64_t>(width)*height*4, page);
+	uint64_t size = data_offset + slots*slot_stride;
+
+	// A consumer may still map a ring left behind by an earlier run; unlink
+	// it rather than resizing it under its feet.
+	shm_unlink(name.c_str());
+	int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if(fd == -1) {
+		error = "Could not create shared memory " + name + ": " + std::strerror(errno);
+		return false;
+	}
+	if(ftruncate(fd, size) != 0) {
+		error = "Could not size shared memory " + name + ": " + std::strerror(errno);
+		::close(fd);
+		shm_unlink(name.c_str());
+		return false;
+	}
+	void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(memory == MAP_FAILED) {
+		error = "Could not map shared memory " + name + ": " + std::strerror(errno);
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	m_memory = static_cast<uint8_t*>(memory);
+	m_header = new(m_memory) FrameRingHeader;
+	m_header->version = frame_ring_version;
+	m_header->slot_count = slots;
+	m_header->width = width;
+	m_header->height = height;
+	m_header->slots_offset = slots_offset;
+	m_header->data_offset = data_offset;
+	m_header->slot_stride = slot_stride;
+	m_header->size = size;
+	m_header->producer_pid = getpid();
+	m_header->closed.store(0, std::memory_order_relaxed);
+	m_header->published.store(0, std::memory_order_relaxed);
+	for(unsigned i=0;i<slots;++i) {
+		FrameSlot *slot = new(m_memory + slots_offset + i*sizeof(FrameSlot)) FrameSlot;
+		slot->sequence.store(0, std::memory_order_relaxed);
+		slot->frame = 0;
+		slot->timestamp_ns = 0;
+	}
+	// The magic goes in last, a consumer seeing it sees a complete header.
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(m_header->magic, frame_ring_magic, sizeof(frame_ring_magic));
+
+	m_name = std::move(name);
+	m_frame = 0;
+	m_published = 0;
+	m_dropped = 0;
+	m_active = true;
+	return true;
+#endif
+}
+
+void FrameExport::close() {
+#ifndef _WIN32
+	if(!m_memory)
+		return;
+	m_header->closed.store(1, std::memory_order_release);
+	munmap(m_memory, m_header->size);
+	shm_unlink(m_name.c_str());
+	m_memory = nullptr;
+	m_header = nullptr;
+#endif
+}
+
+void FrameExport::publish(Readback &readback, uint64_t frame) {
+	FrameRingHeader *header = m_header;
+	m_copier.push([this, header, &readback, frame]{
+		FrameSlot &slot = *reinterpret_cast<FrameSlot*>(
+			m_memory + header->slots_offset + (frame % header->slot_count)*sizeof(FrameSlot)
+		);
+		uint8_t *pixels = m_memory + header->data_offset + (frame % header->slot_count)*header->slot_stride;
+
+		slot.sequence.store(frame_slot_writing(frame), std::memory_order_relaxed);
+		// Keeps the pixel writes below from becoming visible before the
+		// slot is marked as being written.
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.frame = frame;
+		flip_rows(readback.data(), pixels, static_cast<size_t>(header->width)*4, header->height);
+		readback.release();
+		slot.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()
+		).count();
+		slot.sequence.store(frame_slot_complete(frame), std::memory_order_release);
+		header->published.store(frame+1, std::memory_order_release);
+		++m_published;
+	});
+}
+
+void FrameExport::poll() {
+	// Readbacks complete in submission order, so only the front can be ready.
+	while(!m_in_flight.empty() && m_in_flight.front().first->ready()) {
+		if(m_memory)
+			publish(*m_in_flight.front().first, m_in_flight.front().second);
+		else
+			m_in_flight.front().first->release();
+		m_in_flight.pop_front();
+	}
+}
+
+void FrameExport::stop() {
+	m_active = false;
+}
+
+bool FrameExport::active() {
+	return m_active;
+}
+
+const std::string &FrameExport::name() {
+	return m_name;
+}
+
+void FrameExport::update(GLuint texture, int width, int height) {
+	poll();
+	if(!m_active) {
+		if(m_memory && m_in_flight.empty() && !m_copier.pending())
+			close();
+		return;
+	}
+
+	Readback &readback = *m_readbacks[m_next_readback];
+	if(!readback.idle()
+	|| static_cast<uint32_t>(width) != m_header->width
+	|| static_cast<uint32_t>(height) != m_header->height) {
+		++m_dropped;
+		return;
+	}
+	readback.start(texture, width, height);
+	m_in_flight.emplace_back(&readback, m_frame++);
+	m_next_readback = (m_next_readback+1) % m_readbacks.size();
+}
+
+FrameExport::Stats FrameExport::stats() {
+	return {m_published.load(), m_dropped};
+}
+
+FrameExport::FrameExport(unsigned readbacks):
+	m_next_readback{0},
+	m_memory{nullptr},
+	m_header{nullptr},
+	m_active{false},
+	m_frame{0},
+	m_published{0},
+	m_dropped{0},
+	m_copier{1}
+{
+	for(unsigned i=0;i<std::max(readbacks, 1u);++i)
+		m_readbacks.emplace_back(new Readback);
+}
+
+FrameExport::~FrameExport() {
+	// Queued copies still write into the mapping.
+	while(m_copier.pending())
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	close();
+}
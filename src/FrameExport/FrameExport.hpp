@@ -0,0 +1,73 @@
+#ifndef FRAME_EXPORT_HEADER
+#define FRAME_EXPORT_HEADER
+
+#include <GL/gl.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <FrameExport/FrameRing.hpp>
+#include <Readback/Readback.hpp>
+#include <Worker/Worker.hpp>
+
+// Publishes every frame of a texture into a POSIX shared memory ring (see
+// FrameRing.hpp), so local processes such as an encoder or compositor can
+// take frames without files or sockets.
+//
+// Frames are read back through a ring of Readbacks. Once a fence signalled,
+// a copy thread flips the rows straight from the mapped pixel buffer into
+// the frame's shared slot and publishes it. Rendering never waits on the
+// export: when every readback is still busy the frame is dropped and
+// counted instead.
+class FrameExport
+{
+public:
+	struct Stats {
+		unsigned long long published;
+		unsigned long long dropped;
+	};
+private:
+	std::vector<std::unique_ptr<Readback>> m_readbacks;
+	std::deque<std::pair<Readback*, uint64_t>> m_in_flight;
+	unsigned m_next_readback;
+
+	std::string m_name;
+	uint8_t *m_memory;
+	FrameRingHeader *m_header;
+	bool m_active;
+	uint64_t m_frame;
+	std::atomic<unsigned long long> m_published;
+	unsigned long long m_dropped;
+
+	// Declared last so it is joined before anything its tasks touch is
+	// destroyed.
+	Worker m_copier;
+
+	void publish(Readback &readback, uint64_t frame);
+	void poll();
+	void close();
+public:
+	// Creates (or replaces) the shared memory object name, e.g.
+	// "/infiniterrain-frames", with room for slots frames.
+	bool open(std::string name, unsigned slots, int width, int height, std::string &error);
+	// Stops taking frames. The ring is marked closed and unlinked once the
+	// frames in flight were published; consumers keep their mapping.
+	void stop();
+	bool active();
+	const std::string &name();
+
+	// GL thread, once per frame after texture was rendered.
+	void update(GLuint texture, int width, int height);
+	Stats stats();
+
+	explicit FrameExport(unsigned readbacks = 3);
+	FrameExport(const FrameExport&) = delete;
+	FrameExport &operator=(const FrameExport&) = delete;
+	~FrameExport();
+};
+
+#endif
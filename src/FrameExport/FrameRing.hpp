@@ -0,0 +1,64 @@
+#ifndef FRAME_RING_HEADER
+#define FRAME_RING_HEADER
+
+#include <atomic>
+#include <cstdint>
+
+// Layout of the shared memory ring written by FrameExport, included by
+// consumers too (see tools/frame_consumer.cpp).
+//
+//   FrameRingHeader | FrameSlot[slot_count] | slot 0 pixels | slot 1 pixels ...
+//
+// The pixels of slot i start page aligned at data_offset + i*slot_stride:
+// height rows of width RGBA8 pixels, top row first.
+//
+// Every slot is guarded by a sequence number. Frame n goes into slot
+// n % slot_count; while it is written the slot's sequence is 2n+1, once it
+// is complete 2n+2, and then published becomes n+1. A consumer loads
+// published, checks the slot's sequence is 2n+2, uses the pixels in place
+// and loads the sequence again: if it changed the producer lapped the
+// consumer meanwhile and the frame has to be thrown away. The producer never
+// waits for consumers, a slow consumer only misses frames.
+const char frame_ring_magic[8] = {'I', 'T', 'F', 'R', 'I', 'N', 'G', '\0'};
+const uint32_t frame_ring_version = 1;
+
+struct FrameSlot {
+	std::atomic<uint64_t> sequence;
+	uint64_t frame;
+	// std::chrono::steady_clock (CLOCK_MONOTONIC) when the frame was
+	// published, comparable across processes.
+	int64_t timestamp_ns;
+	uint8_t padding[40];
+};
+
+struct FrameRingHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t slot_count;
+	uint32_t width;
+	uint32_t height;
+	uint64_t slots_offset;
+	uint64_t data_offset;
+	uint64_t slot_stride;
+	uint64_t size;
+	uint32_t producer_pid;
+	// Set when the producer stopped; no frames follow.
+	std::atomic<uint32_t> closed;
+	// Number of frames published so far.
+	std::atomic<uint64_t> published;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "frame ring atomics must be lock-free to work across processes");
+static_assert(sizeof(FrameSlot) == 64, "frame slots are meant to fill a cache line");
+
+inline uint64_t frame_slot_writing(uint64_t frame)
+{
+	return 2*frame + 1;
+}
+
+inline uint64_t frame_slot_complete(uint64_t frame)
+{
+	return 2*frame + 2;
+}
+
+#endif
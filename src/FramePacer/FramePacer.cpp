@@ -0,0 +1,79 @@
+#include <FramePacer/FramePacer.hpp>
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+constexpr FramePacer::clock::duration min_spin = std::chrono::microseconds(200);
+constexpr FramePacer::clock::duration max_spin = std::chrono::milliseconds(4);
+
+uint64_t to_us(FramePacer::clock::duration duration)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+}
+
+void FramePacer::wait() {
+	clock::time_point now = clock::now();
+	if(!m_scheduled) {
+		m_deadline = now;
+		m_scheduled = true;
+		return;
+	}
+	m_deadline += m_period;
+	if(now >= m_deadline) {
+		if(now - m_deadline >= m_period) {
+			++m_missed;
+			m_deadline = now;
+		}
+		else
+			m_late.record(to_us(now - m_deadline));
+		return;
+	}
+
+	clock::time_point wake = m_deadline - m_spin;
+	if(now < wake) {
+		std::this_thread::sleep_until(wake);
+		clock::duration over = clock::now() - wake;
+		if(over > m_spin)
+			m_spin = std::min(over, max_spin);
+		else
+			m_spin = std::max(min_spin, m_spin - (m_spin - over)/16);
+	}
+	while(clock::now() < m_deadline)
+		std::this_thread::yield();
+	m_late.record(to_us(clock::now() - m_deadline));
+}
+
+void FramePacer::reset() {
+	m_scheduled = false;
+}
+
+void FramePacer::set_rate(double fps) {
+	m_period = std::chrono::duration_cast<clock::duration>(
+		std::chrono::duration<double>(1.0/std::max(1.0, fps))
+	);
+}
+
+double FramePacer::rate() const {
+	return 1.0/std::chrono::duration<double>(m_period).count();
+}
+
+FramePacer::Summary FramePacer::next_interval() {
+	Summary summary{
+		m_late.count() + m_missed, m_missed,
+		m_late.percentile(0.5), m_late.percentile(0.99), m_late.max()
+	};
+	m_late.reset();
+	m_missed = 0;
+	return summary;
+}
+
+FramePacer::FramePacer(double fps):
+	m_spin{std::chrono::milliseconds(1)},
+	m_scheduled{false},
+	m_missed{0}
+{
+	set_rate(fps);
+}
@@ -0,0 +1,54 @@
+#ifndef FRAME_PACER_HEADER
+#define FRAME_PACER_HEADER
+
+#include <chrono>
+#include <cstdint>
+#include <FrameStats/Histogram.hpp>
+
+// Holds the loop to a target rate. wait() is called once per frame and
+// returns at that frame's deadline, one period after the previous one, so
+// only what is left of the period after the frame's own work is waited
+// for. A frame that overran by a whole period is not made up for with a
+// burst of short ones; the schedule restarts from then.
+//
+// Sleeps overshoot by up to a scheduler tick, so the bulk of the wait is
+// slept and the last stretch spun on the monotonic clock. The spin margin
+// follows the worst recent oversleep and decays back when sleeps are
+// punctual. How late each wait returned is kept per report interval.
+class FramePacer
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	struct Summary {
+		uint64_t frames;
+		// Deadlines overrun by more than a period, the schedule restarted.
+		uint64_t missed;
+		uint64_t p50_us;
+		uint64_t p99_us;
+		uint64_t max_us;
+	};
+private:
+	clock::duration m_period;
+	clock::duration m_spin;
+	clock::time_point m_deadline;
+	bool m_scheduled;
+
+	Histogram m_late;
+	uint64_t m_missed;
+public:
+	void wait();
+	// Forgets the schedule; the next wait() returns right away and starts a
+	// new one. For when the loop was held up on purpose.
+	void reset();
+
+	void set_rate(double fps);
+	double rate() const;
+
+	// Lateness since the last call, then starts over.
+	Summary next_interval();
+
+	explicit FramePacer(double fps);
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include <FrameStats/FrameStats.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <utility>
+
+const char *series_name(FrameStats::Series series)
+{
+	switch(series) {
+		case FrameStats::Series::cpu: return "cpu";
+		case FrameStats::Series::gpu: return "gpu";
+		case FrameStats::Series::present: return "present";
+	}
+	return "";
+}
+
+bool parse_hitch_thresholds(const std::string &str, std::vector<double> &hitch_ms)
+{
+	std::vector<double> thresholds;
+	std::istringstream in(str);
+	std::string item;
+	while(std::getline(in, item, ',')) {
+		char *end;
+		double ms = std::strtod(item.c_str(), &end);
+		if(end == item.c_str() || *end || ms <= 0.0)
+			return false;
+		thresholds.push_back(ms);
+	}
+	if(thresholds.empty())
+		return false;
+	std::sort(thresholds.begin(), thresholds.end());
+	hitch_ms = thresholds;
+	return true;
+}
+
+Histogram FrameStats::merged(Series series, Window window) const {
+	const Track &track = m_tracks[static_cast<unsigned>(series)];
+	switch(window) {
+		case Window::interval:
+			return track.intervals[m_interval];
+		case Window::rolling: {
+			Histogram histogram;
+			for(auto &interval : track.intervals)
+				histogram.add(interval);
+			return histogram;
+		}
+		case Window::run:
+			break;
+	}
+	return track.run;
+}
+
+void FrameStats::record(Series series, uint64_t us) {
+	Track &track = m_tracks[static_cast<unsigned>(series)];
+	track.run.record(us);
+	track.intervals[m_interval].record(us);
+	track.recent[track.recent_head] = us/1000.f;
+	track.recent_head = (track.recent_head+1) % recent_count;
+}
+
+void FrameStats::next_interval() {
+	m_interval = (m_interval+1) % m_tracks[0].intervals.size();
+	for(auto &track : m_tracks)
+		track.intervals[m_interval].reset();
+}
+
+FrameStats::Summary FrameStats::summary(Series series, Window window) const {
+	Histogram histogram = merged(series, window);
+	Summary summary;
+	summary.count = histogram.count();
+	summary.mean_ms = histogram.mean()/1000.0;
+	summary.p50_ms = histogram.percentile(0.5)/1000.0;
+	summary.p90_ms = histogram.percentile(0.9)/1000.0;
+	summary.p99_ms = histogram.percentile(0.99)/1000.0;
+	summary.p999_ms = histogram.percentile(0.999)/1000.0;
+	summary.max_ms = histogram.max()/1000.0;
+	for(double ms : m_hitch_ms)
+		summary.hitches.push_back(histogram.count_above(static_cast<uint64_t>(ms*1000.0)));
+	return summary;
+}
+
+const std::vector<double> &FrameStats::hitch_thresholds() const {
+	return m_hitch_ms;
+}
+
+std::array<float, FrameStats::recent_count> FrameStats::recent(Series series) const {
+	const Track &track = m_tracks[static_cast<unsigned>(series)];
+	std::array<float, recent_count> recent;
+	std::rotate_copy(track.recent.begin(), track.recent.begin()+track.recent_head, track.recent.end(), recent.begin());
+	return recent;
+}
+
+std::string FrameStats::report(Window window) const {
+	std::string report;
+	char line[256];
+	for(unsigned i=0;i<series_count;++i) {
+		Series series = static_cast<Series>(i);
+		Summary s = summary(series, window);
+		if(!s.count)
+			continue;
+		int length = std::snprintf(
+			line, sizeof(line), "%-7s p50 %.2f p90 %.2f p99 %.2f p99.9 %.2f max %.2f ms",
+			series_name(series), s.p50_ms, s.p90_ms, s.p99_ms, s.p999_ms, s.max_ms
+		);
+		report.append(line, length);
+		for(size_t j=0;j<m_hitch_ms.size();++j) {
+			length = std::snprintf(line, sizeof(line), ", %llu >%gms", static_cast<unsigned long long>(s.hitches[j]), m_hitch_ms[j]);
+			report.append(line, length);
+		}
+		report += '\n';
+	}
+	return report;
+}
+
+std::string FrameStats::csv(Window window) const {
+	std::string csv = "series,frames,mean_ms,p50_ms,p90_ms,p99_ms,p99.9_ms,max_ms";
+	char field[64];
+	for(double ms : m_hitch_ms) {
+		std::snprintf(field, sizeof(field), ",over_%gms", ms);
+		csv += field;
+	}
+	csv += '\n';
+	for(unsigned i=0;i<series_count;++i) {
+		Series series = static_cast<Series>(i);
+		Summary s = summary(series, window);
+		char line[256];
+		int length = std::snprintf(
+			line, sizeof(line), "%s,%llu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f",
+			series_name(series), static_cast<unsigned long long>(s.count),
+			s.mean_ms, s.p50_ms, s.p90_ms, s.p99_ms, s.p999_ms, s.max_ms
+		);
+		csv.append(line, length);
+		for(auto hitches : s.hitches) {
+			std::snprintf(field, sizeof(field), ",%llu", static_cast<unsigned long long>(hitches));
+			csv += field;
+		}
+		csv += '\n';
+	}
+	return csv;
+}
+
+FrameStats::FrameStats(unsigned rolling_intervals, std::vector<double> hitch_ms):
+	m_hitch_ms{std::move(hitch_ms)},
+	m_interval{0}
+{
+	for(auto &track : m_tracks) {
+		track.intervals.resize(std::max(1u, rolling_intervals));
+		track.recent.fill(0.f);
+		track.recent_head = 0;
+	}
+}
@@ -0,0 +1,73 @@
+#ifndef FRAME_STATS_HEADER
+#define FRAME_STATS_HEADER
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <FrameStats/Histogram.hpp>
+
+// Frame time statistics in fixed memory. Every series keeps a histogram of
+// the whole run plus a ring of per-interval histograms (main closes an
+// interval once a second), so percentiles and hitch counts can be asked for
+// the last interval, a rolling window of the last few intervals or the whole
+// run, and the most recent samples for drawing a graph.
+class FrameStats
+{
+public:
+	enum class Series {
+		cpu,     // CPU time from the start of the frame to SwapBuffers
+		gpu,     // GPU time of the frame's commands, from timer queries
+		present, // interval between two SwapBuffers returning
+	};
+	static constexpr unsigned series_count = 3;
+	enum class Window {interval, rolling, run};
+	static constexpr unsigned recent_count = 256;
+
+	struct Summary {
+		uint64_t count;
+		double mean_ms;
+		double p50_ms;
+		double p90_ms;
+		double p99_ms;
+		double p999_ms;
+		double max_ms;
+		// Frames longer than each hitch threshold, in threshold order.
+		std::vector<uint64_t> hitches;
+	};
+private:
+	struct Track {
+		Histogram run;
+		std::vector<Histogram> intervals;
+		std::array<float, recent_count> recent;
+		unsigned recent_head;
+	};
+
+	std::array<Track, series_count> m_tracks;
+	std::vector<double> m_hitch_ms;
+	unsigned m_interval;
+
+	Histogram merged(Series series, Window window) const;
+public:
+	void record(Series series, uint64_t us);
+	// Closes the current interval; the oldest one leaves the rolling window.
+	void next_interval();
+
+	Summary summary(Series series, Window window) const;
+	const std::vector<double> &hitch_thresholds() const;
+	// The last recent_count samples in milliseconds, oldest first.
+	std::array<float, recent_count> recent(Series series) const;
+
+	// One line per series that has samples, for the log.
+	std::string report(Window window) const;
+	// A header and one line per series, for bench results.
+	std::string csv(Window window) const;
+
+	FrameStats(unsigned rolling_intervals, std::vector<double> hitch_ms);
+};
+
+const char *series_name(FrameStats::Series series);
+// Comma separated milliseconds, e.g. "33.3,50,100".
+bool parse_hitch_thresholds(const std::string &str, std::vector<double> &hitch_ms);
+
+#endif
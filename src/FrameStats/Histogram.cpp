@@ -0,0 +1,78 @@
+#include <FrameStats/Histogram.hpp>
+#include <algorithm>
+#include <cmath>
+
+unsigned Histogram::bucket(uint64_t value) {
+	value = std::min(value, max_value);
+	if(value < 2*sub_buckets)
+		return value;
+	unsigned msb = 63 - __builtin_clzll(value);
+	unsigned shift = msb - sub_bits;
+	return shift*sub_buckets + (value >> shift);
+}
+
+uint64_t Histogram::bucket_top(unsigned bucket) {
+	if(bucket < 2*sub_buckets)
+		return bucket;
+	unsigned shift = bucket/sub_buckets - 1;
+	uint64_t mantissa = bucket - shift*sub_buckets;
+	return ((mantissa+1) << shift) - 1;
+}
+
+void Histogram::record(uint64_t us) {
+	++m_counts[bucket(us)];
+	++m_count;
+	m_sum += us;
+	m_max = std::max(m_max, us);
+}
+
+void Histogram::add(const Histogram &other) {
+	for(unsigned i=0;i<bucket_count;++i)
+		m_counts[i] += other.m_counts[i];
+	m_count += other.m_count;
+	m_sum += other.m_sum;
+	m_max = std::max(m_max, other.m_max);
+}
+
+void Histogram::reset() {
+	m_counts.fill(0);
+	m_count = 0;
+	m_sum = 0;
+	m_max = 0;
+}
+
+uint64_t Histogram::count() const {
+	return m_count;
+}
+
+uint64_t Histogram::max() const {
+	return m_max;
+}
+
+double Histogram::mean() const {
+	return m_count ? static_cast<double>(m_sum)/m_count : 0.0;
+}
+
+uint64_t Histogram::percentile(double p) const {
+	if(!m_count)
+		return 0;
+	uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(p, 0.0, 1.0)*m_count)));
+	uint64_t seen = 0;
+	for(unsigned i=0;i<bucket_count;++i) {
+		seen += m_counts[i];
+		if(seen >= rank)
+			return std::min(bucket_top(i), m_max);
+	}
+	return m_max;
+}
+
+uint64_t Histogram::count_above(uint64_t us) const {
+	uint64_t above = 0;
+	for(unsigned i=bucket(us)+1;i<bucket_count;++i)
+		above += m_counts[i];
+	return above;
+}
+
+Histogram::Histogram() {
+	reset();
+}
@@ -0,0 +1,46 @@
+#ifndef HISTOGRAM_HEADER
+#define HISTOGRAM_HEADER
+
+#include <array>
+#include <cstdint>
+
+// Fixed-size log-linear histogram of durations in microseconds, in the
+// spirit of HdrHistogram: values below 64µs are counted exactly, above that
+// every power of two is split into 32 buckets, so any value is known within
+// about 3% up to 67 seconds, in under 3 KB. Recording is a few instructions
+// and never allocates; histograms of the same shape simply add up.
+class Histogram
+{
+public:
+	static constexpr unsigned sub_bits = 5;
+	static constexpr unsigned sub_buckets = 1u << sub_bits;
+	static constexpr unsigned max_bits = 26;
+	static constexpr unsigned bucket_count = (max_bits - sub_bits)*sub_buckets + sub_buckets;
+	static constexpr uint64_t max_value = (uint64_t(1) << max_bits) - 1;
+private:
+	std::array<uint32_t, bucket_count> m_counts;
+	uint64_t m_count;
+	uint64_t m_sum;
+	uint64_t m_max;
+
+	static unsigned bucket(uint64_t value);
+	// Highest value that falls into bucket.
+	static uint64_t bucket_top(unsigned bucket);
+public:
+	// Values past max_value are clamped, the exact maximum is kept though.
+	void record(uint64_t us);
+	void add(const Histogram &other);
+	void reset();
+
+	uint64_t count() const;
+	uint64_t max() const;
+	double mean() const;
+	// Smallest value at or below which the fraction p (0..1) of samples lie.
+	uint64_t percentile(double p) const;
+	// Samples strictly longer than us, to bucket precision.
+	uint64_t count_above(uint64_t us) const;
+
+	Histogram();
+};
+
+#endif
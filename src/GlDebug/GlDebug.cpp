@@ -0,0 +1,174 @@
+#include <GL/glew.h>
+#include <GlDebug/GlDebug.hpp>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace {
+
+using MessageKey = std::tuple<GLenum, GLenum, GLuint, GLenum>;
+
+std::atomic<bool> enabled{false};
+// Guards everything below; the callback may run on a driver thread.
+std::mutex mutex;
+std::map<MessageKey, GlDebugMessage> messages;
+std::vector<MessageKey> fresh;
+std::vector<const char*> groups;
+
+void GLAPIENTRY callback(
+	GLenum source, GLenum type, GLuint id, GLenum severity,
+	GLsizei length, const GLchar *text, const void*
+) {
+	std::lock_guard<std::mutex> lock(mutex);
+	MessageKey key{source, type, id, severity};
+	auto it = messages.find(key);
+	if(it != messages.end()) {
+		++it->second.count;
+		return;
+	}
+	GlDebugMessage &message = messages[key];
+	message.source = source;
+	message.type = type;
+	message.id = id;
+	message.severity = severity;
+	message.text = length < 0 ? std::string(text) : std::string(text, length);
+	for(auto group : groups) {
+		if(!message.group.empty())
+			message.group += '/';
+		message.group += group;
+	}
+	message.count = 1;
+	fresh.push_back(key);
+}
+
+const char *source_name(GLenum source)
+{
+	switch(source) {
+		case GL_DEBUG_SOURCE_API: return "api";
+		case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+		case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+		case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+		case GL_DEBUG_SOURCE_APPLICATION: return "application";
+		default: return "other";
+	}
+}
+
+const char *type_name(GLenum type)
+{
+	switch(type) {
+		case GL_DEBUG_TYPE_ERROR: return "error";
+		case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+		case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+		case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+		case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+		case GL_DEBUG_TYPE_MARKER: return "marker";
+		default: return "other";
+	}
+}
+
+const char *severity_name(GLenum severity)
+{
+	switch(severity) {
+		case GL_DEBUG_SEVERITY_HIGH: return "high";
+		case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+		case GL_DEBUG_SEVERITY_LOW: return "low";
+		default: return "notification";
+	}
+}
+
+}
+
+bool gl_debug_enable(bool synchronous, bool verbose)
+{
+	if(!GLEW_VERSION_4_3 && !GLEW_KHR_debug)
+		return false;
+	glEnable(GL_DEBUG_OUTPUT);
+	if(synchronous)
+		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	else
+		glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	glDebugMessageCallback(callback, nullptr);
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+	// Our own groups come back as messages otherwise.
+	glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_PUSH_GROUP, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+	glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_POP_GROUP, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+	if(!verbose)
+		glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+	enabled = true;
+	return true;
+}
+
+void gl_debug_disable()
+{
+	enabled = false;
+	glDisable(GL_DEBUG_OUTPUT);
+	glDebugMessageCallback(nullptr, nullptr);
+}
+
+bool gl_debug_enabled()
+{
+	return enabled.load(std::memory_order_relaxed);
+}
+
+std::vector<GlDebugMessage> gl_debug_fresh()
+{
+	std::vector<GlDebugMessage> result;
+	std::lock_guard<std::mutex> lock(mutex);
+	for(auto &key : fresh)
+		result.push_back(messages[key]);
+	fresh.clear();
+	return result;
+}
+
+std::vector<GlDebugMessage> gl_debug_messages()
+{
+	std::vector<GlDebugMessage> result;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for(auto &message : messages)
+			result.push_back(message.second);
+	}
+	std::stable_sort(result.begin(), result.end(), [](const GlDebugMessage &a, const GlDebugMessage &b){
+		return a.count > b.count;
+	});
+	return result;
+}
+
+std::string gl_debug_describe(const GlDebugMessage &message)
+{
+	std::string str = std::string(severity_name(message.severity)) + " " + type_name(message.type) +
+		" from " + source_name(message.source) + " (id " + std::to_string(message.id) + ")";
+	if(!message.group.empty())
+		str += " in " + message.group;
+	if(message.count > 1)
+		str += ", " + std::to_string(message.count) + " times";
+	return str + ": " + message.text;
+}
+
+void gl_label(GLenum identifier, GLuint name, const std::string &label)
+{
+	if(gl_debug_enabled())
+		glObjectLabel(identifier, name, label.size(), label.c_str());
+}
+
+GlDebugGroup::GlDebugGroup(const char *name):
+	m_pushed{gl_debug_enabled()}
+{
+	if(!m_pushed)
+		return;
+	glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+	std::lock_guard<std::mutex> lock(mutex);
+	groups.push_back(name);
+}
+
+GlDebugGroup::~GlDebugGroup() {
+	if(!m_pushed)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		groups.pop_back();
+	}
+	glPopDebugGroup();
+}
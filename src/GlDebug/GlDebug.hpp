@@ -0,0 +1,61 @@
+#ifndef GL_DEBUG_HEADER
+#define GL_DEBUG_HEADER
+
+#include <GL/gl.h>
+#include <string>
+#include <vector>
+
+// GL debug output (KHR_debug, core since 4.3) instead of polling
+// glGetError. The driver reports errors, performance warnings and the
+// like through a callback; messages are deduplicated by source, type, id
+// and severity and counted, and remember the debug groups that were open
+// and the text of their first occurrence, which names labelled objects.
+//
+// Synchronous output reports messages on the GL thread inside the call
+// that caused them, so the group context is exact; asynchronous output is
+// cheaper but the groups are only those open when the driver got round to
+// it. Groups and labels are skipped while debug output is off.
+
+struct GlDebugMessage {
+	GLenum source;
+	GLenum type;
+	GLuint id;
+	GLenum severity;
+	std::string text;
+	// Debug groups open at the first occurrence, outermost first, '/'
+	// separated.
+	std::string group;
+	unsigned long long count;
+};
+
+// Needs a debug context for most drivers to say anything useful. Returns
+// false if debug output is unavailable. Notifications are only kept when
+// verbose.
+bool gl_debug_enable(bool synchronous, bool verbose);
+void gl_debug_disable();
+bool gl_debug_enabled();
+// Messages seen for the first time since the last call.
+std::vector<GlDebugMessage> gl_debug_fresh();
+// Every distinct message so far with its count, most frequent first.
+std::vector<GlDebugMessage> gl_debug_messages();
+std::string gl_debug_describe(const GlDebugMessage &message);
+
+// glObjectLabel, e.g. gl_label(GL_TEXTURE, texture, "G-buffer normals").
+void gl_label(GLenum identifier, GLuint name, const std::string &label);
+
+class GlDebugGroup
+{
+private:
+	bool m_pushed;
+public:
+	explicit GlDebugGroup(const char *name);
+	GlDebugGroup(const GlDebugGroup&) = delete;
+	GlDebugGroup &operator=(const GlDebugGroup&) = delete;
+	~GlDebugGroup();
+};
+
+#define GL_DEBUG_CONCAT_IMPL(a, b) a##b
+#define GL_DEBUG_CONCAT(a, b) GL_DEBUG_CONCAT_IMPL(a, b)
+#define GL_DEBUG_GROUP(name) GlDebugGroup GL_DEBUG_CONCAT(gl_debug_group_, __LINE__){name}
+
+#endif
@@ -0,0 +1,140 @@
+#include <GL/glew.h>
+#include <GlState/GlState.hpp>
+
+template<typename T>
+bool GlState::change(T &cached, T value) {
+	if(cached == value) {
+		++m_frame.elided;
+		return false;
+	}
+	cached = value;
+	++m_frame.issued;
+	return true;
+}
+
+void GlState::use_program(GLuint program) {
+	if(change(m_program, program))
+		glUseProgram(program);
+}
+
+void GlState::bind_vertex_array(GLuint vertex_array) {
+	if(change(m_vertex_array, vertex_array))
+		glBindVertexArray(vertex_array);
+}
+
+void GlState::bind_buffer(GLenum target, GLuint buffer) {
+	for(auto &binding : m_buffers) {
+		if(binding.first == target) {
+			if(change(binding.second, buffer))
+				glBindBuffer(target, buffer);
+			return;
+		}
+	}
+	m_buffers.emplace_back(target, buffer);
+	++m_frame.issued;
+	glBindBuffer(target, buffer);
+}
+
+void GlState::bind_framebuffer(GLuint framebuffer) {
+	if(change(m_framebuffer, framebuffer))
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void GlState::bind_texture_unit(GLuint unit, GLuint texture) {
+	if(unit >= m_textures.size())
+		m_textures.resize(unit+1, unknown);
+	if(change(m_textures[unit], texture))
+		glBindTextureUnit(unit, texture);
+}
+
+void GlState::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+	std::array<GLint, 4> viewport = {x, y, width, height};
+	if(m_viewport_known && viewport == m_viewport) {
+		++m_frame.elided;
+		return;
+	}
+	m_viewport = viewport;
+	m_viewport_known = true;
+	++m_frame.issued;
+	glViewport(x, y, width, height);
+}
+
+void GlState::polygon_mode(GLenum mode) {
+	if(change(m_polygon_mode, mode))
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+void GlState::depth_func(GLenum func) {
+	if(change(m_depth_func, func))
+		glDepthFunc(func);
+}
+
+void GlState::depth_mask(bool write) {
+	if(change(m_depth_mask, static_cast<GLuint>(write)))
+		glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void GlState::color_mask(bool write) {
+	if(change(m_color_mask, static_cast<GLuint>(write))) {
+		GLboolean value = write ? GL_TRUE : GL_FALSE;
+		glColorMask(value, value, value, value);
+	}
+}
+
+void GlState::enable(GLenum capability) {
+	set(capability, true);
+}
+
+void GlState::disable(GLenum capability) {
+	set(capability, false);
+}
+
+void GlState::set(GLenum capability, bool enabled) {
+	for(auto &state : m_capabilities) {
+		if(state.first == capability) {
+			if(!change(state.second, enabled))
+				return;
+			if(enabled)
+				glEnable(capability);
+			else
+				glDisable(capability);
+			return;
+		}
+	}
+	m_capabilities.emplace_back(capability, enabled);
+	++m_frame.issued;
+	if(enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+}
+
+void GlState::invalidate() {
+	m_program = unknown;
+	m_vertex_array = unknown;
+	m_framebuffer = unknown;
+	m_buffers.clear();
+	m_textures.clear();
+	m_viewport_known = false;
+	m_polygon_mode = unknown;
+	m_depth_func = unknown;
+	m_depth_mask = unknown;
+	m_color_mask = unknown;
+	m_capabilities.clear();
+}
+
+void GlState::end_frame() {
+	m_last_frame = m_frame;
+	m_frame = {0, 0};
+}
+
+GlState::Counters GlState::last_frame() {
+	return m_last_frame;
+}
+
+GlState::GlState():
+	m_frame{0, 0},
+	m_last_frame{0, 0}
+{
+	invalidate();
+}
@@ -0,0 +1,74 @@
+#ifndef GL_STATE_HEADER
+#define GL_STATE_HEADER
+
+#include <GL/gl.h>
+#include <array>
+#include <utility>
+#include <vector>
+
+// Shadow copy of the GL state the render loop changes, so setting a value
+// that is already current costs no GL call. Everything starts out unknown
+// and the first set of each value is always issued; code that changes the
+// same state behind the tracker's back has to call invalidate() afterwards.
+//
+// Counts issued and elided calls per frame.
+class GlState
+{
+public:
+	struct Counters {
+		unsigned long long issued;
+		unsigned long long elided;
+	};
+private:
+	static constexpr GLuint unknown = ~0u;
+
+	GLuint m_program;
+	GLuint m_vertex_array;
+	GLuint m_framebuffer;
+	std::vector<std::pair<GLenum, GLuint>> m_buffers;
+	std::vector<GLuint> m_textures;
+	std::array<GLint, 4> m_viewport;
+	bool m_viewport_known;
+	GLenum m_polygon_mode;
+	GLenum m_depth_func;
+	GLuint m_depth_mask;
+	GLuint m_color_mask;
+	std::vector<std::pair<GLenum, bool>> m_capabilities;
+
+	Counters m_frame;
+	Counters m_last_frame;
+
+	// True (and counted as issued) when value differs from cached, which
+	// then takes value.
+	template<typename T>
+	bool change(T &cached, T value);
+public:
+	void use_program(GLuint program);
+	void bind_vertex_array(GLuint vertex_array);
+	// Not for GL_ELEMENT_ARRAY_BUFFER, that binding is vertex array state.
+	void bind_buffer(GLenum target, GLuint buffer);
+	// GL_FRAMEBUFFER, draw and read.
+	void bind_framebuffer(GLuint framebuffer);
+	void bind_texture_unit(GLuint unit, GLuint texture);
+	void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+	// GL_FRONT_AND_BACK.
+	void polygon_mode(GLenum mode);
+	void depth_func(GLenum func);
+	void depth_mask(bool write);
+	// All four channels of every draw buffer.
+	void color_mask(bool write);
+	void enable(GLenum capability);
+	void disable(GLenum capability);
+	void set(GLenum capability, bool enabled);
+
+	// Forgets everything, every value is issued again on its next set.
+	void invalidate();
+
+	// Starts counting the next frame.
+	void end_frame();
+	Counters last_frame();
+
+	GlState();
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include <GL/glew.h>
+#include <GpuResource/Buffer.hpp>
+#include <GpuResource/GpuMemory.hpp>
+#include <GlDebug/GlDebug.hpp>
+#include <utility>
+
+Buffer::operator GLuint() const {
+	return m_buffer;
+}
+
+Buffer::operator bool() const {
+	return m_buffer != 0;
+}
+
+size_t Buffer::size() const {
+	return m_size;
+}
+
+void Buffer::sub_data(GLintptr offset, GLsizeiptr size, const void *data) {
+	glNamedBufferSubData(m_buffer, offset, size, data);
+}
+
+void *Buffer::map(GLintptr offset, GLsizeiptr length, GLbitfield access) {
+	return glMapNamedBufferRange(m_buffer, offset, length, access);
+}
+
+void Buffer::label(const std::string &name) {
+	gl_label(GL_BUFFER, m_buffer, name);
+}
+
+void Buffer::reset() {
+	if(!m_buffer)
+		return;
+	glDeleteBuffers(1, &m_buffer);
+	gpu_memory_remove(m_category, m_size);
+	m_buffer = 0;
+	m_size = 0;
+}
+
+Buffer::Buffer():
+	m_buffer{0},
+	m_size{0}
+{;}
+
+Buffer::Buffer(const std::string &category, size_t size, const void *data, GLbitfield flags):
+	m_buffer{0},
+	m_size{size},
+	m_category{category}
+{
+	glCreateBuffers(1, &m_buffer);
+	glNamedBufferStorage(m_buffer, size, data, flags);
+	gpu_memory_add(m_category, m_size);
+}
+
+Buffer::Buffer(Buffer &&other):
+	m_buffer{std::exchange(other.m_buffer, 0)},
+	m_size{std::exchange(other.m_size, 0)},
+	m_category{std::move(other.m_category)}
+{;}
+
+Buffer &Buffer::operator=(Buffer &&other) {
+	if(this != &other) {
+		reset();
+		m_buffer = std::exchange(other.m_buffer, 0);
+		m_size = std::exchange(other.m_size, 0);
+		m_category = std::move(other.m_category);
+	}
+	return *this;
+}
+
+Buffer::~Buffer() {
+	reset();
+}
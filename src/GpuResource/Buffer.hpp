@@ -0,0 +1,41 @@
+#ifndef BUFFER_HEADER
+#define BUFFER_HEADER
+
+#include <GL/gl.h>
+#include <cstddef>
+#include <string>
+
+// A buffer with immutable storage (glNamedBufferStorage), counted in
+// GpuMemory under its category. Move-only; a default constructed or
+// moved-from Buffer owns nothing.
+class Buffer
+{
+private:
+	GLuint m_buffer;
+	size_t m_size;
+	std::string m_category;
+public:
+	operator GLuint() const;
+	explicit operator bool() const;
+	size_t size() const;
+
+	// Needs GL_DYNAMIC_STORAGE_BIT.
+	void sub_data(GLintptr offset, GLsizeiptr size, const void *data);
+	// Needs the matching GL_MAP_*_BIT flags; persistent mappings stay valid
+	// until the buffer is deleted.
+	void *map(GLintptr offset, GLsizeiptr length, GLbitfield access);
+	void label(const std::string &name);
+	// Deletes the buffer; the Buffer is empty afterwards.
+	void reset();
+
+	Buffer();
+	// data may be null.
+	Buffer(const std::string &category, size_t size, const void *data, GLbitfield flags);
+	Buffer(const Buffer&) = delete;
+	Buffer &operator=(const Buffer&) = delete;
+	Buffer(Buffer &&other);
+	Buffer &operator=(Buffer &&other);
+	~Buffer();
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include <GL/glew.h>
+#include <GpuResource/Framebuffer.hpp>
+#include <GlDebug/GlDebug.hpp>
+#include <utility>
+#include <vector>
+
+Framebuffer::operator GLuint() const {
+	return m_framebuffer;
+}
+
+void Framebuffer::attach(GLenum attachment, const Texture &texture, GLint level) {
+	glNamedFramebufferTexture(m_framebuffer, attachment, texture, level);
+}
+
+void Framebuffer::draw_buffers(std::initializer_list<GLenum> buffers) {
+	std::vector<GLenum> list(buffers);
+	glNamedFramebufferDrawBuffers(m_framebuffer, list.size(), list.data());
+}
+
+bool Framebuffer::complete() {
+	return glCheckNamedFramebufferStatus(m_framebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+void Framebuffer::label(const std::string &name) {
+	gl_label(GL_FRAMEBUFFER, m_framebuffer, name);
+}
+
+void Framebuffer::reset() {
+	if(!m_framebuffer)
+		return;
+	glDeleteFramebuffers(1, &m_framebuffer);
+	m_framebuffer = 0;
+}
+
+Framebuffer::Framebuffer():
+	m_framebuffer{0}
+{
+	glCreateFramebuffers(1, &m_framebuffer);
+}
+
+Framebuffer::Framebuffer(Framebuffer &&other):
+	m_framebuffer{std::exchange(other.m_framebuffer, 0)}
+{;}
+
+Framebuffer &Framebuffer::operator=(Framebuffer &&other) {
+	if(this != &other) {
+		reset();
+		m_framebuffer = std::exchange(other.m_framebuffer, 0);
+	}
+	return *this;
+}
+
+Framebuffer::~Framebuffer() {
+	reset();
+}
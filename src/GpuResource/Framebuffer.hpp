@@ -0,0 +1,33 @@
+#ifndef FRAMEBUFFER_HEADER
+#define FRAMEBUFFER_HEADER
+
+#include <GL/gl.h>
+#include <initializer_list>
+#include <string>
+#include <GpuResource/Texture.hpp>
+
+// A framebuffer object, created through DSA. Holds no memory of its own,
+// its attachments are Textures owned elsewhere. Move-only.
+class Framebuffer
+{
+private:
+	GLuint m_framebuffer;
+public:
+	operator GLuint() const;
+
+	void attach(GLenum attachment, const Texture &texture, GLint level = 0);
+	void draw_buffers(std::initializer_list<GLenum> buffers);
+	bool complete();
+	void label(const std::string &name);
+	// Deletes the framebuffer; the Framebuffer is empty afterwards.
+	void reset();
+
+	Framebuffer();
+	Framebuffer(const Framebuffer&) = delete;
+	Framebuffer &operator=(const Framebuffer&) = delete;
+	Framebuffer(Framebuffer &&other);
+	Framebuffer &operator=(Framebuffer &&other);
+	~Framebuffer();
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include <GpuResource/GpuMemory.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <mutex>
+
+namespace {
+
+std::mutex mutex;
+std::map<std::string, GpuMemoryCategory> categories;
+
+std::string format_bytes(size_t bytes)
+{
+	char buf[32];
+	if(bytes >= (1 << 20))
+		std::snprintf(buf, sizeof(buf), "%.1f MiB", bytes/double(1 << 20));
+	else if(bytes >= (1 << 10))
+		std::snprintf(buf, sizeof(buf), "%.1f KiB", bytes/double(1 << 10));
+	else
+		std::snprintf(buf, sizeof(buf), "%zu B", bytes);
+	return buf;
+}
+
+}
+
+void gpu_memory_add(const std::string &category, size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	GpuMemoryCategory &entry = categories[category];
+	entry.name = category;
+	entry.bytes += bytes;
+	++entry.objects;
+}
+
+void gpu_memory_remove(const std::string &category, size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = categories.find(category);
+	if(it == categories.end())
+		return;
+	it->second.bytes -= std::min(bytes, it->second.bytes);
+	if(--it->second.objects == 0)
+		categories.erase(it);
+}
+
+size_t gpu_memory_total()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t total = 0;
+	for(auto &category : categories)
+		total += category.second.bytes;
+	return total;
+}
+
+std::vector<GpuMemoryCategory> gpu_memory_report()
+{
+	std::vector<GpuMemoryCategory> report;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for(auto &category : categories)
+			report.push_back(category.second);
+	}
+	std::stable_sort(report.begin(), report.end(), [](const GpuMemoryCategory &a, const GpuMemoryCategory &b){
+		return a.bytes > b.bytes;
+	});
+	return report;
+}
+
+std::string gpu_memory_describe()
+{
+	std::string str;
+	size_t total = 0;
+	for(auto &category : gpu_memory_report()) {
+		str += "\t" + category.name + ": " + format_bytes(category.bytes) + " in " +
+			std::to_string(category.objects) + (category.objects == 1 ? " object\n" : " objects\n");
+		total += category.bytes;
+	}
+	return str + "\ttotal: " + format_bytes(total) + "\n";
+}
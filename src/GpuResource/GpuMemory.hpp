@@ -0,0 +1,27 @@
+#ifndef GPU_MEMORY_HEADER
+#define GPU_MEMORY_HEADER
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Accounting of the GPU memory held by live Textures and Buffers, by
+// category ("G-buffer", "geometry", ...). Sizes are what the objects were
+// created with; driver padding, compression and alignment are not visible.
+// Thread safe.
+
+struct GpuMemoryCategory {
+	std::string name;
+	size_t bytes;
+	size_t objects;
+};
+
+void gpu_memory_add(const std::string &category, size_t bytes);
+void gpu_memory_remove(const std::string &category, size_t bytes);
+size_t gpu_memory_total();
+// Categories with live objects, largest first.
+std::vector<GpuMemoryCategory> gpu_memory_report();
+// One line per category and a total, e.g. "\tG-buffer: 94.9 MiB in 3 objects\n".
+std::string gpu_memory_describe();
+
+#endif
@@ -0,0 +1,127 @@
+#include <GL/glew.h>
+#include <GpuResource/Texture.hpp>
+#include <GpuResource/GpuMemory.hpp>
+#include <GlDebug/GlDebug.hpp>
+#include <utility>
+
+namespace {
+
+size_t level_bytes(GLuint texture, GLint level)
+{
+	GLint compressed = GL_FALSE;
+	glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_COMPRESSED, &compressed);
+	if(compressed) {
+		GLint size = 0;
+		glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+		return size;
+	}
+	GLint bits = 0;
+	for(GLenum name : {
+		GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE,
+		GL_TEXTURE_ALPHA_SIZE, GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE
+	}) {
+		GLint size = 0;
+		glGetTextureLevelParameteriv(texture, level, name, &size);
+		bits += size;
+	}
+	GLint width = 0, height = 0;
+	glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_WIDTH, &width);
+	glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_HEIGHT, &height);
+	return static_cast<size_t>((bits+7)/8)*width*height;
+}
+
+}
+
+Texture::operator GLuint() const {
+	return m_texture;
+}
+
+Texture::operator bool() const {
+	return m_texture != 0;
+}
+
+GLenum Texture::format() const {
+	return m_format;
+}
+
+GLsizei Texture::width() const {
+	return m_width;
+}
+
+GLsizei Texture::height() const {
+	return m_height;
+}
+
+size_t Texture::bytes() const {
+	return m_bytes;
+}
+
+void Texture::parameter(GLenum name, GLint value) {
+	glTextureParameteri(m_texture, name, value);
+}
+
+void Texture::bind(GLuint unit) {
+	glBindTextureUnit(unit, m_texture);
+}
+
+void Texture::label(const std::string &name) {
+	gl_label(GL_TEXTURE, m_texture, name);
+}
+
+void Texture::reset() {
+	if(!m_texture)
+		return;
+	glDeleteTextures(1, &m_texture);
+	gpu_memory_remove(m_category, m_bytes);
+	m_texture = 0;
+	m_bytes = 0;
+}
+
+Texture::Texture():
+	m_texture{0},
+	m_format{GL_NONE},
+	m_width{0},
+	m_height{0},
+	m_bytes{0}
+{;}
+
+Texture::Texture(const std::string &category, GLenum internal_format, GLsizei width, GLsizei height, GLsizei levels):
+	m_texture{0},
+	m_format{internal_format},
+	m_width{width},
+	m_height{height},
+	m_bytes{0},
+	m_category{category}
+{
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_texture);
+	glTextureStorage2D(m_texture, levels, internal_format, width, height);
+	for(GLint level=0;level<levels;++level)
+		m_bytes += level_bytes(m_texture, level);
+	gpu_memory_add(m_category, m_bytes);
+}
+
+Texture::Texture(Texture &&other):
+	m_texture{std::exchange(other.m_texture, 0)},
+	m_format{other.m_format},
+	m_width{other.m_width},
+	m_height{other.m_height},
+	m_bytes{std::exchange(other.m_bytes, 0)},
+	m_category{std::move(other.m_category)}
+{;}
+
+Texture &Texture::operator=(Texture &&other) {
+	if(this != &other) {
+		reset();
+		m_texture = std::exchange(other.m_texture, 0);
+		m_format = other.m_format;
+		m_width = other.m_width;
+		m_height = other.m_height;
+		m_bytes = std::exchange(other.m_bytes, 0);
+		m_category = std::move(other.m_category);
+	}
+	return *this;
+}
+
+Texture::~Texture() {
+	reset();
+}
@@ -0,0 +1,44 @@
+#ifndef TEXTURE_HEADER
+#define TEXTURE_HEADER
+
+#include <GL/gl.h>
+#include <cstddef>
+#include <string>
+
+// A 2D texture with immutable storage, created through DSA and counted in
+// GpuMemory under its category. Move-only; a default constructed or
+// moved-from Texture owns nothing.
+class Texture
+{
+private:
+	GLuint m_texture;
+	GLenum m_format;
+	GLsizei m_width;
+	GLsizei m_height;
+	size_t m_bytes;
+	std::string m_category;
+public:
+	operator GLuint() const;
+	explicit operator bool() const;
+	GLenum format() const;
+	GLsizei width() const;
+	GLsizei height() const;
+	// As the driver reports the format, summed over the levels.
+	size_t bytes() const;
+
+	void parameter(GLenum name, GLint value);
+	void bind(GLuint unit);
+	void label(const std::string &name);
+	// Deletes the texture; the Texture is empty afterwards.
+	void reset();
+
+	Texture();
+	Texture(const std::string &category, GLenum internal_format, GLsizei width, GLsizei height, GLsizei levels = 1);
+	Texture(const Texture&) = delete;
+	Texture &operator=(const Texture&) = delete;
+	Texture(Texture &&other);
+	Texture &operator=(Texture &&other);
+	~Texture();
+};
+
+#endif
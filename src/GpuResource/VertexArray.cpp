@@ -0,0 +1,51 @@
+#include <GL/glew.h>
+#include <GpuResource/VertexArray.hpp>
+#include <GlDebug/GlDebug.hpp>
+#include <utility>
+
+VertexArray::operator GLuint() const {
+	return m_vertex_array;
+}
+
+void VertexArray::vertex_buffer(GLuint binding, const Buffer &buffer, GLintptr offset, GLsizei stride) {
+	glVertexArrayVertexBuffer(m_vertex_array, binding, buffer, offset, stride);
+}
+
+void VertexArray::attribute(GLuint index, GLuint binding, GLint size, GLenum type, GLuint offset) {
+	glVertexArrayAttribFormat(m_vertex_array, index, size, type, GL_FALSE, offset);
+	glVertexArrayAttribBinding(m_vertex_array, index, binding);
+	glEnableVertexArrayAttrib(m_vertex_array, index);
+}
+
+void VertexArray::label(const std::string &name) {
+	gl_label(GL_VERTEX_ARRAY, m_vertex_array, name);
+}
+
+void VertexArray::reset() {
+	if(!m_vertex_array)
+		return;
+	glDeleteVertexArrays(1, &m_vertex_array);
+	m_vertex_array = 0;
+}
+
+VertexArray::VertexArray():
+	m_vertex_array{0}
+{
+	glCreateVertexArrays(1, &m_vertex_array);
+}
+
+VertexArray::VertexArray(VertexArray &&other):
+	m_vertex_array{std::exchange(other.m_vertex_array, 0)}
+{;}
+
+VertexArray &VertexArray::operator=(VertexArray &&other) {
+	if(this != &other) {
+		reset();
+		m_vertex_array = std::exchange(other.m_vertex_array, 0);
+	}
+	return *this;
+}
+
+VertexArray::~VertexArray() {
+	reset();
+}
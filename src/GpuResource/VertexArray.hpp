@@ -0,0 +1,33 @@
+#ifndef VERTEX_ARRAY_HEADER
+#define VERTEX_ARRAY_HEADER
+
+#include <GL/gl.h>
+#include <string>
+#include <GpuResource/Buffer.hpp>
+
+// A vertex array object, created through DSA. The vertex buffer bindings
+// are part of its state, so drawing only needs the vertex array bound.
+// Holds no memory of its own. Move-only.
+class VertexArray
+{
+private:
+	GLuint m_vertex_array;
+public:
+	operator GLuint() const;
+
+	void vertex_buffer(GLuint binding, const Buffer &buffer, GLintptr offset, GLsizei stride);
+	// Enables float attribute index, sourced from binding.
+	void attribute(GLuint index, GLuint binding, GLint size, GLenum type, GLuint offset);
+	void label(const std::string &name);
+	// Deletes the vertex array; the VertexArray is empty afterwards.
+	void reset();
+
+	VertexArray();
+	VertexArray(const VertexArray&) = delete;
+	VertexArray &operator=(const VertexArray&) = delete;
+	VertexArray(VertexArray &&other);
+	VertexArray &operator=(VertexArray &&other);
+	~VertexArray();
+};
+
+#endif
@@ -0,0 +1,57 @@
+#include <GL/glew.h>
+#include <GpuTimer/GpuTimer.hpp>
+#include <algorithm>
+
+void GpuTimer::begin() {
+	Pair &pair = m_pairs[m_next];
+	m_open = !pair.pending;
+	if(m_open)
+		glQueryCounter(pair.begin, GL_TIMESTAMP);
+}
+
+void GpuTimer::end() {
+	if(!m_open)
+		return;
+	Pair &pair = m_pairs[m_next];
+	glQueryCounter(pair.end, GL_TIMESTAMP);
+	pair.pending = true;
+	m_open = false;
+	m_next = (m_next+1) % m_pairs.size();
+}
+
+void GpuTimer::poll(std::vector<uint64_t> &durations) {
+	// Queries complete in submission order.
+	while(m_pairs[m_oldest].pending) {
+		Pair &pair = m_pairs[m_oldest];
+		GLint available = 0;
+		glGetQueryObjectiv(pair.end, GL_QUERY_RESULT_AVAILABLE, &available);
+		if(!available)
+			break;
+		GLuint64 begin, end;
+		glGetQueryObjectui64v(pair.begin, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(pair.end, GL_QUERY_RESULT, &end);
+		durations.push_back(end > begin ? end-begin : 0);
+		pair.pending = false;
+		m_oldest = (m_oldest+1) % m_pairs.size();
+	}
+}
+
+GpuTimer::GpuTimer(unsigned depth):
+	m_pairs(std::max(depth, 2u)),
+	m_next{0},
+	m_oldest{0},
+	m_open{false}
+{
+	for(auto &pair : m_pairs) {
+		glCreateQueries(GL_TIMESTAMP, 1, &pair.begin);
+		glCreateQueries(GL_TIMESTAMP, 1, &pair.end);
+		pair.pending = false;
+	}
+}
+
+GpuTimer::~GpuTimer() {
+	for(auto &pair : m_pairs) {
+		glDeleteQueries(1, &pair.begin);
+		glDeleteQueries(1, &pair.end);
+	}
+}
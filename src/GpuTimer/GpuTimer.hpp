@@ -0,0 +1,38 @@
+#ifndef GPU_TIMER_HEADER
+#define GPU_TIMER_HEADER
+
+#include <GL/gl.h>
+#include <cstdint>
+#include <vector>
+
+// Measures GPU time between begin() and end() with GL_TIMESTAMP queries,
+// without ever waiting for them. Query pairs go round a small ring; a
+// result is collected by poll() a few frames later once it is available.
+// When the ring is still full of pending pairs, a frame is not measured
+// rather than stalling.
+class GpuTimer
+{
+private:
+	struct Pair {
+		GLuint begin;
+		GLuint end;
+		bool pending;
+	};
+	std::vector<Pair> m_pairs;
+	unsigned m_next;
+	unsigned m_oldest;
+	bool m_open;
+public:
+	void begin();
+	void end();
+	// Appends the durations that finished since the last call, oldest first,
+	// in nanoseconds.
+	void poll(std::vector<uint64_t> &durations);
+
+	explicit GpuTimer(unsigned depth = 4);
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer &operator=(const GpuTimer&) = delete;
+	~GpuTimer();
+};
+
+#endif
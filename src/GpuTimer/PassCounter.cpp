@@ -0,0 +1,88 @@
+#include <GL/glew.h>
+#include <GpuTimer/PassCounter.hpp>
+#include <algorithm>
+
+bool PassCounter::counts_fragments() {
+	return m_count_fragments;
+}
+
+void PassCounter::begin() {
+	Slot &slot = m_slots[m_next];
+	m_open = !slot.pending;
+	if(!m_open)
+		return;
+	glBeginQuery(GL_TIME_ELAPSED, slot.time);
+	if(m_count_fragments)
+		glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, slot.fragments);
+}
+
+void PassCounter::end() {
+	if(!m_open)
+		return;
+	Slot &slot = m_slots[m_next];
+	glEndQuery(GL_TIME_ELAPSED);
+	if(m_count_fragments)
+		glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+	slot.pending = true;
+	m_open = false;
+	m_next = (m_next+1) % m_slots.size();
+}
+
+void PassCounter::poll() {
+	while(m_slots[m_oldest].pending) {
+		Slot &slot = m_slots[m_oldest];
+		// Both queries ended together, the later one decides.
+		GLint available = 0;
+		glGetQueryObjectiv(m_count_fragments ? slot.fragments : slot.time, GL_QUERY_RESULT_AVAILABLE, &available);
+		if(!available)
+			break;
+		GLuint64 time, fragments = 0;
+		glGetQueryObjectui64v(slot.time, GL_QUERY_RESULT, &time);
+		if(m_count_fragments)
+			glGetQueryObjectui64v(slot.fragments, GL_QUERY_RESULT, &fragments);
+		++m_frames;
+		m_time_ns += time;
+		m_fragments += fragments;
+		slot.pending = false;
+		m_oldest = (m_oldest+1) % m_slots.size();
+	}
+}
+
+PassCounter::Interval PassCounter::next_interval() {
+	Interval interval{m_frames, 0.0, 0.0};
+	if(m_frames) {
+		interval.time_ms = m_time_ns/m_frames/1e6;
+		interval.fragments = m_fragments/m_frames;
+	}
+	m_frames = 0;
+	m_time_ns = 0.0;
+	m_fragments = 0.0;
+	return interval;
+}
+
+PassCounter::PassCounter(unsigned depth):
+	m_slots(std::max(depth, 2u)),
+	m_next{0},
+	m_oldest{0},
+	m_open{false},
+	m_count_fragments{GLEW_VERSION_4_6 || GLEW_ARB_pipeline_statistics_query},
+	m_frames{0},
+	m_time_ns{0.0},
+	m_fragments{0.0}
+{
+	for(auto &slot : m_slots) {
+		glCreateQueries(GL_TIME_ELAPSED, 1, &slot.time);
+		slot.fragments = 0;
+		if(m_count_fragments)
+			glCreateQueries(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, 1, &slot.fragments);
+		slot.pending = false;
+	}
+}
+
+PassCounter::~PassCounter() {
+	for(auto &slot : m_slots) {
+		glDeleteQueries(1, &slot.time);
+		if(slot.fragments)
+			glDeleteQueries(1, &slot.fragments);
+	}
+}
@@ -0,0 +1,51 @@
+#ifndef PASS_COUNTER_HEADER
+#define PASS_COUNTER_HEADER
+
+#include <GL/gl.h>
+#include <vector>
+
+// GPU time of one render pass and, where pipeline statistics queries are
+// available (GL 4.6 or GL_ARB_pipeline_statistics_query), the number of
+// fragment shader invocations it caused. Like GpuTimer, queries go round
+// a small ring and are collected without waiting; a frame whose slot is
+// still pending is not measured. Uses GL_TIME_ELAPSED, so passes measured
+// this way must not overlap.
+class PassCounter
+{
+public:
+	struct Interval {
+		unsigned long long frames;
+		// Averages per measured frame.
+		double time_ms;
+		double fragments;
+	};
+private:
+	struct Slot {
+		GLuint time;
+		GLuint fragments;
+		bool pending;
+	};
+	std::vector<Slot> m_slots;
+	unsigned m_next;
+	unsigned m_oldest;
+	bool m_open;
+	bool m_count_fragments;
+
+	unsigned long long m_frames;
+	double m_time_ns;
+	double m_fragments;
+public:
+	bool counts_fragments();
+	void begin();
+	void end();
+	void poll();
+	// Averages since the last call, then starts over.
+	Interval next_interval();
+
+	explicit PassCounter(unsigned depth = 4);
+	PassCounter(const PassCounter&) = delete;
+	PassCounter &operator=(const PassCounter&) = delete;
+	~PassCounter();
+};
+
+#endif
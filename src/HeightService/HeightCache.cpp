@@ -0,0 +1,114 @@
+#include <HeightService/HeightCache.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const size_t shard_count = 16;
+
+uint64_t point_key(float x, float y)
+{
+	uint32_t bx, by;
+	std::memcpy(&bx, &x, sizeof(bx));
+	std::memcpy(&by, &y, sizeof(by));
+	return static_cast<uint64_t>(bx) << 32 | by;
+}
+
+// |value| < limit for a positive limit, on the bit patterns: they order
+// like the magnitudes and put infinities and NaNs above every finite
+// value, whatever the compiler assumes about float arithmetic.
+bool magnitude_below(float value, float limit)
+{
+	uint32_t bv, bl;
+	std::memcpy(&bv, &value, sizeof(bv));
+	std::memcpy(&bl, &limit, sizeof(bl));
+	return (bv & 0x7FFFFFFFu) < bl;
+}
+
+}
+
+bool HeightCache::covers(float x, float y) const {
+	// Tile coordinates well inside int32.
+	float limit = m_tile_size*1073741824.f;
+	return magnitude_below(x, limit) && magnitude_below(y, limit);
+}
+
+uint64_t HeightCache::tile_key(float x, float y) {
+	int32_t tx = static_cast<int32_t>(std::floor(x/m_tile_size));
+	int32_t ty = static_cast<int32_t>(std::floor(y/m_tile_size));
+	return static_cast<uint64_t>(static_cast<uint32_t>(tx)) << 32 | static_cast<uint32_t>(ty);
+}
+
+HeightCache::Shard &HeightCache::shard(uint64_t tile) {
+	// Neighbouring tiles land in different shards.
+	uint64_t mixed = tile * 0x9E3779B97F4A7C15ull;
+	return *m_shards[(mixed >> 32) % m_shards.size()];
+}
+
+bool HeightCache::find(float x, float y, bool normal, Result &result) {
+	uint64_t key = tile_key(x, y);
+	Shard &shard = this->shard(key);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	auto tile = shard.tiles.find(key);
+	if(tile != shard.tiles.end()) {
+		auto point = tile->second.points.find(point_key(x, y));
+		if(point != tile->second.points.end() && (point->second.has_normal || !normal)) {
+			shard.lru.splice(shard.lru.begin(), shard.lru, tile->second.lru);
+			++shard.stats.hits;
+			result = point->second;
+			return true;
+		}
+	}
+	++shard.stats.misses;
+	return false;
+}
+
+void HeightCache::insert(float x, float y, const Result &result) {
+	uint64_t key = tile_key(x, y);
+	Shard &shard = this->shard(key);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	auto tile = shard.tiles.find(key);
+	if(tile == shard.tiles.end()) {
+		if(shard.tiles.size() >= m_max_tiles_per_shard) {
+			shard.tiles.erase(shard.lru.back());
+			shard.lru.pop_back();
+			++shard.stats.evictions;
+		}
+		shard.lru.push_front(key);
+		tile = shard.tiles.emplace(key, Tile()).first;
+		tile->second.lru = shard.lru.begin();
+	}
+	else
+		shard.lru.splice(shard.lru.begin(), shard.lru, tile->second.lru);
+
+	auto &points = tile->second.points;
+	auto point = points.find(point_key(x, y));
+	if(point != points.end())
+		point->second = result;
+	else if(points.size() < m_max_points_per_tile)
+		points.emplace(point_key(x, y), result);
+}
+
+HeightCache::Stats HeightCache::stats() {
+	Stats total{0, 0, 0, 0};
+	for(auto &shard : m_shards) {
+		std::lock_guard<std::mutex> lock(shard->mutex);
+		total.hits += shard->stats.hits;
+		total.misses += shard->stats.misses;
+		total.evictions += shard->stats.evictions;
+		total.tiles += shard->tiles.size();
+	}
+	return total;
+}
+
+HeightCache::HeightCache(float tile_size, size_t max_tiles, size_t max_points_per_tile):
+	m_tile_size{tile_size > 0.f ? tile_size : 1.f},
+	m_max_tiles_per_shard{std::max<size_t>(1, max_tiles/shard_count)},
+	m_max_points_per_tile{max_points_per_tile}
+{
+	for(size_t i=0;i<shard_count;++i) {
+		m_shards.emplace_back(new Shard);
+		m_shards.back()->stats = {0, 0, 0, 0};
+	}
+}
@@ -0,0 +1,67 @@
+#ifndef HEIGHT_CACHE_HEADER
+#define HEIGHT_CACHE_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Heights (and normals) already computed for exact query points, grouped
+// by the square tile of terrain they lie in. Simulations keep asking about
+// the same spots, and the spots of one area are wanted and forgotten
+// together, so whole tiles are evicted least recently used first. Points
+// are keyed by their bit patterns, a cached answer is exactly the computed
+// one.
+//
+// Split into shards by tile, each with its own lock, so the query workers
+// rarely wait for each other.
+class HeightCache
+{
+public:
+	struct Result {
+		float height;
+		float normal[3];
+		bool has_normal;
+	};
+	struct Stats {
+		unsigned long long hits;
+		unsigned long long misses;
+		unsigned long long evictions;
+		size_t tiles;
+	};
+private:
+	struct Tile {
+		std::unordered_map<uint64_t, Result> points;
+		std::list<uint64_t>::iterator lru;
+	};
+	struct Shard {
+		std::mutex mutex;
+		std::unordered_map<uint64_t, Tile> tiles;
+		// Most recently used first.
+		std::list<uint64_t> lru;
+		Stats stats;
+	};
+
+	float m_tile_size;
+	size_t m_max_tiles_per_shard;
+	size_t m_max_points_per_tile;
+	std::vector<std::unique_ptr<Shard>> m_shards;
+
+	uint64_t tile_key(float x, float y);
+	Shard &shard(uint64_t tile);
+public:
+	// Whether (x, y) is finite and within the tiles the cache can key. Points
+	// from clients must be checked before they get near the cache.
+	bool covers(float x, float y) const;
+	// False when (x, y) is not cached, or without a normal when one is needed.
+	bool find(float x, float y, bool normal, Result &result);
+	void insert(float x, float y, const Result &result);
+	Stats stats();
+
+	HeightCache(float tile_size, size_t max_tiles, size_t max_points_per_tile);
+};
+
+#endif
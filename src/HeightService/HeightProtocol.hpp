@@ -0,0 +1,69 @@
+#ifndef HEIGHT_PROTOCOL_HEADER
+#define HEIGHT_PROTOCOL_HEADER
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <unistd.h>
+
+// Framing of the height query service (tools/heightd), spoken over a Unix
+// stream socket in native byte order.
+//
+//   request:  HeightHeader | count*(float x, float y)
+//   response: HeightHeader | count*float height [| count*(float nx, ny, nz)]
+//
+// The response repeats the request's header, with count set to 0 when the
+// request was refused. Normals are only sent when asked for with
+// height_flag_normals. A client may send further requests before the
+// answers arrive; they are answered in order.
+const uint32_t height_magic = 0x51485449; // "ITHQ"
+const uint16_t height_version = 1;
+const uint32_t height_max_count = 1 << 20;
+
+enum : uint16_t {
+	height_flag_normals = 1,
+};
+
+struct HeightHeader {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t flags;
+	uint32_t count;
+	// Chosen by the client, echoed back.
+	uint32_t id;
+};
+
+static_assert(sizeof(HeightHeader) == 16, "the height header is part of the wire format");
+
+// Blocking reads and writes of exactly size bytes; false on EOF or error.
+inline bool read_exact(int fd, void *data, size_t size)
+{
+	char *bytes = static_cast<char*>(data);
+	while(size > 0) {
+		ssize_t got = read(fd, bytes, size);
+		if(got < 0 && errno == EINTR)
+			continue;
+		if(got <= 0)
+			return false;
+		bytes += got;
+		size -= got;
+	}
+	return true;
+}
+
+inline bool write_exact(int fd, const void *data, size_t size)
+{
+	const char *bytes = static_cast<const char*>(data);
+	while(size > 0) {
+		ssize_t written = write(fd, bytes, size);
+		if(written < 0 && errno == EINTR)
+			continue;
+		if(written <= 0)
+			return false;
+		bytes += written;
+		size -= written;
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,193 @@
+#include <GL/glew.h>
+#include <Horizon/HorizonMaps.hpp>
+#include <GlState/GlState.hpp>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace {
+
+// The Horizons block in lighting/shader.frag.
+struct HorizonBlock {
+	glm::ivec4 window;
+	glm::vec4 params;
+	glm::ivec4 slots[HorizonMaps::max_window*HorizonMaps::max_window/4];
+};
+
+// Both compute shaders run 8x8 groups.
+GLuint groups(int texels)
+{
+	return (texels+7)/8;
+}
+
+}
+
+float HorizonMaps::region_size() const {
+	return m_settings.region_texels*m_settings.spacing;
+}
+
+glm::ivec2 HorizonMaps::window_origin(glm::vec2 camera) const {
+	return glm::ivec2(glm::floor(camera/region_size())) - m_window/2;
+}
+
+void HorizonMaps::build(int slot, glm::ivec2 region, GLuint heights_program, GLuint horizon_program, GlState &gl_state) {
+	int size = m_settings.region_texels+1;
+	int scratch = size + 2*m_settings.apron;
+	glm::vec2 origin = glm::vec2(region)*region_size() - static_cast<float>(m_settings.apron)*m_settings.spacing;
+
+	gl_state.use_program(heights_program);
+	glProgramUniform2f(heights_program, 0, origin.x, origin.y);
+	glProgramUniform1f(heights_program, 1, m_settings.spacing);
+	glBindImageTexture(0, m_heights, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	glDispatchCompute(groups(scratch), groups(scratch), 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	glm::ivec2 offset = glm::ivec2(slot % m_atlas_slots, slot / m_atlas_slots)*size;
+	gl_state.use_program(horizon_program);
+	gl_state.bind_texture_unit(heights_unit, m_heights);
+	glProgramUniform1i(horizon_program, 0, m_settings.apron);
+	glProgramUniform2i(horizon_program, 1, offset.x, offset.y);
+	glProgramUniform1i(horizon_program, 2, size);
+	glProgramUniform1f(horizon_program, 3, m_settings.spacing);
+	glBindImageTexture(1, m_low, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+	glBindImageTexture(2, m_high, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+	glDispatchCompute(groups(size), groups(size), 1);
+	// The next build writes the heights this one reads.
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+void HorizonMaps::upload() {
+	HorizonBlock block;
+	block.window = glm::ivec4(m_origin, m_window, m_atlas_slots);
+	block.params = glm::vec4(region_size(), m_low.width(), m_settings.region_texels+1, 0.f);
+	for(size_t i=0;i<static_cast<size_t>(max_window*max_window);++i)
+		block.slots[i/4][i%4] = i < m_table.size() ? m_table[i] : -1;
+	m_block.sub_data(0, sizeof(block), &block);
+}
+
+bool HorizonMaps::outdated(glm::vec2 camera) const {
+	return !m_origin_known || window_origin(camera) != m_origin || m_stats.pending;
+}
+
+void HorizonMaps::update(glm::vec2 camera, GLuint heights_program, GLuint horizon_program, GlState &gl_state) {
+	++m_update;
+	glm::ivec2 origin = window_origin(camera);
+	bool changed = !m_origin_known || origin != m_origin;
+	m_origin = origin;
+	m_origin_known = true;
+
+	// Regions still in the window keep their slots.
+	std::vector<int> table(m_window*m_window, -1);
+	for(size_t i=0;i<m_slots.size();++i) {
+		Slot &slot = m_slots[i];
+		glm::ivec2 cell = slot.region - origin;
+		if(!slot.used || cell.x < 0 || cell.y < 0 || cell.x >= m_window || cell.y >= m_window)
+			continue;
+		table[cell.y*m_window + cell.x] = i;
+		slot.wanted = m_update;
+	}
+
+	std::vector<std::pair<float, int>> missing;
+	for(size_t i=0;i<table.size();++i) {
+		if(table[i] >= 0)
+			continue;
+		glm::ivec2 region = origin + glm::ivec2(i % m_window, i / m_window);
+		glm::vec2 center = (glm::vec2(region) + 0.5f)*region_size();
+		missing.emplace_back(glm::distance(center, camera), i);
+	}
+	std::sort(missing.begin(), missing.end());
+
+	int built = 0;
+	for(auto &entry : missing) {
+		if(built == m_settings.budget)
+			break;
+		// A free slot, else the one longest out of the window. There are
+		// more slots than window regions, so there always is one.
+		int free = -1;
+		for(size_t i=0;i<m_slots.size();++i) {
+			if(!m_slots[i].used) {
+				free = i;
+				break;
+			}
+			if(m_slots[i].wanted < m_update && (free < 0 || m_slots[i].wanted < m_slots[free].wanted))
+				free = i;
+		}
+		if(free < 0)
+			break;
+		if(m_slots[free].used)
+			++m_stats.evicted;
+
+		glm::ivec2 region = origin + glm::ivec2(entry.second % m_window, entry.second / m_window);
+		build(free, region, heights_program, horizon_program, gl_state);
+		m_slots[free] = Slot{region, true, m_update};
+		table[entry.second] = free;
+		++built;
+	}
+	// Before the lighting pass samples the atlas.
+	if(built)
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	m_stats.built += built;
+	m_stats.pending = missing.size() - built;
+	m_stats.resident = table.size() - m_stats.pending;
+	if(changed || built) {
+		m_table = std::move(table);
+		upload();
+		++m_generation;
+	}
+}
+
+uint64_t HorizonMaps::generation() const {
+	return m_generation;
+}
+
+HorizonMaps::Stats HorizonMaps::stats() const {
+	return m_stats;
+}
+
+HorizonMaps::HorizonMaps():
+	HorizonMaps(Settings())
+{;}
+
+HorizonMaps::HorizonMaps(const Settings &settings):
+	m_settings(settings),
+	m_origin{0},
+	m_origin_known{false},
+	m_update{0},
+	m_generation{0},
+	m_stats{0, 0, 0, 0}
+{
+	m_settings.region_texels = std::max(m_settings.region_texels, 1);
+	m_settings.spacing = m_settings.spacing > 0.f ? m_settings.spacing : 1.f;
+	m_settings.apron = std::max(m_settings.apron, 1);
+	m_settings.budget = std::max(m_settings.budget, 1);
+	int reach = static_cast<int>(std::ceil(std::max(m_settings.view_distance, 0.f)/region_size()));
+	m_window = std::min(2*reach+1, static_cast<int>(max_window));
+	// A spare row and column of slots keeps regions the camera just left
+	// around for a while.
+	m_atlas_slots = m_window+1;
+	m_slots.assign(m_atlas_slots*m_atlas_slots, Slot{glm::ivec2(0), false, 0});
+	m_table.assign(m_window*m_window, -1);
+
+	int size = m_settings.region_texels+1;
+	int scratch = size + 2*m_settings.apron;
+	m_heights = Texture("horizon", GL_R32F, scratch, scratch);
+	m_low = Texture("horizon", GL_RGBA8, m_atlas_slots*size, m_atlas_slots*size);
+	m_high = Texture("horizon", GL_RGBA8, m_atlas_slots*size, m_atlas_slots*size);
+	for(Texture *texture : {&m_heights, &m_low, &m_high}) {
+		texture->parameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		texture->parameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		texture->parameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		texture->parameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	m_heights.label("horizon heights");
+	m_low.label("horizons 0-3");
+	m_high.label("horizons 4-7");
+	m_low.bind(low_unit);
+	m_high.bind(high_unit);
+
+	m_block = Buffer("uniforms", sizeof(HorizonBlock), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	m_block.label("horizons");
+	glBindBufferBase(GL_UNIFORM_BUFFER, block_binding, m_block);
+	upload();
+}
@@ -0,0 +1,106 @@
+#ifndef HORIZON_MAPS_HEADER
+#define HORIZON_MAPS_HEADER
+
+#include <GL/gl.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include <GpuResource/Buffer.hpp>
+#include <GpuResource/Texture.hpp>
+
+class GlState;
+
+// Horizon angles of the terrain around the camera, which the lighting pass
+// turns into sun shadows and large-scale ambient occlusion with a texture
+// fetch per pixel.
+//
+// Terrain space is cut into square regions. A region is built by two
+// compute passes: horizon/heights.comp samples the terrain function over
+// the region and an apron around it, horizon/shader.comp then finds, for
+// every texel and eight azimuths, how high the terrain rises within the
+// apron. Results go into a slot of an atlas (two RGBA8 textures, four
+// azimuths each) and stay there while the region is in the window of
+// regions around the camera; regions that left it give up their slots
+// when new ones need them, longest gone first. Nearest regions are built
+// first and only a few per update, so crossing into new ground never
+// stalls a frame; the lighting pass treats regions not built yet as open.
+//
+// The lighting program reads the window through the Horizons uniform
+// block (binding 2) and the atlas on units 9 and 10.
+class HorizonMaps
+{
+public:
+	struct Settings {
+		// Texels between a region's edges, and terrain units between texels.
+		int region_texels = 128;
+		float spacing = 8.f;
+		// How far texels look for their horizon, in texels.
+		int apron = 128;
+		// Regions closer to the camera than this are kept built.
+		float view_distance = 3000.f;
+		// Region builds per update.
+		int budget = 4;
+	};
+	struct Stats {
+		unsigned long long built;
+		unsigned long long evicted;
+		// Window regions built and still waiting.
+		unsigned resident;
+		unsigned pending;
+	};
+
+	static constexpr GLuint block_binding = 2;
+	static constexpr GLuint low_unit = 9;
+	static constexpr GLuint high_unit = 10;
+	// Where horizon/shader.comp reads the heights.
+	static constexpr GLuint heights_unit = 11;
+	// The Horizons block has room for this many regions per window side.
+	static constexpr int max_window = 8;
+private:
+	struct Slot {
+		glm::ivec2 region;
+		bool used;
+		// The last update whose window held the region.
+		uint64_t wanted;
+	};
+
+	Settings m_settings;
+	int m_window;
+	int m_atlas_slots;
+	std::vector<Slot> m_slots;
+	// Slot of each window region, row by row, -1 while not built.
+	std::vector<int> m_table;
+	glm::ivec2 m_origin;
+	bool m_origin_known;
+	uint64_t m_update;
+	uint64_t m_generation;
+
+	Texture m_heights;
+	Texture m_low;
+	Texture m_high;
+	Buffer m_block;
+
+	Stats m_stats;
+
+	float region_size() const;
+	glm::ivec2 window_origin(glm::vec2 camera) const;
+	void build(int slot, glm::ivec2 region, GLuint heights_program, GLuint horizon_program, GlState &gl_state);
+	void upload();
+public:
+	// Whether update() has anything to do with the camera at this terrain
+	// position: the window moved or regions in it are not built yet.
+	bool outdated(glm::vec2 camera) const;
+	// Moves the window to the camera and builds up to the budget of its
+	// missing regions, nearest first.
+	void update(glm::vec2 camera, GLuint heights_program, GLuint horizon_program, GlState &gl_state);
+	// Changes whenever what the lighting pass reads changed.
+	uint64_t generation() const;
+	Stats stats() const;
+
+	HorizonMaps();
+	explicit HorizonMaps(const Settings &settings);
+	HorizonMaps(const HorizonMaps&) = delete;
+	HorizonMaps &operator=(const HorizonMaps&) = delete;
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include <Image/Image.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+void flip_rows(const uint8_t *src, uint8_t *dst, size_t row_bytes, int height)
+{
+	for(int y=0;y<height;++y)
+		std::memcpy(dst + row_bytes*y, src + row_bytes*(height-1-y), row_bytes);
+}
+
+bool write_qoi(const std::string &path, int width, int height, const uint8_t *rgba)
+{
+	enum : uint8_t {
+		QOI_OP_INDEX = 0x00,
+		QOI_OP_DIFF  = 0x40,
+		QOI_OP_LUMA  = 0x80,
+		QOI_OP_RUN   = 0xc0,
+		QOI_OP_RGB   = 0xfe,
+		QOI_OP_RGBA  = 0xff,
+	};
+
+	size_t pixels = static_cast<size_t>(width)*height;
+	std::vector<uint8_t> out;
+	out.reserve(14 + pixels*2 + 8);
+	const uint8_t header[14] = {
+		'q', 'o', 'i', 'f',
+		uint8_t(width>>24), uint8_t(width>>16), uint8_t(width>>8), uint8_t(width),
+		uint8_t(height>>24), uint8_t(height>>16), uint8_t(height>>8), uint8_t(height),
+		4, 0
+	};
+	out.insert(out.end(), header, header+sizeof(header));
+
+	uint8_t index[64][4] = {};
+	uint8_t prev[4] = {0, 0, 0, 255};
+	int run = 0;
+	for(size_t i=0;i<pixels;++i) {
+		const uint8_t *px = rgba + i*4;
+		if(std::memcmp(px, prev, 4) == 0) {
+			if(++run == 62 || i+1 == pixels) {
+				out.push_back(QOI_OP_RUN | (run-1));
+				run = 0;
+			}
+			continue;
+		}
+		if(run) {
+			out.push_back(QOI_OP_RUN | (run-1));
+			run = 0;
+		}
+
+		int hash = (px[0]*3 + px[1]*5 + px[2]*7 + px[3]*11) % 64;
+		if(std::memcmp(index[hash], px, 4) == 0) {
+			out.push_back(QOI_OP_INDEX | hash);
+		}
+		else {
+			std::memcpy(index[hash], px, 4);
+			if(px[3] == prev[3]) {
+				int8_t dr = px[0]-prev[0], dg = px[1]-prev[1], db = px[2]-prev[2];
+				int8_t dr_dg = dr-dg, db_dg = db-dg;
+				if(dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+					out.push_back(QOI_OP_DIFF | (dr+2)<<4 | (dg+2)<<2 | (db+2));
+				}
+				else if(dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+					out.push_back(QOI_OP_LUMA | (dg+32));
+					out.push_back((dr_dg+8)<<4 | (db_dg+8));
+				}
+				else {
+					out.push_back(QOI_OP_RGB);
+					out.insert(out.end(), px, px+3);
+				}
+			}
+			else {
+				out.push_back(QOI_OP_RGBA);
+				out.insert(out.end(), px, px+4);
+			}
+		}
+		std::memcpy(prev, px, 4);
+	}
+	const uint8_t padding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+	out.insert(out.end(), padding, padding+sizeof(padding));
+
+	std::FILE *f = std::fopen(path.c_str(), "wb");
+	if(!f)
+		return false;
+	bool ok = std::fwrite(out.data(), 1, out.size(), f) == out.size();
+	return std::fclose(f) == 0 && ok;
+}
+
+void rgba_to_i420(const uint8_t *rgba, int width, int height, uint8_t *y, uint8_t *u, uint8_t *v)
+{
+	for(int row=0;row<height;++row) {
+		const uint8_t *px = rgba + static_cast<size_t>(row)*width*4;
+		uint8_t *out = y + static_cast<size_t>(row)*width;
+		for(int x=0;x<width;++x, px+=4)
+			out[x] = (77*px[0] + 150*px[1] + 29*px[2] + 128) >> 8;
+	}
+	for(int row=0;row<height/2;++row) {
+		const uint8_t *top = rgba + static_cast<size_t>(row*2)*width*4;
+		const uint8_t *bottom = top + static_cast<size_t>(width)*4;
+		uint8_t *out_u = u + static_cast<size_t>(row)*(width/2);
+		uint8_t *out_v = v + static_cast<size_t>(row)*(width/2);
+		for(int x=0;x<width/2;++x) {
+			int r = top[x*8+0] + top[x*8+4] + bottom[x*8+0] + bottom[x*8+4];
+			int g = top[x*8+1] + top[x*8+5] + bottom[x*8+1] + bottom[x*8+5];
+			int b = top[x*8+2] + top[x*8+6] + bottom[x*8+2] + bottom[x*8+6];
+			// Sums of four pixels, hence the extra >> 2.
+			out_u[x] = std::min(255, (-43*r - 85*g + 128*b + (128<<10) + 512) >> 10);
+			out_v[x] = std::min(255, (128*r - 107*g - 21*b + (128<<10) + 512) >> 10);
+		}
+	}
+}
@@ -0,0 +1,19 @@
+#ifndef IMAGE_HEADER
+#define IMAGE_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Copies height rows of row_bytes each from src to dst in reverse order,
+// turning GL's bottom-up readbacks into top-down images.
+void flip_rows(const uint8_t *src, uint8_t *dst, size_t row_bytes, int height);
+
+// Writes RGBA8 pixels as a QOI image (https://qoiformat.org).
+bool write_qoi(const std::string &path, int width, int height, const uint8_t *rgba);
+
+// Converts RGBA8 to planar YUV 4:2:0 with full-range BT.601 coefficients
+// (Y4M's C420jpeg). width and height must be even; alpha is ignored.
+void rgba_to_i420(const uint8_t *rgba, int width, int height, uint8_t *y, uint8_t *u, uint8_t *v);
+
+#endif
@@ -0,0 +1,193 @@
+#include <Jobs/JobSystem.hpp>
+#include <Trace/Trace.hpp>
+#include <algorithm>
+
+struct Job {
+	std::function<void()> fn;
+	// Unfinished dependencies, plus one held by spawn() until the job is
+	// fully set up.
+	std::atomic<unsigned> waiting;
+	// Keeps a queued job alive; the deques hold plain pointers.
+	JobSystem::Task self;
+
+	std::mutex mutex;
+	std::vector<JobSystem::Task> dependents;
+	std::atomic<bool> finished;
+};
+
+namespace {
+
+// The system whose worker is running on this thread, if any.
+thread_local JobSystem *current_system = nullptr;
+thread_local unsigned current_index = 0;
+// Where this thread starts looking for jobs to steal.
+thread_local unsigned steal_start = 0;
+
+}
+
+void JobSystem::run(unsigned index) {
+	trace_thread_name("jobs");
+	current_system = this;
+	current_index = index;
+	steal_start = index+1;
+	for(;;) {
+		if(Job *job = find(index)) {
+			execute(job);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(m_mutex);
+		++m_sleeping;
+		m_work_cv.wait(lock, [this]{return m_stop || m_queued > 0;});
+		--m_sleeping;
+		if(m_stop && m_queued <= 0)
+			return;
+	}
+}
+
+Job *JobSystem::find(unsigned index) {
+	Job *job = nullptr;
+	if(index < m_deques.size())
+		job = m_deques[index]->pop();
+	if(!job) {
+		std::lock_guard<std::mutex> lock(m_injected_mutex);
+		if(!m_injected.empty()) {
+			job = m_injected.front();
+			m_injected.pop_front();
+		}
+	}
+	unsigned count = m_deques.size();
+	for(unsigned i=0;!job && i<count;++i) {
+		unsigned victim = (steal_start+i) % count;
+		if(victim != index)
+			job = m_deques[victim]->steal();
+	}
+	if(job) {
+		++steal_start;
+		--m_queued;
+	}
+	return job;
+}
+
+void JobSystem::execute(Job *job) {
+	Task keep = std::move(job->self);
+	{
+		TRACE_ZONE("job");
+		job->fn();
+	}
+	job->fn = nullptr;
+
+	std::vector<Task> dependents;
+	{
+		std::lock_guard<std::mutex> lock(job->mutex);
+		job->finished = true;
+		dependents.swap(job->dependents);
+	}
+	for(auto &dependent : dependents)
+		release(dependent);
+	if(m_blocked > 0) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_done_cv.notify_all();
+	}
+}
+
+void JobSystem::release(const Task &job) {
+	if(--job->waiting == 0)
+		enqueue(job);
+}
+
+void JobSystem::enqueue(const Task &job) {
+	job->self = job;
+	if(current_system != this || !m_deques[current_index]->push(job.get())) {
+		std::lock_guard<std::mutex> lock(m_injected_mutex);
+		m_injected.push_back(job.get());
+	}
+	++m_queued;
+	if(m_sleeping > 0) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_work_cv.notify_one();
+	}
+}
+
+JobSystem::Task JobSystem::spawn(std::function<void()> fn, const std::vector<Task> &after) {
+	Task job = std::make_shared<Job>();
+	job->fn = std::move(fn);
+	job->waiting = 1;
+	job->finished = false;
+	for(auto &dependency : after) {
+		if(!dependency)
+			continue;
+		std::lock_guard<std::mutex> lock(dependency->mutex);
+		if(!dependency->finished) {
+			++job->waiting;
+			dependency->dependents.push_back(job);
+		}
+	}
+	release(job);
+	return job;
+}
+
+bool JobSystem::done(const Task &task) {
+	return !task || task->finished;
+}
+
+void JobSystem::wait(const Task &task) {
+	if(current_system == this) {
+		while(!done(task)) {
+			if(Job *job = find(current_index))
+				execute(job);
+			else
+				std::this_thread::yield();
+		}
+		return;
+	}
+	std::unique_lock<std::mutex> lock(m_mutex);
+	++m_blocked;
+	m_done_cv.wait(lock, [&]{return done(task);});
+	--m_blocked;
+}
+
+void JobSystem::parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)> &body) {
+	if(begin >= end)
+		return;
+	grain = std::max<size_t>(grain, 1);
+	if(end - begin <= grain) {
+		body(begin, end);
+		return;
+	}
+	// Hands off the upper half and splits the lower one further, so the
+	// biggest pieces are the first ones up for stealing.
+	size_t middle = begin + (end-begin)/2;
+	Task upper = spawn([this, middle, end, grain, &body]{
+		parallel_for(middle, end, grain, body);
+	});
+	parallel_for(begin, middle, grain, body);
+	wait(upper);
+}
+
+unsigned JobSystem::threads() {
+	return m_threads.size();
+}
+
+JobSystem::JobSystem(unsigned threads):
+	m_queued{0},
+	m_sleeping{0},
+	m_blocked{0},
+	m_stop{false}
+{
+	if(threads == 0)
+		threads = 1;
+	for(unsigned i=0;i<threads;++i)
+		m_deques.emplace_back(new WorkStealingDeque<Job>);
+	for(unsigned i=0;i<threads;++i)
+		m_threads.emplace_back(&JobSystem::run, this, i);
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_work_cv.notify_all();
+	for(auto &thread : m_threads)
+		thread.join();
+}
@@ -0,0 +1,74 @@
+#ifndef JOB_SYSTEM_HEADER
+#define JOB_SYSTEM_HEADER
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <Jobs/WorkStealingDeque.hpp>
+
+struct Job;
+
+// Work-stealing scheduler for CPU-side jobs.
+//
+// Every worker thread owns a deque: jobs spawned from inside a job go onto
+// the spawning worker's own deque and are run from there newest first,
+// idle workers steal the oldest ones from the others. Jobs spawned from
+// any other thread go through a shared queue and start in submission
+// order. A job may depend on others and only becomes runnable once they all
+// finished, so small task graphs can be built up front.
+//
+// wait() on a worker runs other jobs until the awaited one finished, so
+// jobs may wait on jobs they spawned; other threads simply block. Pending
+// jobs are still run before the destructor returns.
+class JobSystem
+{
+public:
+	using Task = std::shared_ptr<Job>;
+private:
+	std::vector<std::unique_ptr<WorkStealingDeque<Job>>> m_deques;
+	std::mutex m_injected_mutex;
+	std::deque<Job*> m_injected;
+
+	// Runnable jobs not yet taken, briefly negative when a job was taken
+	// before it was counted.
+	std::atomic<long> m_queued;
+	std::mutex m_mutex;
+	std::condition_variable m_work_cv;
+	std::condition_variable m_done_cv;
+	std::atomic<unsigned> m_sleeping;
+	std::atomic<unsigned> m_blocked;
+	bool m_stop;
+	std::vector<std::thread> m_threads;
+
+	void run(unsigned index);
+	// A runnable job for the worker at index, or for another thread when
+	// index is past the workers.
+	Job *find(unsigned index);
+	void execute(Job *job);
+	// Drops one of the job's unmet dependencies, queueing it after the last.
+	void release(const Task &job);
+	void enqueue(const Task &job);
+public:
+	// Runs fn once every task in after finished; null tasks are ignored.
+	Task spawn(std::function<void()> fn, const std::vector<Task> &after = {});
+	bool done(const Task &task);
+	// Returns once task finished, right away for a null task.
+	void wait(const Task &task);
+	// Calls body(lo, hi) on disjoint ranges covering [begin, end), each at
+	// most grain long, in parallel. Returns once all of them did.
+	void parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)> &body);
+	unsigned threads();
+
+	explicit JobSystem(unsigned threads = std::thread::hardware_concurrency());
+	JobSystem(const JobSystem&) = delete;
+	JobSystem &operator=(const JobSystem&) = delete;
+	~JobSystem();
+};
+
+#endif
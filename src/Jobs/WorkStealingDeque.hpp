@@ -0,0 +1,78 @@
+#ifndef WORK_STEALING_DEQUE_HEADER
+#define WORK_STEALING_DEQUE_HEADER
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Chase-Lev deque of pointers with a fixed capacity. The owning thread
+// pushes and pops at the bottom, last in first out, so it keeps working on
+// what it split off most recently while that is still in cache; any other
+// thread steals from the top, taking the oldest and usually largest piece
+// of work. Memory orders follow Le et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models". A steal that loses a race returns
+// nothing rather than retrying.
+template<typename T, size_t capacity = 4096>
+class WorkStealingDeque
+{
+	static_assert((capacity & (capacity-1)) == 0, "capacity must be a power of two");
+private:
+	alignas(64) std::atomic<int64_t> m_top;
+	alignas(64) std::atomic<int64_t> m_bottom;
+	alignas(64) std::array<std::atomic<T*>, capacity> m_items;
+public:
+	// Owner only. False when full.
+	bool push(T *item) {
+		int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+		int64_t top = m_top.load(std::memory_order_acquire);
+		if(bottom - top >= static_cast<int64_t>(capacity))
+			return false;
+		m_items[bottom & (capacity-1)].store(item, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_bottom.store(bottom+1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Owner only. Null when empty.
+	T *pop() {
+		int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+		m_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t top = m_top.load(std::memory_order_relaxed);
+		if(top > bottom) {
+			m_bottom.store(bottom+1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		T *item = m_items[bottom & (capacity-1)].load(std::memory_order_relaxed);
+		if(top == bottom) {
+			// The last item, thieves may be after it too.
+			if(!m_top.compare_exchange_strong(top, top+1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				item = nullptr;
+			m_bottom.store(bottom+1, std::memory_order_relaxed);
+		}
+		return item;
+	}
+
+	// Any thread. Null when empty or another thread got there first.
+	T *steal() {
+		int64_t top = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t bottom = m_bottom.load(std::memory_order_acquire);
+		if(top >= bottom)
+			return nullptr;
+		T *item = m_items[top & (capacity-1)].load(std::memory_order_relaxed);
+		if(!m_top.compare_exchange_strong(top, top+1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr;
+		return item;
+	}
+
+	WorkStealingDeque():
+		m_top{0},
+		m_bottom{0}
+	{;}
+	WorkStealingDeque(const WorkStealingDeque&) = delete;
+	WorkStealingDeque &operator=(const WorkStealingDeque&) = delete;
+};
+
+#endif
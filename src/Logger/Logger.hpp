@@ -1,35 +1,111 @@
 #ifndef LOGGER_HEADER
 #define LOGGER_HEADER
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <memory>
 #include <ostream>
+#include <string>
+#include <thread>
 #include <glm/glm.hpp>
 
-std::wostream &operator<<(std::wostream &o, glm::vec3 &v)
+inline std::wostream &operator<<(std::wostream &o, glm::vec3 &v)
 {
 	return o<<'('<<v.x<<','<<' '<<v.y<<','<<' '<<v.z<<')';
 }
 
+enum class LogLevel : uint8_t {trace, debug, info, warning, error};
+
+// Messages below LOG_LEVEL are compiled out by the LOG_* macros, their
+// arguments are never evaluated. 0 is trace, 4 only errors.
+#ifndef LOG_LEVEL
+#define LOG_LEVEL 2
+#endif
+
+#define LOG_AT(logger, level, ...) \
+	do { \
+		if constexpr(static_cast<int>(level) >= LOG_LEVEL) \
+			(logger).log(level, __VA_ARGS__); \
+	} while(0)
+#define LOG_TRACE(logger, ...) LOG_AT(logger, LogLevel::trace, __VA_ARGS__)
+#define LOG_DEBUG(logger, ...) LOG_AT(logger, LogLevel::debug, __VA_ARGS__)
+#define LOG_INFO(logger, ...) LOG_AT(logger, LogLevel::info, __VA_ARGS__)
+#define LOG_WARNING(logger, ...) LOG_AT(logger, LogLevel::warning, __VA_ARGS__)
+#define LOG_ERROR(logger, ...) LOG_AT(logger, LogLevel::error, __VA_ARGS__)
+
+// Asynchronous logger. log() formats the message on the calling thread into
+// fixed-size records in a bounded lock-free ring and returns; a writer
+// thread batches whatever is queued into the stream and flushes once per
+// batch. Producers never block and never touch the stream: when the ring is
+// full the message is dropped and counted, and the writer reports the count.
+//
+// A message longer than one record takes several consecutive records,
+// claimed at once so messages from other threads never interleave with it.
 template<typename CharT>
 class Logger
 {
 public:
 	using StreamType = std::basic_ostream<CharT>;
+
+	static constexpr size_t record_bytes = 512;
+	static constexpr size_t ring_records = 2048;
+	// Longer messages are truncated.
+	static constexpr size_t max_message_records = 64;
+private:
+	struct RecordHeader {
+		std::atomic<size_t> sequence;
+		int64_t timestamp;
+		LogLevel level;
+		bool timestamped;
+		// The message goes on in the next record.
+		bool continued;
+		uint16_t length;
+	};
+public:
+	static constexpr size_t record_chars = (record_bytes - sizeof(RecordHeader))/sizeof(CharT);
 private:
-	StreamType *m_ostream;
-	bool m_enable_log;
+	struct Record : RecordHeader {
+		CharT text[record_chars];
+	};
+	static_assert(sizeof(Record) <= record_bytes, "log records must fit record_bytes");
+	static_assert((ring_records & (ring_records-1)) == 0, "the log ring size must be a power of two");
+
+	std::atomic<StreamType*> m_ostream;
+	std::atomic<bool> m_enable_log;
 	std::chrono::high_resolution_clock::time_point m_time_start;
+
+	std::unique_ptr<Record[]> m_records;
+	alignas(64) std::atomic<size_t> m_tail;
+	alignas(64) std::atomic<size_t> m_written;
+	std::atomic<unsigned long long> m_dropped;
+	std::atomic<bool> m_stop;
+	std::thread m_writer;
+
+	void push(LogLevel level, const CharT *text, size_t length, bool ts);
+	void write();
 public:
 	void enable_log(bool enable_log);
 	bool enable_log();
-	
+
+	// Flushes what is queued before switching streams.
 	void stream(StreamType &ostream);
 	StreamType &stream();
 
 	template<typename OutputT>
 	void log(OutputT out, bool ts=true);
+	template<typename OutputT>
+	void log(LogLevel level, OutputT out, bool ts=true);
+
+	// Blocks until everything logged so far was written.
+	void flush();
+	// Messages lost to a full ring.
+	unsigned long long dropped();
 
 	Logger(StreamType &stream);
+	Logger(const Logger&) = delete;
+	Logger &operator=(const Logger&) = delete;
+	~Logger();
 };
 
 #include "Logger/Logger.inl"
-#endif
\ No newline at end of file
+#endif
@@ -1,7 +1,12 @@
 #ifndef LOGGER_IMPL
 #define LOGGER_IMPL
 #include "Logger/Logger.hpp"
+#include <algorithm>
+#include <cstddef>
 #include <iomanip>
+#include <sstream>
+#include <string_view>
+#include <type_traits>
 
 template<typename CharT>
 void Logger<CharT>::enable_log(bool enable_log){m_enable_log=enable_log;}
@@ -9,7 +14,11 @@ template<typename CharT>
 bool Logger<CharT>::enable_log(){return m_enable_log;}
 
 template<typename CharT>
-void Logger<CharT>::stream(StreamType &ostream){m_ostream=&ostream;}
+void Logger<CharT>::stream(StreamType &ostream)
+{
+	flush();
+	m_ostream.store(&ostream, std::memory_order_release);
+}
 template<typename CharT>
 typename Logger<CharT>::StreamType &Logger<CharT>::stream(){return *m_ostream;}
 
@@ -17,21 +26,156 @@ template<typename CharT>
 template<typename OutputT>
 void Logger<CharT>::log(OutputT out, bool ts)
 {
-	if(ts) {
-		(*m_ostream)<<static_cast<CharT>('[');
-		(*m_ostream)<<std::setw(15);
-		(*m_ostream)<<(std::chrono::high_resolution_clock::now()-m_time_start).count();
-		(*m_ostream)<<static_cast<CharT>(']');
-		(*m_ostream)<<static_cast<CharT>(' ');
+	log(LogLevel::info, out, ts);
+}
+
+template<typename CharT>
+template<typename OutputT>
+void Logger<CharT>::log(LogLevel level, OutputT out, bool ts)
+{
+	if(!m_enable_log.load(std::memory_order_relaxed))
+		return;
+	if constexpr(std::is_convertible<const OutputT&, std::basic_string_view<CharT>>::value) {
+		std::basic_string_view<CharT> text = out;
+		push(level, text.data(), text.size(), ts);
+	}
+	else {
+		// Anything else goes through a stream, reused by the thread.
+		thread_local std::basic_ostringstream<CharT> buffer;
+		buffer.str({});
+		buffer.clear();
+		buffer<<out;
+		std::basic_string<CharT> text = buffer.str();
+		push(level, text.data(), text.size(), ts);
+	}
+}
+
+template<typename CharT>
+void Logger<CharT>::push(LogLevel level, const CharT *text, size_t length, bool ts)
+{
+	const size_t mask = ring_records-1;
+	size_t count = std::max<size_t>(1, (length + record_chars-1)/record_chars);
+	count = std::min(count, max_message_records);
+	length = std::min(length, count*record_chars);
+
+	// Records are freed in order, so once the last one of the run is free
+	// all of them are.
+	size_t position = m_tail.load(std::memory_order_relaxed);
+	for(;;) {
+		size_t last = position + count-1;
+		size_t sequence = m_records[last & mask].sequence.load(std::memory_order_acquire);
+		auto difference = static_cast<std::ptrdiff_t>(sequence - last);
+		if(difference == 0) {
+			if(m_tail.compare_exchange_weak(position, position+count, std::memory_order_relaxed))
+				break;
+		}
+		else if(difference < 0) {
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		else {
+			position = m_tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	int64_t timestamp = (std::chrono::high_resolution_clock::now()-m_time_start).count();
+	for(size_t i=0;i<count;++i) {
+		Record &record = m_records[(position+i) & mask];
+		size_t offset = i*record_chars;
+		record.timestamp = timestamp;
+		record.level = level;
+		record.timestamped = ts && i == 0;
+		record.continued = i+1 < count;
+		record.length = static_cast<uint16_t>(std::min(record_chars, length-offset));
+		std::copy(text+offset, text+offset+record.length, record.text);
+		record.sequence.store(position+i+1, std::memory_order_release);
+	}
+}
+
+template<typename CharT>
+void Logger<CharT>::write()
+{
+	static const char *level_names[] = {"trace: ", "debug: ", "", "warning: ", "error: "};
+	const size_t mask = ring_records-1;
+
+	std::basic_ostringstream<CharT> batch;
+	size_t head = 0;
+	bool continuing = false;
+	unsigned long long reported = 0;
+	for(;;) {
+		bool stop = m_stop.load(std::memory_order_acquire);
+		size_t start = head;
+		while(head - start < ring_records) {
+			Record &record = m_records[head & mask];
+			if(record.sequence.load(std::memory_order_acquire) != head+1)
+				break;
+			if(record.timestamped)
+				batch<<static_cast<CharT>('[')<<std::setw(15)<<record.timestamp<<static_cast<CharT>(']')<<static_cast<CharT>(' ');
+			if(!continuing)
+				batch<<level_names[static_cast<int>(record.level)];
+			batch.write(record.text, record.length);
+			continuing = record.continued;
+			record.sequence.store(head + ring_records, std::memory_order_release);
+			++head;
+		}
+
+		unsigned long long dropped = m_dropped.load(std::memory_order_relaxed);
+		if(dropped != reported && !continuing) {
+			batch<<static_cast<CharT>('[')<<std::setw(15)<<(std::chrono::high_resolution_clock::now()-m_time_start).count()
+			     <<static_cast<CharT>(']')<<static_cast<CharT>(' ')<<(dropped-reported)<<" log messages dropped\n";
+			reported = dropped;
+		}
+
+		if(batch.tellp() > 0) {
+			StreamType &ostream = *m_ostream.load(std::memory_order_acquire);
+			ostream<<batch.str();
+			ostream.flush();
+			batch.str({});
+			m_written.store(head, std::memory_order_release);
+		}
+		else if(stop) {
+			break;
+		}
+		else {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
 	}
-	(*m_ostream)<<out;
-	m_ostream->flush();
+}
+
+template<typename CharT>
+void Logger<CharT>::flush()
+{
+	size_t target = m_tail.load(std::memory_order_acquire);
+	while(m_written.load(std::memory_order_acquire) < target)
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+}
+
+template<typename CharT>
+unsigned long long Logger<CharT>::dropped()
+{
+	return m_dropped.load(std::memory_order_relaxed);
 }
 
 template<typename CharT>
 Logger<CharT>::Logger(StreamType &stream):
 	m_ostream{&stream},
 	m_enable_log{true},
-	m_time_start{std::chrono::high_resolution_clock::now()}
-{;}
-#endif
\ No newline at end of file
+	m_time_start{std::chrono::high_resolution_clock::now()},
+	m_records{new Record[ring_records]},
+	m_tail{0},
+	m_written{0},
+	m_dropped{0},
+	m_stop{false}
+{
+	for(size_t i=0;i<ring_records;++i)
+		m_records[i].sequence.store(i, std::memory_order_relaxed);
+	m_writer = std::thread(&Logger::write, this);
+}
+
+template<typename CharT>
+Logger<CharT>::~Logger()
+{
+	m_stop.store(true, std::memory_order_release);
+	m_writer.join();
+}
+#endif
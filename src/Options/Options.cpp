@@ -0,0 +1,48 @@
+#include <Options/Options.hpp>
+#include <cstdlib>
+
+bool Options::has(const std::string &name) const {
+	return m_values.count(name) != 0;
+}
+
+std::string Options::get(const std::string &name, const std::string &fallback) const {
+	auto value = m_values.find(name);
+	return value == m_values.end() ? fallback : value->second;
+}
+
+std::string Options::get(const std::string &name, const char *fallback) const {
+	return get(name, std::string(fallback));
+}
+
+int Options::get(const std::string &name, int fallback) const {
+	auto value = m_values.find(name);
+	if(value == m_values.end() || value->second.empty())
+		return fallback;
+	return std::atoi(value->second.c_str());
+}
+
+float Options::get(const std::string &name, float fallback) const {
+	auto value = m_values.find(name);
+	if(value == m_values.end() || value->second.empty())
+		return fallback;
+	return std::atof(value->second.c_str());
+}
+
+const std::vector<std::string> &Options::invalid() const {
+	return m_invalid;
+}
+
+Options::Options(int argc, char **argv) {
+	for(int i=1;i<argc;++i) {
+		std::string arg = argv[i];
+		if(arg.compare(0, 2, "--") != 0 || arg.size() == 2) {
+			m_invalid.push_back(arg);
+			continue;
+		}
+		std::string::size_type eq = arg.find('=');
+		if(eq == std::string::npos)
+			m_values[arg.substr(2)] = "";
+		else
+			m_values[arg.substr(2, eq-2)] = arg.substr(eq+1);
+	}
+}
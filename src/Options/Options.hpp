@@ -0,0 +1,26 @@
+#ifndef OPTIONS_HEADER
+#define OPTIONS_HEADER
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Command line options of the form --name=value or --flag.
+class Options
+{
+private:
+	std::map<std::string, std::string> m_values;
+	std::vector<std::string> m_invalid;
+public:
+	bool has(const std::string &name) const;
+	std::string get(const std::string &name, const std::string &fallback) const;
+	std::string get(const std::string &name, const char *fallback) const;
+	int get(const std::string &name, int fallback) const;
+	float get(const std::string &name, float fallback) const;
+	// Arguments that did not look like options.
+	const std::vector<std::string> &invalid() const;
+
+	Options(int argc, char **argv);
+};
+
+#endif
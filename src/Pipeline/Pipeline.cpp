@@ -0,0 +1,233 @@
+#include <GL/glew.h>
+#include <Pipeline/Pipeline.hpp>
+#include <Trace/Trace.hpp>
+#include <GlDebug/GlDebug.hpp>
+#include <algorithm>
+
+void Pipeline::start() {
+	TRACE_ZONE("Pipeline::start");
+	m_pending_shaders.clear();
+	m_pending_program.reset();
+	m_linking = false;
+	m_from_cache = false;
+	m_saved_us = 0;
+	m_start = clock::now();
+
+	std::vector<ShaderSource> sources(m_stages.size());
+	m_pending_hashes.assign(m_stages.size(), 0);
+	for(unsigned int i=0;i<m_stages.size();++i) {
+		if(!sources[i].load(*m_assets, m_stages[i].path, m_defines)) {
+			m_status = fail(sources[i].error());
+			return;
+		}
+		// Track new includes right away so fixing a broken one is noticed.
+		m_stage_files[i] = sources[i].files();
+		fnv1a hash;
+		sources[i].hash(hash);
+		m_pending_hashes[i] = hash.digest();
+	}
+
+	// Output bindings are baked into the binary, so they are part of the key.
+	std::vector<std::string> key_defines = m_defines;
+	for(auto &output : m_outputs)
+		key_defines.push_back("out " + std::to_string(output.location) + " " + output.name);
+
+	m_pending_key = 0;
+	if(m_cache && m_cache->enabled()) {
+		m_pending_key = m_cache->key(sources, key_defines);
+		m_pending_program.reset(new Program);
+		long long compile_us;
+		if(m_cache->load(*m_pending_program, m_pending_key, compile_us)) {
+			m_from_cache = true;
+			m_saved_us = std::max(0LL, compile_us - std::chrono::duration_cast<std::chrono::microseconds>(clock::now()-m_start).count());
+			swap();
+			m_status = Status::swapped;
+			return;
+		}
+		m_pending_program.reset();
+	}
+
+	m_pending_shaders.resize(m_stages.size());
+	for(unsigned int i=0;i<m_stages.size();++i) {
+		// The cache key above is made of these sources, so the program
+		// must be too: a stage whose edit was not reported yet is compiled
+		// as well.
+		if(!m_dirty.count(i) && *m_shaders[i] && m_shader_hashes[i] == m_pending_hashes[i])
+			continue;
+		m_pending_shaders[i].reset(new Shader);
+		m_pending_shaders[i]->create(m_stages[i].type);
+		m_pending_shaders[i]->set_src(sources[i].pieces());
+		m_pending_shaders[i]->compile();
+	}
+	m_status = Status::pending;
+}
+
+void Pipeline::swap() {
+	for(unsigned int i=0;i<m_stages.size();++i) {
+		if(m_from_cache) {
+			// The binary did not come from our shader objects, so none of
+			// them can be reused by a later partial rebuild.
+			m_shaders[i].reset(new Shader);
+			m_shader_hashes[i] = 0;
+		}
+		else if(m_pending_shaders[i]) {
+			m_shaders[i] = std::move(m_pending_shaders[i]);
+			m_shader_hashes[i] = m_pending_hashes[i];
+		}
+	}
+	m_program = std::move(m_pending_program);
+	gl_label(GL_PROGRAM, *m_program, m_name);
+	m_pending_shaders.clear();
+	m_dirty.clear();
+	m_linking = false;
+	m_build_us = std::chrono::duration_cast<std::chrono::microseconds>(clock::now()-m_start).count();
+	m_log.clear();
+}
+
+Pipeline::Status Pipeline::fail(std::string log) {
+	m_log = std::move(log);
+	m_pending_shaders.clear();
+	m_pending_program.reset();
+	m_linking = false;
+	// m_dirty is kept so the next rebuild still picks up every stage that
+	// differs from the live program.
+	return Status::failed;
+}
+
+const std::string &Pipeline::name() {
+	return m_name;
+}
+
+const std::vector<Pipeline::Stage> &Pipeline::stages() {
+	return m_stages;
+}
+
+Program &Pipeline::program() {
+	return *m_program;
+}
+
+std::vector<std::string> Pipeline::files() {
+	std::vector<std::string> files;
+	for(auto &stage_files : m_stage_files)
+		for(auto &file : stage_files)
+			if(std::find(files.begin(), files.end(), file) == files.end())
+				files.push_back(file);
+	return files;
+}
+
+bool Pipeline::uses(const std::string &path) {
+	std::string normalized = normalize_path(path);
+	for(auto &stage_files : m_stage_files)
+		if(std::find(stage_files.begin(), stage_files.end(), normalized) != stage_files.end())
+			return true;
+	return false;
+}
+
+void Pipeline::rebuild() {
+	for(unsigned int i=0;i<m_stages.size();++i)
+		m_dirty.insert(i);
+	start();
+}
+
+void Pipeline::rebuild(const std::string &path) {
+	std::string normalized = normalize_path(path);
+	bool used = false;
+	for(unsigned int i=0;i<m_stages.size();++i) {
+		auto &stage_files = m_stage_files[i];
+		if(std::find(stage_files.begin(), stage_files.end(), normalized) != stage_files.end()) {
+			m_dirty.insert(i);
+			used = true;
+		}
+	}
+	if(used)
+		start();
+}
+
+Pipeline::Status Pipeline::poll() {
+	Status status = m_status;
+	if(status == Status::swapped || status == Status::failed)
+		m_status = Status::idle;
+	if(status != Status::pending)
+		return status;
+
+	if(!m_linking) {
+		for(auto &shader : m_pending_shaders)
+			if(shader && !shader->completion_status())
+				return Status::pending;
+
+		for(unsigned int i=0;i<m_stages.size();++i) {
+			if(m_pending_shaders[i] && !m_pending_shaders[i]->compile_status()) {
+				std::string log = m_stages[i].path + ":\n" + m_pending_shaders[i]->info_log();
+				for(unsigned int file=1;file<m_stage_files[i].size();++file)
+					log += "\nsource string " + std::to_string(file) + ": " + m_stage_files[i][file];
+				m_status = Status::idle;
+				return fail(log);
+			}
+		}
+
+		m_pending_program.reset(new Program);
+		for(unsigned int i=0;i<m_stages.size();++i)
+			m_pending_program->attach(m_pending_shaders[i] ? *m_pending_shaders[i] : *m_shaders[i]);
+		for(auto &output : m_outputs)
+			glBindFragDataLocation(*m_pending_program, output.location, output.name.c_str());
+		if(m_cache && m_cache->enabled())
+			m_pending_program->binary_retrievable(true);
+		m_pending_program->link();
+		m_linking = true;
+		return Status::pending;
+	}
+
+	if(!m_pending_program->completion_status())
+		return Status::pending;
+
+	m_status = Status::idle;
+	if(!m_pending_program->link_status())
+		return fail("Linking failed:\n" + m_pending_program->info_log());
+
+	swap();
+	if(m_cache && m_cache->enabled())
+		m_cache->store(*m_program, m_pending_key, m_build_us);
+	return Status::swapped;
+}
+
+const std::string &Pipeline::log() {
+	return m_log;
+}
+
+long long Pipeline::build_us() {
+	return m_build_us;
+}
+
+long long Pipeline::saved_us() {
+	return m_saved_us;
+}
+
+bool Pipeline::from_cache() {
+	return m_from_cache;
+}
+
+Pipeline::Pipeline(
+	std::string name, std::vector<Stage> stages,
+	std::vector<Output> outputs, std::vector<std::string> defines,
+	AssetStore &assets, ProgramCache *cache
+):
+	m_name{std::move(name)},
+	m_stages{std::move(stages)},
+	m_outputs{std::move(outputs)},
+	m_defines{std::move(defines)},
+	m_assets{&assets},
+	m_cache{cache},
+	m_program{new Program},
+	m_pending_key{0},
+	m_status{Status::idle},
+	m_linking{false},
+	m_build_us{0},
+	m_saved_us{0},
+	m_from_cache{false}
+{
+	for(auto &stage : m_stages) {
+		m_shaders.emplace_back(new Shader);
+		m_shader_hashes.push_back(0);
+		m_stage_files.push_back({normalize_path(stage.path)});
+	}
+}
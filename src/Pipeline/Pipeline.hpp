@@ -0,0 +1,107 @@
+#ifndef PIPELINE_HEADER
+#define PIPELINE_HEADER
+
+#include <GL/gl.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <Shader/Shader.hpp>
+#include <Program/Program.hpp>
+#include <ProgramCache/ProgramCache.hpp>
+#include <ShaderSource/ShaderSource.hpp>
+#include <Asset/Asset.hpp>
+
+// A program together with the shader files it is built from.
+//
+// Rebuilds never block: rebuild() only submits the compiles, poll() advances
+// them once per frame, and the live program is swapped for the new one only
+// after it linked successfully. While a rebuild is in flight, or after it
+// failed, the previous program stays live. Stages whose source did not
+// change keep their compiled shader objects and are only re-attached. A
+// stage's source is its file and every file it #includes; each rebuild
+// reloads all stages and compares them with what the live shaders were
+// compiled from, so edits reported in different frames are never missed.
+class Pipeline
+{
+public:
+	struct Stage {
+		GLenum type;
+		std::string path;
+	};
+	struct Output {
+		GLuint location;
+		std::string name;
+	};
+	enum class Status {
+		idle,    // nothing in flight
+		pending, // compile or link still running
+		swapped, // a new program went live (reported once)
+		failed,  // the rebuild failed, old program kept (reported once)
+	};
+private:
+	using clock = std::chrono::high_resolution_clock;
+
+	std::string m_name;
+	std::vector<Stage> m_stages;
+	std::vector<Output> m_outputs;
+	std::vector<std::string> m_defines;
+	AssetStore *m_assets;
+	ProgramCache *m_cache;
+	std::vector<std::vector<std::string>> m_stage_files;
+
+	std::vector<std::unique_ptr<Shader>> m_shaders;
+	// Hash of the source each of m_shaders was compiled from.
+	std::vector<uint64_t> m_shader_hashes;
+	std::unique_ptr<Program> m_program;
+
+	std::vector<std::unique_ptr<Shader>> m_pending_shaders;
+	std::vector<uint64_t> m_pending_hashes;
+	std::unique_ptr<Program> m_pending_program;
+	std::set<unsigned int> m_dirty;
+	uint64_t m_pending_key;
+	Status m_status;
+	bool m_linking;
+	clock::time_point m_start;
+
+	std::string m_log;
+	long long m_build_us;
+	long long m_saved_us;
+	bool m_from_cache;
+
+	void start();
+	void swap();
+	Status fail(std::string log);
+public:
+	const std::string &name();
+	const std::vector<Stage> &stages();
+	Program &program();
+	// Every file read by the last build, includes too.
+	std::vector<std::string> files();
+	bool uses(const std::string &path);
+
+	// Rebuilds every stage.
+	void rebuild();
+	// Rebuilds the stage(s) reading or including path, does nothing if
+	// none do.
+	void rebuild(const std::string &path);
+	Status poll();
+
+	// Details of the last swap or failure.
+	const std::string &log();
+	long long build_us();
+	long long saved_us();
+	bool from_cache();
+
+	Pipeline(
+		std::string name, std::vector<Stage> stages,
+		std::vector<Output> outputs, std::vector<std::string> defines,
+		AssetStore &assets, ProgramCache *cache = nullptr
+	);
+	Pipeline(const Pipeline&) = delete;
+	Pipeline &operator=(const Pipeline&) = delete;
+};
+
+#endif
@@ -0,0 +1,474 @@
+#include <PngWriter/PngWriter.hpp>
+#include <Trace/Trace.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <zlib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+struct PngBand {
+	// The last row of the previous band (zeros for the first), then the
+	// band's own rows.
+	std::vector<uint8_t> raw;
+	int rows;
+	bool last;
+
+	// Written by the encoding job, read once it finished.
+	std::vector<uint8_t> deflated;
+	size_t filtered_size;
+	uint32_t adler;
+	bool ok;
+	JobSystem::Task job;
+};
+
+namespace {
+
+const uint8_t png_signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+// Filter types as stored in front of each row.
+enum : uint8_t {
+	filter_none = 0,
+	filter_sub = 1,
+	filter_up = 2,
+	filter_average = 3,
+	filter_paeth = 4,
+};
+
+void put_u32(uint8_t *dst, uint32_t value)
+{
+	dst[0] = value >> 24;
+	dst[1] = value >> 16;
+	dst[2] = value >> 8;
+	dst[3] = value;
+}
+
+// All filters below read cur[i-bpp] only for i >= bpp; the first pixel has
+// no left neighbour and is handled separately.
+
+void filter_sub_row(const uint8_t *cur, size_t n, size_t bpp, uint8_t *out)
+{
+	size_t i = 0;
+	for(; i < bpp && i < n; ++i)
+		out[i] = cur[i];
+#ifdef __SSE2__
+	for(; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur+i));
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur+i-bpp));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out+i), _mm_sub_epi8(x, a));
+	}
+#endif
+	for(; i < n; ++i)
+		out[i] = cur[i] - cur[i-bpp];
+}
+
+void filter_up_row(const uint8_t *cur, const uint8_t *prev, size_t n, uint8_t *out)
+{
+	size_t i = 0;
+#ifdef __SSE2__
+	for(; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur+i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev+i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out+i), _mm_sub_epi8(x, b));
+	}
+#endif
+	for(; i < n; ++i)
+		out[i] = cur[i] - prev[i];
+}
+
+void filter_average_row(const uint8_t *cur, const uint8_t *prev, size_t n, size_t bpp, uint8_t *out)
+{
+	size_t i = 0;
+	for(; i < bpp && i < n; ++i)
+		out[i] = cur[i] - (prev[i] >> 1);
+#ifdef __SSE2__
+	const __m128i one = _mm_set1_epi8(1);
+	for(; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur+i));
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur+i-bpp));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev+i));
+		// _mm_avg_epu8 rounds up, PNG rounds down.
+		__m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out+i), _mm_sub_epi8(x, avg));
+	}
+#endif
+	for(; i < n; ++i)
+		out[i] = cur[i] - ((cur[i-bpp] + prev[i]) >> 1);
+}
+
+uint8_t paeth_predictor(int a, int b, int c)
+{
+	int pa = std::abs(b - c);
+	int pb = std::abs(a - c);
+	int pc = std::abs(a + b - 2*c);
+	if(pa <= pb && pa <= pc)
+		return a;
+	return pb <= pc ? b : c;
+}
+
+#ifdef __SSE2__
+__m128i select_epi16(__m128i mask, __m128i x, __m128i y)
+{
+	return _mm_or_si128(_mm_and_si128(mask, x), _mm_andnot_si128(mask, y));
+}
+
+__m128i abs_epi16(__m128i x)
+{
+	return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+// Paeth on eight 16 bit lanes. Encoding only reads unfiltered bytes, so
+// unlike decoding there is no dependency between neighbouring pixels.
+__m128i paeth_epi16(__m128i a, __m128i b, __m128i c)
+{
+	__m128i pa = abs_epi16(_mm_sub_epi16(b, c));
+	__m128i pb = abs_epi16(_mm_sub_epi16(a, c));
+	__m128i pc = abs_epi16(_mm_sub_epi16(_mm_add_epi16(a, b), _mm_add_epi16(c, c)));
+	__m128i b_or_c = select_epi16(_mm_cmpgt_epi16(pb, pc), c, b);
+	__m128i not_a = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+	return select_epi16(not_a, b_or_c, a);
+}
+#endif
+
+void filter_paeth_row(const uint8_t *cur, const uint8_t *prev, size_t n, size_t bpp, uint8_t *out)
+{
+	size_t i = 0;
+	// Without a left neighbour Paeth always predicts the byte above.
+	for(; i < bpp && i < n; ++i)
+		out[i] = cur[i] - prev[i];
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	for(; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur+i));
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur+i-bpp));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev+i));
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev+i-bpp));
+		__m128i lo = paeth_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+		__m128i hi = paeth_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out+i), _mm_sub_epi8(x, _mm_packus_epi16(lo, hi)));
+	}
+#endif
+	for(; i < n; ++i)
+		out[i] = cur[i] - paeth_predictor(cur[i-bpp], prev[i], prev[i-bpp]);
+}
+
+// The usual heuristic for picking a filter: the sum of the filtered bytes
+// taken as signed magnitudes.
+uint64_t row_cost(const uint8_t *row, size_t n)
+{
+	uint64_t cost = 0;
+	size_t i = 0;
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sum = zero;
+	for(; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row+i));
+		// |x| of a signed byte is the smaller of x and -x taken unsigned.
+		__m128i magnitude = _mm_min_epu8(x, _mm_sub_epi8(zero, x));
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(magnitude, zero));
+	}
+	cost = static_cast<uint64_t>(_mm_cvtsi128_si32(sum)) + static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+#endif
+	for(; i < n; ++i)
+		cost += std::abs(static_cast<int8_t>(row[i]));
+	return cost;
+}
+
+// Writes the filter type byte and the filtered row to out.
+void filter_row(PngFilter filter, const uint8_t *cur, const uint8_t *prev, size_t n, size_t bpp, uint8_t *out, std::vector<uint8_t> &scratch)
+{
+	switch(filter) {
+		case PngFilter::none:
+			out[0] = filter_none;
+			std::memcpy(out+1, cur, n);
+			return;
+		case PngFilter::sub:
+			out[0] = filter_sub;
+			filter_sub_row(cur, n, bpp, out+1);
+			return;
+		case PngFilter::up:
+			out[0] = filter_up;
+			filter_up_row(cur, prev, n, out+1);
+			return;
+		case PngFilter::paeth:
+			out[0] = filter_paeth;
+			filter_paeth_row(cur, prev, n, bpp, out+1);
+			return;
+		case PngFilter::adaptive:
+			break;
+	}
+
+	scratch.resize(4*n);
+	filter_sub_row(cur, n, bpp, &scratch[0]);
+	filter_up_row(cur, prev, n, &scratch[n]);
+	filter_average_row(cur, prev, n, bpp, &scratch[2*n]);
+	filter_paeth_row(cur, prev, n, bpp, &scratch[3*n]);
+	const uint8_t *candidates[5] = {cur, &scratch[0], &scratch[n], &scratch[2*n], &scratch[3*n]};
+
+	uint8_t best = filter_none;
+	uint64_t best_cost = row_cost(cur, n);
+	for(uint8_t type = filter_sub; type <= filter_paeth; ++type) {
+		uint64_t cost = row_cost(candidates[type], n);
+		if(cost < best_cost) {
+			best = type;
+			best_cost = cost;
+		}
+	}
+	out[0] = best;
+	std::memcpy(out+1, candidates[best], n);
+}
+
+void encode_band(PngBand &band, size_t row_bytes, size_t bpp, const PngSettings &settings)
+{
+	TRACE_ZONE("png band");
+	std::vector<uint8_t> filtered(band.rows*(row_bytes+1));
+	std::vector<uint8_t> scratch;
+	for(int row=0;row<band.rows;++row) {
+		const uint8_t *prev = &band.raw[row*row_bytes];
+		filter_row(settings.filter, prev+row_bytes, prev, row_bytes, bpp, &filtered[row*(row_bytes+1)], scratch);
+	}
+	band.raw.clear();
+	band.raw.shrink_to_fit();
+	band.filtered_size = filtered.size();
+	band.adler = adler32(adler32(0, Z_NULL, 0), filtered.data(), filtered.size());
+
+	// Raw deflate: the zlib header and checksum are written once for the
+	// whole stream by PngWriter.
+	z_stream z;
+	std::memset(&z, 0, sizeof(z));
+	int strategy = settings.filter == PngFilter::none ? Z_DEFAULT_STRATEGY : Z_FILTERED;
+	if(deflateInit2(&z, settings.level, Z_DEFLATED, -15, 8, strategy) != Z_OK) {
+		band.ok = false;
+		return;
+	}
+
+	// A sync flush adds an empty stored block on top of the bound.
+	band.deflated.resize(deflateBound(&z, filtered.size()) + 16);
+	z.next_in = filtered.data();
+	z.avail_in = filtered.size();
+	z.next_out = band.deflated.data();
+	z.avail_out = band.deflated.size();
+	int flush = band.last ? Z_FINISH : Z_SYNC_FLUSH;
+	band.ok = true;
+	for(;;) {
+		int ret = deflate(&z, flush);
+		if(ret == Z_STREAM_ERROR) {
+			band.ok = false;
+			break;
+		}
+		if(band.last ? ret == Z_STREAM_END : (z.avail_in == 0 && z.avail_out != 0))
+			break;
+		size_t used = band.deflated.size() - z.avail_out;
+		band.deflated.resize(band.deflated.size()*2);
+		z.next_out = band.deflated.data() + used;
+		z.avail_out = band.deflated.size() - used;
+	}
+	band.deflated.resize(band.deflated.size() - z.avail_out);
+	deflateEnd(&z);
+}
+
+}
+
+bool PngWriter::fail(std::string error) {
+	if(m_ok)
+		m_error = std::move(error);
+	m_ok = false;
+	return false;
+}
+
+bool PngWriter::write_chunk(const char *type, const std::vector<std::pair<const uint8_t*, size_t>> &pieces) {
+	size_t size = 0;
+	for(auto &piece : pieces)
+		size += piece.second;
+
+	uint8_t header[8];
+	put_u32(header, size);
+	std::memcpy(header+4, type, 4);
+	uLong crc = crc32(crc32(0, Z_NULL, 0), header+4, 4);
+	bool ok = std::fwrite(header, 1, sizeof(header), m_file) == sizeof(header);
+	for(auto &piece : pieces) {
+		crc = crc32(crc, piece.first, piece.second);
+		ok = ok && std::fwrite(piece.first, 1, piece.second, m_file) == piece.second;
+	}
+	uint8_t trailer[4];
+	put_u32(trailer, crc);
+	ok = ok && std::fwrite(trailer, 1, sizeof(trailer), m_file) == sizeof(trailer);
+	return ok || fail("Could not write " + m_path);
+}
+
+void PngWriter::submit() {
+	std::shared_ptr<PngBand> band = std::move(m_band);
+	m_band.reset();
+	band->last = m_rows == m_height;
+	// The next band filters its first row against this band's last one.
+	m_previous.assign(band->raw.end()-m_row_bytes, band->raw.end());
+	m_in_flight.push_back(band);
+
+	size_t row_bytes = m_row_bytes, bpp = m_channels;
+	PngSettings settings = m_settings;
+	auto task = [band, row_bytes, bpp, settings]{
+		encode_band(*band, row_bytes, bpp, settings);
+	};
+	if(m_jobs)
+		band->job = m_jobs->spawn(task);
+	else
+		task();
+}
+
+bool PngWriter::drain(size_t max_in_flight) {
+	for(;;) {
+		if(m_in_flight.empty())
+			return m_ok;
+		std::shared_ptr<PngBand> band = m_in_flight.front();
+		if(m_jobs && !m_jobs->done(band->job)) {
+			if(m_in_flight.size() <= max_in_flight)
+				return m_ok;
+			m_jobs->wait(band->job);
+		}
+		m_in_flight.pop_front();
+		if(!m_ok)
+			continue;
+		if(!band->ok) {
+			fail("Could not compress " + m_path);
+			continue;
+		}
+
+		std::vector<std::pair<const uint8_t*, size_t>> pieces;
+		// zlib header: deflate with a 32K window, FLEVEL matching the level.
+		uint8_t zlib_header[2] = {0x78, 0x9C};
+		if(m_settings.level >= 0 && m_settings.level <= 1)
+			zlib_header[1] = 0x01;
+		else if(m_settings.level >= 2 && m_settings.level <= 5)
+			zlib_header[1] = 0x5E;
+		else if(m_settings.level >= 7)
+			zlib_header[1] = 0xDA;
+		if(!m_header_written) {
+			pieces.emplace_back(zlib_header, sizeof(zlib_header));
+			m_header_written = true;
+		}
+		pieces.emplace_back(band->deflated.data(), band->deflated.size());
+		m_adler = adler32_combine(m_adler, band->adler, band->filtered_size);
+		uint8_t adler[4];
+		if(band->last) {
+			put_u32(adler, m_adler);
+			pieces.emplace_back(adler, sizeof(adler));
+		}
+		write_chunk("IDAT", pieces);
+		if(band->last)
+			write_chunk("IEND", {});
+	}
+}
+
+bool PngWriter::open(const std::string &path, int width, int height, int channels, PngSettings settings, JobSystem *jobs) {
+	if(m_file)
+		close();
+	m_path = path;
+	m_ok = true;
+	m_error.clear();
+	if(width <= 0 || height <= 0 || channels < 1 || channels > 4)
+		return fail("Invalid PNG dimensions for " + path);
+
+	m_file = std::fopen(path.c_str(), "wb");
+	if(!m_file)
+		return fail("Could not open " + path);
+
+	m_jobs = jobs;
+	m_settings = settings;
+	m_width = width;
+	m_height = height;
+	m_channels = channels;
+	m_row_bytes = static_cast<size_t>(width)*channels;
+	m_band_rows = std::max<size_t>(1, std::min<size_t>(height, settings.band_bytes/m_row_bytes));
+	m_max_in_flight = jobs ? 2*jobs->threads() : 0;
+	m_rows = 0;
+	m_header_written = false;
+	m_adler = adler32(0, Z_NULL, 0);
+	m_previous.assign(m_row_bytes, 0);
+
+	static const uint8_t colour_types[4] = {0, 4, 2, 6};
+	uint8_t ihdr[13];
+	put_u32(ihdr, width);
+	put_u32(ihdr+4, height);
+	ihdr[8] = 8;
+	ihdr[9] = colour_types[channels-1];
+	ihdr[10] = 0; // deflate
+	ihdr[11] = 0; // adaptive filtering
+	ihdr[12] = 0; // no interlacing
+	if(std::fwrite(png_signature, 1, sizeof(png_signature), m_file) != sizeof(png_signature))
+		return fail("Could not write " + path);
+	return write_chunk("IHDR", {{ihdr, sizeof(ihdr)}});
+}
+
+bool PngWriter::write_rows(const uint8_t *rows, int count, size_t stride) {
+	if(!m_file || !m_ok)
+		return false;
+	if(count > m_height - m_rows)
+		return fail("Too many rows for " + m_path);
+
+	for(int row=0;row<count;++row) {
+		if(!m_band) {
+			m_band = std::make_shared<PngBand>();
+			m_band->raw.reserve((m_band_rows+1)*m_row_bytes);
+			m_band->raw.assign(m_previous.begin(), m_previous.end());
+			m_band->rows = 0;
+		}
+		const uint8_t *src = rows + row*stride;
+		m_band->raw.insert(m_band->raw.end(), src, src+m_row_bytes);
+		++m_band->rows;
+		++m_rows;
+		if(m_band->rows == m_band_rows || m_rows == m_height) {
+			submit();
+			drain(m_max_in_flight);
+		}
+	}
+	return m_ok;
+}
+
+bool PngWriter::close() {
+	if(!m_file)
+		return false;
+	if(m_rows != m_height)
+		fail("Only " + std::to_string(m_rows) + " of " + std::to_string(m_height) + " rows written to " + m_path);
+	// Waits for every band still in flight, failed or not.
+	drain(0);
+	m_band.reset();
+	if(std::fclose(m_file) != 0)
+		fail("Could not write " + m_path);
+	m_file = nullptr;
+	if(!m_ok)
+		std::remove(m_path.c_str());
+	return m_ok;
+}
+
+const std::string &PngWriter::error() {
+	return m_error;
+}
+
+PngWriter::PngWriter():
+	m_file{nullptr},
+	m_jobs{nullptr},
+	m_width{0},
+	m_height{0},
+	m_channels{0},
+	m_row_bytes{0},
+	m_band_rows{0},
+	m_max_in_flight{0},
+	m_rows{0},
+	m_header_written{false},
+	m_adler{0},
+	m_ok{false}
+{;}
+
+PngWriter::~PngWriter() {
+	if(m_file)
+		close();
+}
+
+bool write_png(const std::string &path, int width, int height, int channels, const uint8_t *pixels, PngSettings settings, JobSystem *jobs)
+{
+	PngWriter writer;
+	return writer.open(path, width, height, channels, settings, jobs)
+	    && writer.write_rows(pixels, height, static_cast<size_t>(width)*channels)
+	    && writer.close();
+}
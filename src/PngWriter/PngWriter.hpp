@@ -0,0 +1,86 @@
+#ifndef PNGWRITER_HEADER
+#define PNGWRITER_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <Jobs/JobSystem.hpp>
+
+enum class PngFilter {
+	none,     // no filtering, for capture runs where speed matters most
+	sub,
+	up,
+	paeth,
+	adaptive, // per row, the filter with the smallest sum of absolute values
+};
+
+struct PngSettings {
+	PngFilter filter = PngFilter::adaptive;
+	// zlib level, 1 is a good match for PngFilter::none.
+	int level = 6;
+	// Uncompressed bytes per band, rounded to whole rows. Smaller bands
+	// parallelise better but compress slightly worse.
+	size_t band_bytes = 1 << 20;
+};
+
+struct PngBand;
+
+// Streaming PNG encoder that filters and deflates bands of rows in parallel.
+//
+// Rows are collected into bands; each band is filtered and deflated on its
+// own on the job system (or inline without one) and ends on a sync flush, so the
+// bands concatenate into a single standard zlib stream whose adler32 is
+// combined from the per-band checksums. Finished bands are written in order
+// as IDAT chunks by the thread calling write_rows(), which blocks while too
+// many bands are in flight, so memory stays bounded however tall the image.
+class PngWriter
+{
+private:
+	std::string m_path;
+	std::FILE *m_file;
+	JobSystem *m_jobs;
+	PngSettings m_settings;
+	int m_width;
+	int m_height;
+	int m_channels;
+	size_t m_row_bytes;
+	int m_band_rows;
+	size_t m_max_in_flight;
+	int m_rows;
+	bool m_header_written;
+	uint32_t m_adler;
+	bool m_ok;
+	std::string m_error;
+
+	std::shared_ptr<PngBand> m_band;
+	std::vector<uint8_t> m_previous;
+	std::deque<std::shared_ptr<PngBand>> m_in_flight;
+
+	void submit();
+	bool drain(size_t max_in_flight);
+	bool write_chunk(const char *type, const std::vector<std::pair<const uint8_t*, size_t>> &pieces);
+	bool fail(std::string error);
+public:
+	// channels: 1 grey, 2 grey+alpha, 3 RGB, 4 RGBA, 8 bits each.
+	bool open(const std::string &path, int width, int height, int channels, PngSettings settings = {}, JobSystem *jobs = nullptr);
+	// Appends count rows top to bottom, stride bytes apart.
+	bool write_rows(const uint8_t *rows, int count, size_t stride);
+	// Writes the remaining bands; fails unless every row was written.
+	bool close();
+	const std::string &error();
+
+	PngWriter();
+	PngWriter(const PngWriter&) = delete;
+	PngWriter &operator=(const PngWriter&) = delete;
+	~PngWriter();
+};
+
+// Encodes a whole top-down image in one go.
+bool write_png(const std::string &path, int width, int height, int channels, const uint8_t *pixels, PngSettings settings = {}, JobSystem *jobs = nullptr);
+
+#endif
@@ -0,0 +1,129 @@
+#include <GL/glew.h>
+#include <Poster/Poster.hpp>
+#include <PngWriter/PngWriter.hpp>
+#include <Camera/Camera.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+bool parse_poster_size(const std::string &str, int &width, int &height)
+{
+	char x;
+	char rest;
+	return std::sscanf(str.c_str(), "%d%c%d%c", &width, &x, &height, &rest) == 3
+	    && (x == 'x' || x == 'X') && width > 0 && height > 0;
+}
+
+int Poster::width() {
+	return m_width;
+}
+
+int Poster::height() {
+	return m_height;
+}
+
+int Poster::apron() {
+	return m_apron;
+}
+
+glm::mat4 Poster::projection() {
+	return glm::perspective(m_fov, static_cast<float>(m_width)/m_height, m_near, m_far);
+}
+
+std::vector<Poster::Tile> Poster::tiles() {
+	// The whole image's frustum on the near plane; tiles cut windows out of
+	// it, aprons may reach past its edges.
+	float top = m_near*std::tan(m_fov/2.f);
+	float right = top*m_width/m_height;
+	auto frustum_x = [&](int x){return right*(2.f*x/m_width - 1.f);};
+	auto frustum_y = [&](int y){return top*(1.f - 2.f*y/m_height);};
+
+	std::vector<Tile> tiles;
+	for(int y=0;y<m_height;y+=m_tile_height) {
+		for(int x=0;x<m_width;x+=m_tile_width) {
+			Tile tile;
+			tile.x = x;
+			tile.y = y;
+			tile.width = std::min(m_tile_width, m_width-x);
+			tile.height = std::min(m_tile_height, m_height-y);
+			tile.viewport = glm::ivec2(tile.width + 2*m_apron, tile.height + 2*m_apron);
+
+			int left = x - m_apron, right = x + tile.width + m_apron;
+			int top = y - m_apron, bottom = y + tile.height + m_apron;
+			tile.projection = reverse_z_frustum(
+				frustum_x(left), frustum_x(right),
+				frustum_y(bottom), frustum_y(top),
+				m_near, m_far
+			);
+			tile.image_rect = glm::vec4(
+				static_cast<float>(left)/m_width, 1.f - static_cast<float>(bottom)/m_height,
+				static_cast<float>(tile.viewport.x)/m_width, static_cast<float>(tile.viewport.y)/m_height
+			);
+			tiles.push_back(tile);
+		}
+	}
+	return tiles;
+}
+
+bool Poster::render(const std::string &path, GLuint texture, const DrawFunction &draw, JobSystem *jobs, std::string &error) {
+	PngWriter writer;
+	if(!writer.open(path, m_width, m_height, 3, PngSettings(), jobs)) {
+		error = writer.error();
+		return false;
+	}
+
+	GLint pack_alignment, pack_row_length;
+	glGetIntegerv(GL_PACK_ALIGNMENT, &pack_alignment);
+	glGetIntegerv(GL_PACK_ROW_LENGTH, &pack_row_length);
+	// Tiles are read straight into their place in the band.
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glPixelStorei(GL_PACK_ROW_LENGTH, m_width);
+
+	size_t row_bytes = static_cast<size_t>(m_width)*3;
+	std::vector<uint8_t> band;
+	for(auto &tile : tiles()) {
+		if(tile.x == 0)
+			band.resize(row_bytes*tile.height);
+
+		draw(tile);
+		size_t offset = static_cast<size_t>(tile.x)*3;
+		glGetTextureSubImage(
+			texture, 0, m_apron, m_apron, 0, tile.width, tile.height, 1,
+			GL_RGB, GL_UNSIGNED_BYTE, band.size()-offset, band.data()+offset
+		);
+
+		if(tile.x + tile.width == m_width) {
+			// The band was read bottom-up.
+			for(int row=tile.height-1;row>=0;--row)
+				if(!writer.write_rows(&band[row*row_bytes], 1, row_bytes))
+					break;
+		}
+	}
+
+	glPixelStorei(GL_PACK_ALIGNMENT, pack_alignment);
+	glPixelStorei(GL_PACK_ROW_LENGTH, pack_row_length);
+
+	if(!writer.close()) {
+		error = writer.error();
+		return false;
+	}
+	return true;
+}
+
+Poster::Poster(
+	int width, int height, glm::ivec2 buffer_size, int apron,
+	size_t band_bytes, float fov, float z_near, float z_far
+):
+	m_width{std::max(1, width)},
+	m_height{std::max(1, height)},
+	m_fov{fov},
+	m_near{z_near},
+	m_far{z_far}
+{
+	// Leave at least one pixel of every tile to the tile itself.
+	m_apron = std::max(0, std::min(apron, (std::min(buffer_size.x, buffer_size.y)-1)/2));
+	m_tile_width = buffer_size.x - 2*m_apron;
+	size_t band_rows = band_bytes/(static_cast<size_t>(m_width)*3);
+	m_tile_height = std::max(1, static_cast<int>(std::min<size_t>(buffer_size.y - 2*m_apron, band_rows)));
+}
@@ -0,0 +1,74 @@
+#ifndef POSTER_HEADER
+#define POSTER_HEADER
+
+#include <GL/gl.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include <Jobs/JobSystem.hpp>
+
+// Renders images larger than the G-buffer as a grid of tiles.
+//
+// Each tile gets an off-axis projection, a window into the frustum of the
+// whole image, so neighbouring tiles line up pixel-exactly. Tiles are
+// rendered with an apron of extra pixels on every side that is thrown away
+// again: screen-space effects that sample neighbouring pixels (SSAO) see the
+// real scene across tile borders instead of a clamped edge, provided they
+// stay within the apron. The image is streamed to a PngWriter one row of
+// tiles at a time, so memory use is a single band of image_width times
+// tile height pixels, however large the image.
+class Poster
+{
+public:
+	struct Tile {
+		// The tile's own pixels, in top-down image coordinates.
+		int x;
+		int y;
+		int width;
+		int height;
+		// Tile plus apron on every side, rendered from the buffer origin.
+		glm::ivec2 viewport;
+		// Reverse-Z projection covering viewport.
+		glm::mat4 projection;
+		// Viewport as offset and size in bottom-up texcoords of the image.
+		glm::vec4 image_rect;
+	};
+	using DrawFunction = std::function<void(const Tile&)>;
+private:
+	int m_width;
+	int m_height;
+	int m_apron;
+	int m_tile_width;
+	int m_tile_height;
+	float m_fov;
+	float m_near;
+	float m_far;
+public:
+	int width();
+	int height();
+	int apron();
+	// Conventional projection of the whole image, the frame projection of
+	// CameraBlock.
+	glm::mat4 projection();
+	std::vector<Tile> tiles();
+
+	// Has draw render every tile into texture, whose pixels from (apron,
+	// apron) on are then read back, and writes the result as an RGB PNG with
+	// the compression spread across jobs. GL thread; blocks until the file
+	// is written.
+	bool render(const std::string &path, GLuint texture, const DrawFunction &draw, JobSystem *jobs, std::string &error);
+
+	// buffer_size is the size of the G-buffer textures; band_bytes bounds
+	// the memory used for one row of tiles.
+	Poster(
+		int width, int height, glm::ivec2 buffer_size, int apron,
+		size_t band_bytes, float fov, float z_near, float z_far
+	);
+};
+
+// Parses sizes like 32768x16384.
+bool parse_poster_size(const std::string &str, int &width, int &height);
+
+#endif
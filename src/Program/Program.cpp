@@ -13,6 +13,31 @@ void Program::link() {
 	glLinkProgram(m_program);
 }
 
+bool Program::completion_status() {
+	if(!GLEW_KHR_parallel_shader_compile && !GLEW_ARB_parallel_shader_compile)
+		return true;
+	GLint done;
+	glGetProgramiv(m_program, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+
+bool Program::link_status() {
+	GLint status;
+	glGetProgramiv(m_program, GL_LINK_STATUS, &status);
+	return status == GL_TRUE;
+}
+
+std::string Program::info_log() {
+	GLint length = 0;
+	glGetProgramiv(m_program, GL_INFO_LOG_LENGTH, &length);
+	if(length <= 0)
+		return {};
+	std::string log(length, '\0');
+	glGetProgramInfoLog(m_program, length, NULL, &log[0]);
+	log.resize(length-1);
+	return log;
+}
+
 void Program::use() {
 	glUseProgram(m_program);
 }
@@ -25,6 +50,27 @@ void Program::transform_feedback_varyings(std::vector<std::string> varyings, GLe
 	glTransformFeedbackVaryings(m_program, varyings.size(), v.data(), attrib_mode);
 }
 
+void Program::binary_retrievable(bool retrievable) {
+	glProgramParameteri(m_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, retrievable ? GL_TRUE : GL_FALSE);
+}
+
+bool Program::get_binary(GLenum &format, std::vector<char> &binary) {
+	GLint length = 0;
+	glGetProgramiv(m_program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0)
+		return false;
+	binary.resize(length);
+	GLsizei written = 0;
+	glGetProgramBinary(m_program, length, &written, &format, binary.data());
+	binary.resize(written);
+	return written > 0;
+}
+
+bool Program::load_binary(GLenum format, const std::vector<char> &binary) {
+	glProgramBinary(m_program, format, binary.data(), binary.size());
+	return link_status();
+}
+
 void Program::recycle() {
 	glDeleteProgram(m_program);
 	m_program = glCreateProgram();
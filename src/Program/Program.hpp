@@ -14,12 +14,19 @@ public:
 	operator GLuint();
 	void attach(Shader &shader);
 	void link();
+	// Non-blocking: false while a parallel link is still running.
+	bool completion_status();
+	bool link_status();
+	std::string info_log();
 	void use();
 	void transform_feedback_varyings(std::vector<std::string> varyings, GLenum attrib_mode = GL_INTERLEAVED_ATTRIBS);
+	void binary_retrievable(bool retrievable);
+	bool get_binary(GLenum &format, std::vector<char> &binary);
+	bool load_binary(GLenum format, const std::vector<char> &binary);
 	void recycle();
 
 	Program();
 	~Program();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,181 @@
+#include <GL/glew.h>
+#include <ProgramCache/ProgramCache.hpp>
+#include <Util/hash.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+namespace {
+
+const char cache_magic[4] = {'I', 'T', 'P', 'B'};
+const uint32_t cache_version = 1;
+
+struct CacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t format;
+	uint32_t size;
+	int64_t compile_us;
+};
+
+bool make_directory(const std::string &dir)
+{
+#ifdef _WIN32
+	int ret = _mkdir(dir.c_str());
+#else
+	int ret = mkdir(dir.c_str(), 0755);
+#endif
+	return ret == 0 || errno == EEXIST;
+}
+
+bool make_directories(const std::string &dir)
+{
+	for(std::string::size_type pos = 1; pos < dir.size(); ++pos) {
+		if(dir[pos] == '/' || dir[pos] == '\\') {
+			if(!make_directory(dir.substr(0, pos)))
+				return false;
+		}
+	}
+	return make_directory(dir);
+}
+
+std::string gl_string(GLenum name)
+{
+	const GLubyte *str = glGetString(name);
+	return str ? reinterpret_cast<const char*>(str) : "";
+}
+
+}
+
+std::string default_cache_directory()
+{
+#ifdef _WIN32
+	if(const char *local = std::getenv("LOCALAPPDATA"))
+		return std::string(local) + "\\infiniterrain";
+	return ".\\cache";
+#else
+	if(const char *xdg = std::getenv("XDG_CACHE_HOME"))
+		if(*xdg)
+			return std::string(xdg) + "/infiniterrain";
+	if(const char *home = std::getenv("HOME"))
+		return std::string(home) + "/.cache/infiniterrain";
+	return "/tmp/infiniterrain";
+#endif
+}
+
+std::string ProgramCache::path(uint64_t key) {
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+	return m_directory + "/" + name;
+}
+
+bool ProgramCache::enabled() {
+	return m_enabled;
+}
+
+const std::string &ProgramCache::directory() {
+	return m_directory;
+}
+
+uint64_t ProgramCache::key(const std::vector<ShaderSource> &sources, const std::vector<std::string> &defines) {
+	fnv1a hash;
+	hash.update(&cache_version, sizeof(cache_version));
+	hash.update(m_driver);
+	hash.update(m_formats.data(), m_formats.size()*sizeof(GLint));
+	for(auto &define : defines)
+		hash.update(define);
+	for(auto &source : sources)
+		source.hash(hash);
+	return hash.digest();
+}
+
+bool ProgramCache::load(Program &program, uint64_t key, long long &compile_us) {
+	if(!m_enabled)
+		return false;
+
+	std::ifstream f(path(key), std::ios::binary);
+	if(!f.good())
+		return false;
+
+	CacheHeader header;
+	f.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if(!f.good()
+	|| std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0
+	|| header.version != cache_version
+	|| header.key != key
+	|| std::find(m_formats.begin(), m_formats.end(), static_cast<GLint>(header.format)) == m_formats.end()) {
+		return false;
+	}
+
+	std::vector<char> binary(header.size);
+	f.read(binary.data(), binary.size());
+	if(static_cast<uint32_t>(f.gcount()) != header.size)
+		return false;
+
+	if(!program.load_binary(header.format, binary)) {
+		// The driver rejected the binary (e.g. a silent driver update that
+		// kept the version string). Drop the entry and start from scratch.
+		std::remove(path(key).c_str());
+		program.recycle();
+		return false;
+	}
+	compile_us = header.compile_us;
+	return true;
+}
+
+bool ProgramCache::store(Program &program, uint64_t key, long long compile_us) {
+	if(!m_enabled)
+		return false;
+
+	GLenum format;
+	std::vector<char> binary;
+	if(!program.get_binary(format, binary))
+		return false;
+
+	CacheHeader header;
+	std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+	header.version = cache_version;
+	header.key = key;
+	header.format = format;
+	header.size = binary.size();
+	header.compile_us = compile_us;
+
+	// Write to a temporary and rename so a crash never leaves a torn entry.
+	std::string final_path = path(key);
+	std::string tmp_path = final_path + ".tmp";
+	{
+		std::ofstream f(tmp_path, std::ios::binary | std::ios::trunc);
+		if(!f.good())
+			return false;
+		f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		f.write(binary.data(), binary.size());
+		if(!f.good())
+			return false;
+	}
+	std::remove(final_path.c_str());
+	return std::rename(tmp_path.c_str(), final_path.c_str()) == 0;
+}
+
+ProgramCache::ProgramCache(std::string directory):
+	m_directory{std::move(directory)},
+	m_enabled{false}
+{
+	m_driver = gl_string(GL_VENDOR) + "\n" + gl_string(GL_RENDERER) + "\n" + gl_string(GL_VERSION);
+
+	GLint format_count = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+	if(format_count > 0) {
+		m_formats.resize(format_count);
+		glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, m_formats.data());
+	}
+
+	m_enabled = !m_formats.empty() && make_directories(m_directory);
+}
@@ -0,0 +1,46 @@
+#ifndef PROGRAM_CACHE_HEADER
+#define PROGRAM_CACHE_HEADER
+
+#include <GL/gl.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <Program/Program.hpp>
+#include <ShaderSource/ShaderSource.hpp>
+
+// On-disk cache of linked program binaries (glGetProgramBinary).
+// Entries are keyed by the program sources and defines together with the
+// driver's vendor/renderer/version strings and its binary formats, so a
+// driver update or any shader edit simply misses. Every failure path
+// (missing file, stale key, driver rejecting the binary) reports a miss and
+// leaves the caller to compile from source.
+class ProgramCache
+{
+private:
+	std::string m_directory;
+	std::string m_driver;
+	std::vector<GLint> m_formats;
+	bool m_enabled;
+
+	std::string path(uint64_t key);
+public:
+	bool enabled();
+	const std::string &directory();
+
+	uint64_t key(const std::vector<ShaderSource> &sources, const std::vector<std::string> &defines);
+	// On a hit, program is linked and compile_us holds the time the original
+	// compile took. A miss leaves program untouched, unless the driver
+	// rejected the cached binary: then program is recycled into a fresh
+	// object. Either way it is ready for attaching.
+	bool load(Program &program, uint64_t key, long long &compile_us);
+	bool store(Program &program, uint64_t key, long long compile_us);
+
+	// Requires a current GL context.
+	ProgramCache(std::string directory);
+};
+
+// Per-user cache directory: $XDG_CACHE_HOME/infiniterrain, ~/.cache/infiniterrain
+// or %LOCALAPPDATA%\infiniterrain.
+std::string default_cache_directory();
+
+#endif
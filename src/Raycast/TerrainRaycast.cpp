@@ -0,0 +1,320 @@
+#include <Raycast/TerrainRaycast.hpp>
+#include <Jobs/JobSystem.hpp>
+#include <Terrain/Terrain.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+struct RaycastRegion {
+	std::once_flag built;
+	float origin_x;
+	float origin_y;
+	// (cells+1)^2 samples, rows of increasing y.
+	std::vector<float> heights;
+	// Min and max over the nodes of each quadtree level from 1 on, nodes
+	// of level n being 2^n cells wide; the last level is the whole region.
+	// The cells themselves are bounded by their corners.
+	std::vector<std::vector<std::pair<float, float>>> levels;
+};
+
+namespace {
+
+const float infinity = std::numeric_limits<float>::infinity();
+
+// Ray parameter at which the ray crosses the plane coordinate == value,
+// infinity if it runs parallel to it.
+float crossing(float value, float origin, float direction)
+{
+	return direction != 0.f ? (value - origin)/direction : infinity;
+}
+
+struct Traversal {
+	const RaycastRegion &region;
+	unsigned cells;
+	float spacing;
+	float origin[3];
+	float direction[3];
+	unsigned long long nodes;
+	unsigned long long tested;
+	TerrainHit hit;
+};
+
+// Moller-Trumbore, restricted to t in [t0, t1].
+bool intersect_triangle(Traversal &traversal, const float a[3], const float b[3], const float c[3], float t0, float t1)
+{
+	const float *o = traversal.origin, *d = traversal.direction;
+	float e1[3] = {b[0]-a[0], b[1]-a[1], b[2]-a[2]};
+	float e2[3] = {c[0]-a[0], c[1]-a[1], c[2]-a[2]};
+	float p[3] = {d[1]*e2[2] - d[2]*e2[1], d[2]*e2[0] - d[0]*e2[2], d[0]*e2[1] - d[1]*e2[0]};
+	float determinant = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+	if(std::abs(determinant) < 1e-12f)
+		return false;
+	float inverse = 1.f/determinant;
+	float s[3] = {o[0]-a[0], o[1]-a[1], o[2]-a[2]};
+	float u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2])*inverse;
+	if(u < -1e-5f || u > 1.f+1e-5f)
+		return false;
+	float q[3] = {s[1]*e1[2] - s[2]*e1[1], s[2]*e1[0] - s[0]*e1[2], s[0]*e1[1] - s[1]*e1[0]};
+	float v = (d[0]*q[0] + d[1]*q[1] + d[2]*q[2])*inverse;
+	if(v < -1e-5f || u + v > 1.f+1e-5f)
+		return false;
+	float t = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2])*inverse;
+	if(t < t0 || t > t1)
+		return false;
+
+	// Upward facing, whichever side was hit.
+	float n[3] = {e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2], e1[0]*e2[1] - e1[1]*e2[0]};
+	float length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+	if(n[2] < 0.f)
+		length = -length;
+	TerrainHit &hit = traversal.hit;
+	hit.hit = true;
+	hit.distance = t;
+	for(int i=0;i<3;++i) {
+		hit.position[i] = o[i] + d[i]*t;
+		hit.normal[i] = n[i]/length;
+	}
+	return true;
+}
+
+// The two triangles of a cell, split like the map mesh: (x, y), (x+1, y),
+// (x, y+1) and (x, y+1), (x+1, y), (x+1, y+1).
+bool intersect_cell(Traversal &traversal, unsigned x, unsigned y, float t0, float t1, float lowest)
+{
+	const RaycastRegion &region = traversal.region;
+	size_t stride = traversal.cells+1;
+	float s = traversal.spacing;
+	float x0 = region.origin_x + x*s, y0 = region.origin_y + y*s;
+	float p00[3] = {x0,   y0,   region.heights[y*stride + x]};
+	float p10[3] = {x0+s, y0,   region.heights[y*stride + x+1]};
+	float p01[3] = {x0,   y0+s, region.heights[(y+1)*stride + x]};
+	float p11[3] = {x0+s, y0+s, region.heights[(y+1)*stride + x+1]};
+	if(lowest > std::max({p00[2], p10[2], p01[2], p11[2]}))
+		return false;
+	++traversal.tested;
+	// Slack for rays grazing a cell border.
+	float slack = 1e-4f*(1.f + t1);
+	t0 = std::max(0.f, t0 - slack);
+	t1 += slack;
+	// Either triangle may be the nearer one.
+	bool hit = intersect_triangle(traversal, p00, p10, p01, t0, t1);
+	if(hit)
+		t1 = traversal.hit.distance;
+	return intersect_triangle(traversal, p01, p10, p11, t0, t1) || hit;
+}
+
+// Walks the quadtree node front to back over the part [t0, t1] of the ray
+// that lies above it.
+bool intersect_node(Traversal &traversal, unsigned level, unsigned x, unsigned y, float t0, float t1)
+{
+	++traversal.nodes;
+	float z0 = traversal.origin[2] + traversal.direction[2]*t0;
+	float z1 = traversal.origin[2] + traversal.direction[2]*t1;
+	if(level == 0)
+		return intersect_cell(traversal, x, y, t0, t1, std::min(z0, z1));
+	const auto &bounds = traversal.region.levels[level-1][y*(traversal.cells >> level) + x];
+	if(std::min(z0, z1) > bounds.second)
+		return false;
+
+	// The ray crosses the node's middle lines at most once each, splitting
+	// it into up to three pieces in order along the ray.
+	float size = traversal.spacing*(1u << level);
+	float middle_x = traversal.region.origin_x + (x + 0.5f)*size;
+	float middle_y = traversal.region.origin_y + (y + 0.5f)*size;
+	float cross_x = std::clamp(crossing(middle_x, traversal.origin[0], traversal.direction[0]), t0, t1);
+	float cross_y = std::clamp(crossing(middle_y, traversal.origin[1], traversal.direction[1]), t0, t1);
+	float pieces[4] = {t0, std::min(cross_x, cross_y), std::max(cross_x, cross_y), t1};
+	for(int i=0;i<3;++i) {
+		float a = pieces[i], b = pieces[i+1];
+		if(b <= a)
+			continue;
+		// Which child the piece lies in, from its middle.
+		float t = 0.5f*(a + b);
+		unsigned cx = traversal.origin[0] + traversal.direction[0]*t >= middle_x;
+		unsigned cy = traversal.origin[1] + traversal.direction[1]*t >= middle_y;
+		if(intersect_node(traversal, level-1, 2*x + cx, 2*y + cy, a, b))
+			return true;
+	}
+	return false;
+}
+
+uint64_t region_key(int x, int y)
+{
+	return static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32 | static_cast<uint32_t>(y);
+}
+
+}
+
+void TerrainRaycast::build(RaycastRegion &region, int x, int y) {
+	unsigned cells = m_settings.region_cells;
+	size_t stride = cells+1;
+	region.origin_x = x*m_region_size;
+	region.origin_y = y*m_region_size;
+
+	region.heights.resize(stride*stride);
+	std::vector<float> xs(stride), ys(stride);
+	for(size_t i=0;i<stride;++i)
+		xs[i] = region.origin_x + i*m_settings.spacing;
+	for(size_t row=0;row<stride;++row) {
+		std::fill(ys.begin(), ys.end(), region.origin_y + row*m_settings.spacing);
+		terrain_heights(xs.data(), ys.data(), &region.heights[row*stride], stride);
+	}
+	if(m_settings.water) {
+		for(auto &height : region.heights)
+			height = std::max(height, terrain_water_level);
+	}
+
+	// Level 1 straight from the 3x3 samples of each node, the levels
+	// above from the one below.
+	region.levels.clear();
+	for(unsigned size=cells/2;size>=1;size/=2) {
+		std::vector<std::pair<float, float>> level(static_cast<size_t>(size)*size, {infinity, -infinity});
+		for(unsigned ny=0;ny<size;++ny) {
+			for(unsigned nx=0;nx<size;++nx) {
+				std::pair<float, float> &bounds = level[ny*size + nx];
+				if(region.levels.empty()) {
+					for(unsigned y=2*ny;y<=2*ny+2;++y) {
+						for(unsigned x=2*nx;x<=2*nx+2;++x) {
+							bounds.first = std::min(bounds.first, region.heights[y*stride + x]);
+							bounds.second = std::max(bounds.second, region.heights[y*stride + x]);
+						}
+					}
+					continue;
+				}
+				const auto &below = region.levels.back();
+				for(unsigned y=2*ny;y<=2*ny+1;++y) {
+					for(unsigned x=2*nx;x<=2*nx+1;++x) {
+						bounds.first = std::min(bounds.first, below[y*(2*size) + x].first);
+						bounds.second = std::max(bounds.second, below[y*(2*size) + x].second);
+					}
+				}
+			}
+		}
+		region.levels.push_back(std::move(level));
+	}
+}
+
+std::shared_ptr<RaycastRegion> TerrainRaycast::region(int x, int y) {
+	uint64_t key = region_key(x, y);
+	std::shared_ptr<RaycastRegion> region;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto resident = m_regions.find(key);
+		if(resident != m_regions.end()) {
+			m_lru.splice(m_lru.begin(), m_lru, resident->second.second);
+			region = resident->second.first;
+		}
+		else {
+			if(m_regions.size() >= m_settings.max_regions) {
+				m_regions.erase(m_lru.back());
+				m_lru.pop_back();
+			}
+			region = std::make_shared<RaycastRegion>();
+			m_lru.push_front(key);
+			m_regions.emplace(key, Resident(region, m_lru.begin()));
+			++m_regions_built;
+		}
+	}
+	// Outside the lock; other rays wanting the same region wait here.
+	std::call_once(region->built, [&]{build(*region, x, y);});
+	return region;
+}
+
+TerrainHit TerrainRaycast::cast(const TerrainRay &ray) {
+	TerrainHit miss{};
+	float length = std::sqrt(ray.direction[0]*ray.direction[0] + ray.direction[1]*ray.direction[1] + ray.direction[2]*ray.direction[2]);
+	if(!(length > 0.f) || !(ray.max_distance > 0.f) || !std::isfinite(ray.max_distance))
+		return miss;
+
+	float direction[3] = {ray.direction[0]/length, ray.direction[1]/length, ray.direction[2]/length};
+	int rx = static_cast<int>(std::floor(ray.origin[0]/m_region_size));
+	int ry = static_cast<int>(std::floor(ray.origin[1]/m_region_size));
+	int step_x = direction[0] > 0.f ? 1 : -1, step_y = direction[1] > 0.f ? 1 : -1;
+	unsigned long long nodes = 0, tested = 0;
+	TerrainHit result = miss;
+
+	// Region by region along the ray, as in a grid DDA.
+	for(float t=0.f;t<ray.max_distance;) {
+		float exit_x = crossing((rx + (step_x > 0))*m_region_size, ray.origin[0], direction[0]);
+		float exit_y = crossing((ry + (step_y > 0))*m_region_size, ray.origin[1], direction[1]);
+		float exit = std::min({exit_x, exit_y, ray.max_distance});
+
+		// Regions the ray passes high above are not even built, and a
+		// rising ray above all terrain will not come down again.
+		float z = ray.origin[2] + direction[2]*t;
+		if(direction[2] >= 0.f && z > terrain_max_height)
+			break;
+		if(std::min(z, ray.origin[2] + direction[2]*exit) <= terrain_max_height) {
+			std::shared_ptr<RaycastRegion> region = this->region(rx, ry);
+			Traversal traversal{
+				*region, m_settings.region_cells, m_settings.spacing,
+				{ray.origin[0], ray.origin[1], ray.origin[2]}, {direction[0], direction[1], direction[2]},
+				0, 0, miss
+			};
+			bool hit = intersect_node(traversal, region->levels.size(), 0, 0, t, exit);
+			nodes += traversal.nodes;
+			tested += traversal.tested;
+			if(hit) {
+				result = traversal.hit;
+				break;
+			}
+		}
+
+		t = std::max(t, exit);
+		if(exit_x < exit_y)
+			rx += step_x;
+		else
+			ry += step_y;
+	}
+	m_nodes_visited += nodes;
+	m_cells_tested += tested;
+	return result;
+}
+
+void TerrainRaycast::cast(const TerrainRay *rays, TerrainHit *hits, size_t count, JobSystem *jobs) {
+	auto run = [&](size_t first, size_t last) {
+		for(size_t i=first;i<last;++i)
+			hits[i] = cast(rays[i]);
+	};
+	if(jobs)
+		jobs->parallel_for(0, count, 64, run);
+	else
+		run(0, count);
+}
+
+bool TerrainRaycast::line_of_sight(const float from[3], const float to[3]) {
+	TerrainRay ray = {
+		{from[0], from[1], from[2]},
+		{to[0]-from[0], to[1]-from[1], to[2]-from[2]},
+		0.f
+	};
+	ray.max_distance = std::sqrt(ray.direction[0]*ray.direction[0] + ray.direction[1]*ray.direction[1] + ray.direction[2]*ray.direction[2]);
+	return ray.max_distance == 0.f || !cast(ray).hit;
+}
+
+TerrainRaycast::Stats TerrainRaycast::stats() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return {m_regions_built, m_nodes_visited.load(), m_cells_tested.load(), m_regions.size()};
+}
+
+TerrainRaycast::TerrainRaycast():
+	TerrainRaycast(Settings())
+{;}
+
+TerrainRaycast::TerrainRaycast(const Settings &settings):
+	m_settings(settings),
+	m_regions_built{0},
+	m_nodes_visited{0},
+	m_cells_tested{0}
+{
+	m_settings.spacing = m_settings.spacing > 0.f ? m_settings.spacing : 1.f;
+	// Rounded down to a power of two.
+	unsigned cells = 2;
+	while(cells*2 <= m_settings.region_cells && cells < (1u << 14))
+		cells *= 2;
+	m_settings.region_cells = cells;
+	m_settings.max_regions = std::max<size_t>(m_settings.max_regions, 1);
+	m_region_size = cells*m_settings.spacing;
+}
+
+TerrainRaycast::~TerrainRaycast() {;}
@@ -0,0 +1,98 @@
+#ifndef TERRAIN_RAYCAST_HEADER
+#define TERRAIN_RAYCAST_HEADER
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class JobSystem;
+struct RaycastRegion;
+
+// In terrain coordinates (see Terrain.hpp), z up.
+struct TerrainRay {
+	float origin[3];
+	// Need not be unit length; distances are along the normalised direction.
+	float direction[3];
+	// Finite.
+	float max_distance;
+};
+
+struct TerrainHit {
+	bool hit;
+	float distance;
+	float position[3];
+	// Of the triangle that was hit.
+	float normal[3];
+};
+
+// Casts rays against the terrain as the renderer triangulates it: heights
+// sampled on a grid, every cell split into two triangles along the same
+// diagonal as the map mesh.
+//
+// The terrain is cut into square regions that are sampled when a ray first
+// reaches them, together with a quadtree of min/max heights over the
+// region's cells. Rays descend into a node only where their height range
+// over it reaches below the node's maximum, so long rays over open ground
+// or high above it touch a handful of nodes instead of every cell. The most
+// recently used max_regions stay built. Thread-safe.
+class TerrainRaycast
+{
+public:
+	struct Settings {
+		// Distance between height samples.
+		float spacing = 2.f;
+		// Cells per region side, a power of two of at least 2.
+		unsigned region_cells = 256;
+		// About 450 KB each at 256 cells.
+		size_t max_regions = 64;
+		// Hit the water surface instead of the ground below it.
+		bool water = false;
+	};
+	struct Stats {
+		unsigned long long regions_built;
+		unsigned long long nodes_visited;
+		unsigned long long cells_tested;
+		size_t resident;
+	};
+private:
+	using Resident = std::pair<std::shared_ptr<RaycastRegion>, std::list<uint64_t>::iterator>;
+
+	Settings m_settings;
+	float m_region_size;
+
+	std::mutex m_mutex;
+	std::unordered_map<uint64_t, Resident> m_regions;
+	// Most recently used first.
+	std::list<uint64_t> m_lru;
+	unsigned long long m_regions_built;
+	std::atomic<unsigned long long> m_nodes_visited;
+	std::atomic<unsigned long long> m_cells_tested;
+
+	std::shared_ptr<RaycastRegion> region(int x, int y);
+	void build(RaycastRegion &region, int x, int y);
+public:
+	// Nearest hit within the ray's max_distance.
+	TerrainHit cast(const TerrainRay &ray);
+	// Casts count rays, split across jobs when given.
+	void cast(const TerrainRay *rays, TerrainHit *hits, size_t count, JobSystem *jobs = nullptr);
+	// Whether the segment between two points is clear of the terrain.
+	// Points on the ground itself should be lifted a little, or the ground
+	// they stand on blocks the view.
+	bool line_of_sight(const float from[3], const float to[3]);
+
+	Stats stats();
+
+	TerrainRaycast();
+	explicit TerrainRaycast(const Settings &settings);
+	TerrainRaycast(const TerrainRaycast&) = delete;
+	TerrainRaycast &operator=(const TerrainRaycast&) = delete;
+	~TerrainRaycast();
+};
+
+#endif
@@ -0,0 +1,78 @@
+#include <GL/glew.h>
+#include <Readback/Readback.hpp>
+
+void Readback::allocate(size_t size) {
+	if(size <= m_capacity)
+		return;
+	GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	m_buffer = Buffer("readback", size, nullptr, flags | GL_CLIENT_STORAGE_BIT);
+	m_data = static_cast<const uint8_t*>(m_buffer.map(0, size, flags));
+	m_capacity = size;
+}
+
+bool Readback::idle() {
+	return !m_busy.load(std::memory_order_acquire);
+}
+
+void Readback::start(GLuint texture, int width, int height) {
+	m_width = width;
+	m_height = height;
+	allocate(size());
+	m_busy.store(true, std::memory_order_relaxed);
+	m_flushed = false;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTextureImage(texture, 0, GL_RGBA, GL_UNSIGNED_BYTE, size(), nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool Readback::ready() {
+	if(!m_fence)
+		return m_busy.load(std::memory_order_relaxed);
+	// Flush once so the fence is guaranteed to signal eventually, without
+	// ever waiting on it.
+	GLenum status = glClientWaitSync(m_fence, m_flushed ? 0 : GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	m_flushed = true;
+	if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		return false;
+	glDeleteSync(m_fence);
+	m_fence = nullptr;
+	return true;
+}
+
+const uint8_t *Readback::data() {
+	return m_data;
+}
+
+int Readback::width() {
+	return m_width;
+}
+
+int Readback::height() {
+	return m_height;
+}
+
+size_t Readback::size() {
+	return static_cast<size_t>(m_width)*m_height*4;
+}
+
+void Readback::release() {
+	m_busy.store(false, std::memory_order_release);
+}
+
+Readback::Readback():
+	m_fence{nullptr},
+	m_data{nullptr},
+	m_capacity{0},
+	m_width{0},
+	m_height{0},
+	m_busy{false},
+	m_flushed{false}
+{;}
+
+Readback::~Readback() {
+	if(m_fence)
+		glDeleteSync(m_fence);
+}
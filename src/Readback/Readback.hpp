@@ -0,0 +1,47 @@
+#ifndef READBACK_HEADER
+#define READBACK_HEADER
+
+#include <GL/gl.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <GpuResource/Buffer.hpp>
+
+// Asynchronous texture readback through a persistently mapped pixel-pack
+// buffer. start() only queues the copy and a fence; once ready() reports the
+// fence signalled, data() can be read from any thread without touching GL,
+// until release() hands the buffer back for the next start().
+class Readback
+{
+private:
+	Buffer m_buffer;
+	GLsync m_fence;
+	const uint8_t *m_data;
+	size_t m_capacity;
+	int m_width;
+	int m_height;
+	std::atomic<bool> m_busy;
+	bool m_flushed;
+
+	void allocate(size_t size);
+public:
+	// False while a readback is in flight or its data is still in use.
+	bool idle();
+	// Queues a copy of mip 0 of texture as RGBA8. Requires idle().
+	void start(GLuint texture, int width, int height);
+	// Non-blocking fence check; GL thread only.
+	bool ready();
+	const uint8_t *data();
+	int width();
+	int height();
+	size_t size();
+	// Marks the data as consumed. May be called from any thread.
+	void release();
+
+	Readback();
+	Readback(const Readback&) = delete;
+	Readback &operator=(const Readback&) = delete;
+	~Readback();
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include <GL/glew.h>
+#include <Screenshot/Screenshot.hpp>
+#include <Image/Image.hpp>
+#include <PngWriter/PngWriter.hpp>
+#include <vector>
+
+void Screenshot::request(std::string path) {
+	m_requested = std::move(path);
+}
+
+bool Screenshot::pending() {
+	return !m_requested.empty();
+}
+
+void Screenshot::update(GLuint texture, int width, int height) {
+	if(m_reading) {
+		if(!m_readback.ready())
+			return;
+		m_reading = false;
+
+		std::string path = m_path;
+		m_job = m_jobs.spawn([this, path]{
+			int w = m_readback.width(), h = m_readback.height();
+			std::vector<uint8_t> pixels(m_readback.size());
+			flip_rows(m_readback.data(), pixels.data(), static_cast<size_t>(w)*4, h);
+			m_readback.release();
+
+			bool ok = write_png(path, w, h, 4, pixels.data(), PngSettings(), &m_jobs);
+			std::lock_guard<std::mutex> lock(m_results_mutex);
+			m_results.emplace_back(path, ok);
+		});
+		return;
+	}
+
+	if(!m_requested.empty() && m_readback.idle()) {
+		m_path = std::move(m_requested);
+		m_requested.clear();
+		m_readback.start(texture, width, height);
+		m_reading = true;
+	}
+}
+
+bool Screenshot::finished(std::string &path, bool &ok) {
+	std::lock_guard<std::mutex> lock(m_results_mutex);
+	if(m_results.empty())
+		return false;
+	path = m_results.front().first;
+	ok = m_results.front().second;
+	m_results.pop_front();
+	return true;
+}
+
+Screenshot::Screenshot(JobSystem &jobs):
+	m_jobs{jobs},
+	m_reading{false}
+{;}
+
+Screenshot::~Screenshot() {
+	m_jobs.wait(m_job);
+}
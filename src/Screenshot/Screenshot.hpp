@@ -0,0 +1,43 @@
+#ifndef SCREENSHOT_HEADER
+#define SCREENSHOT_HEADER
+
+#include <GL/gl.h>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <Readback/Readback.hpp>
+#include <Jobs/JobSystem.hpp>
+
+// Saves a texture to PNG without stalling the render thread. The texture is
+// read back asynchronously and picked up a few frames later; the vertical
+// flip and the PNG encoding run as a job, the encoding split into further
+// jobs band by band.
+class Screenshot
+{
+private:
+	Readback m_readback;
+	JobSystem &m_jobs;
+	JobSystem::Task m_job;
+	std::string m_requested;
+	std::string m_path;
+	bool m_reading;
+
+	std::mutex m_results_mutex;
+	std::deque<std::pair<std::string, bool>> m_results;
+public:
+	// Takes the next frame once the previous screenshot left the GPU.
+	void request(std::string path);
+	// Whether a request waits for a frame.
+	bool pending();
+	// GL thread, once per frame after texture was rendered.
+	void update(GLuint texture, int width, int height);
+	// Reports each finished screenshot once.
+	bool finished(std::string &path, bool &ok);
+
+	explicit Screenshot(JobSystem &jobs);
+	// Waits for the last screenshot to be written.
+	~Screenshot();
+};
+
+#endif
@@ -1,49 +1,73 @@
 #include <GL/glew.h>
 #include <GL/gl.h>
 #include <fstream>
+#include <stdexcept>
 #include <Shader/Shader.hpp>
 
 bool readfile(const char* filename, std::string &contents)
 {
-	std::ifstream f(filename);
+	std::ifstream f(filename, std::ios::binary | std::ios::ate);
 	if(!f.good()) {
 		return false;
 	}
-	char c;
-	while((c = f.get()),f.good()) {
-		contents+=c;
-	}
-	f.close();
+	std::streamoff size = f.tellg();
+	f.seekg(0);
+	std::string::size_type offset = contents.size();
+	contents.resize(offset + size);
+	f.read(&contents[offset], size);
+	contents.resize(offset + f.gcount());
 	return true;
 }
 
+bool enable_parallel_shader_compile()
+{
+	if(GLEW_KHR_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		return true;
+	}
+	if(GLEW_ARB_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		return true;
+	}
+	return false;
+}
 
 void Shader::create(GLenum type) {
 	m_type = type;
 	m_shader = glCreateShader(type);
 }
 
-void Shader::load_src(GLenum type, std::string src) {
+void Shader::load_src(GLenum type, std::string_view src) {
 	this->create(type);
 	this->set_src(src);
 	this->compile();
-	GLint status;
-	glGetShaderiv(m_shader, GL_COMPILE_STATUS, &status);
-	if(status != GL_TRUE) {
-		// TODO: throw exceptions
+	if(!this->compile_status()) {
+		throw std::runtime_error(this->info_log());
 	}
 }
 
 void Shader::load_file(GLenum type, std::string file) {
 	std::string src;
-	if(readfile(file.c_str(), src)) {
-		this->load_src(type, src);
+	if(!readfile(file.c_str(), src)) {
+		throw std::runtime_error("Could not read " + file);
 	}
+	this->load_src(type, src);
+}
+
+void Shader::set_src(std::string_view src) {
+	const char *src_ptr = src.data();
+	GLint length = src.size();
+	glShaderSource(m_shader, 1, &src_ptr, &length);
 }
 
-void Shader::set_src(std::string src) {
-	const char *src_cstr = src.c_str();
-	glShaderSource(m_shader, 1, &src_cstr, NULL);
+void Shader::set_src(const std::vector<std::string_view> &pieces) {
+	std::vector<const char*> ptrs(pieces.size());
+	std::vector<GLint> lengths(pieces.size());
+	for(unsigned int i=0;i<pieces.size();++i) {
+		ptrs[i] = pieces[i].data();
+		lengths[i] = pieces[i].size();
+	}
+	glShaderSource(m_shader, pieces.size(), ptrs.data(), lengths.data());
 }
 
 void Shader::set_file(std::string file) {
@@ -56,6 +80,31 @@ void Shader::compile() {
 	glCompileShader(m_shader);
 }
 
+bool Shader::completion_status() {
+	if(!GLEW_KHR_parallel_shader_compile && !GLEW_ARB_parallel_shader_compile)
+		return true;
+	GLint done;
+	glGetShaderiv(m_shader, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+
+bool Shader::compile_status() {
+	GLint status;
+	glGetShaderiv(m_shader, GL_COMPILE_STATUS, &status);
+	return status == GL_TRUE;
+}
+
+std::string Shader::info_log() {
+	GLint length = 0;
+	glGetShaderiv(m_shader, GL_INFO_LOG_LENGTH, &length);
+	if(length <= 0)
+		return {};
+	std::string log(length, '\0');
+	glGetShaderInfoLog(m_shader, length, NULL, &log[0]);
+	log.resize(length-1);
+	return log;
+}
+
 void Shader::destroy() {
 	if(*this)
 		glDeleteShader(m_shader);
@@ -3,6 +3,15 @@
 
 #include <GL/gl.h>
 #include <string>
+#include <string_view>
+#include <vector>
+
+bool readfile(const char* filename, std::string &contents);
+
+// Lets the driver compile and link on its own threads when
+// GL_KHR_parallel_shader_compile (or the ARB variant) is available.
+// Returns whether parallel compilation is enabled.
+bool enable_parallel_shader_compile();
 
 class Shader
 {
@@ -13,11 +22,19 @@ public:
 	operator GLuint();
 	operator bool();
 	void create(GLenum type);
+	// Compiles synchronously, throws std::runtime_error with the info log
+	// if compilation fails.
 	void load_file(GLenum type, std::string file);
-	void load_src(GLenum type, std::string src);
-	void set_src(std::string src);
+	void load_src(GLenum type, std::string_view src);
+	void set_src(std::string_view src);
+	// Sets the source from several strings without joining them.
+	void set_src(const std::vector<std::string_view> &pieces);
 	void set_file(std::string src);
 	void compile();
+	// Non-blocking: false while a parallel compile is still running.
+	bool completion_status();
+	bool compile_status();
+	std::string info_log();
 	void destroy();
 
 	Shader();
@@ -25,4 +42,4 @@ public:
 	~Shader();
 };
 
-#endif
\ No newline at end of file
+#endif
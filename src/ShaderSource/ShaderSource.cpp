@@ -0,0 +1,124 @@
+#include <ShaderSource/ShaderSource.hpp>
+#include <algorithm>
+
+namespace {
+
+std::string directory_of(const std::string &path)
+{
+	std::string::size_type slash = path.find_last_of('/');
+	return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+bool starts_with(std::string_view str, std::string_view prefix)
+{
+	return str.substr(0, prefix.size()) == prefix;
+}
+
+std::string_view trim_front(std::string_view str)
+{
+	while(!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+		str.remove_prefix(1);
+	return str;
+}
+
+}
+
+void ShaderSource::generated(std::string text) {
+	m_generated.push_back(std::move(text));
+	m_pieces.push_back(m_generated.back());
+}
+
+bool ShaderSource::include(AssetStore &store, const std::string &path, const std::vector<std::string> *defines) {
+	Asset asset = store.get(path);
+	if(!asset) {
+		m_error = "Could not read " + path;
+		return false;
+	}
+	m_assets.push_back(asset);
+	int file_index = m_files.size();
+	m_files.push_back(path);
+
+	std::string_view text = asset.data();
+	std::string_view::size_type piece_start = 0, line_start = 0;
+	int line = 1;
+	while(line_start < text.size()) {
+		std::string_view::size_type line_end = text.find('\n', line_start);
+		line_end = (line_end == std::string_view::npos) ? text.size() : line_end+1;
+		std::string_view directive = trim_front(text.substr(line_start, line_end-line_start));
+
+		if(defines && !defines->empty() && starts_with(directive, "#version")) {
+			m_pieces.push_back(text.substr(piece_start, line_end-piece_start));
+			std::string block = (text[line_end-1] == '\n') ? "" : "\n";
+			for(auto &define : *defines)
+				block += "#define " + define + "\n";
+			block += "#line " + std::to_string(line+1) + " " + std::to_string(file_index) + "\n";
+			generated(block);
+			piece_start = line_end;
+		}
+		else if(starts_with(directive, "#include")) {
+			std::string_view arg = directive.substr(8);
+			std::string_view::size_type open = arg.find('"');
+			std::string_view::size_type close = (open == std::string_view::npos) ? open : arg.find('"', open+1);
+			if(close == std::string_view::npos) {
+				m_error = path + ":" + std::to_string(line) + ": malformed #include";
+				return false;
+			}
+			std::string name{arg.substr(open+1, close-open-1)};
+			std::string included = normalize_path(directory_of(path) + "/" + name);
+
+			m_pieces.push_back(text.substr(piece_start, line_start-piece_start));
+			if(std::find(m_files.begin(), m_files.end(), included) == m_files.end()) {
+				generated("#line 1 " + std::to_string(m_files.size()) + "\n");
+				if(!include(store, included, nullptr))
+					return false;
+				generated("\n#line " + std::to_string(line+1) + " " + std::to_string(file_index) + "\n");
+			}
+			piece_start = line_end;
+		}
+
+		line_start = line_end;
+		++line;
+	}
+	if(piece_start < text.size())
+		m_pieces.push_back(text.substr(piece_start));
+	return true;
+}
+
+bool ShaderSource::load(AssetStore &store, const std::string &path, const std::vector<std::string> &defines) {
+	m_pieces.clear();
+	m_assets.clear();
+	m_generated.clear();
+	m_files.clear();
+	m_error.clear();
+	return include(store, normalize_path(path), &defines);
+}
+
+const std::vector<std::string_view> &ShaderSource::pieces() const {
+	return m_pieces;
+}
+
+const std::vector<std::string> &ShaderSource::files() const {
+	return m_files;
+}
+
+const std::string &ShaderSource::error() const {
+	return m_error;
+}
+
+void ShaderSource::hash(fnv1a &hash) const {
+	// Hash the text as one stream so the key does not depend on how it
+	// happened to be split into pieces.
+	uint64_t size = 0;
+	for(auto piece : m_pieces)
+		size += piece.size();
+	hash.update(&size, sizeof(size));
+	for(auto piece : m_pieces)
+		hash.update(piece.data(), piece.size());
+}
+
+std::string ShaderSource::str() const {
+	std::string out;
+	for(auto piece : m_pieces)
+		out.append(piece.data(), piece.size());
+	return out;
+}
@@ -0,0 +1,41 @@
+#ifndef SHADER_SOURCE_HEADER
+#define SHADER_SOURCE_HEADER
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <Asset/Asset.hpp>
+#include <Util/hash.hpp>
+
+// GLSL source assembled from pieces that point straight into mapped assets,
+// ready for a multi-string glShaderSource.
+//
+// Resolves #include "file" relative to the including file; each file is
+// included at most once. #define lines for the given defines are inserted
+// after #version. #line directives keep compiler messages pointing at the
+// right line, with the source string number indexing files().
+class ShaderSource
+{
+private:
+	std::vector<std::string_view> m_pieces;
+	std::vector<Asset> m_assets;
+	std::deque<std::string> m_generated;
+	std::vector<std::string> m_files;
+	std::string m_error;
+
+	void generated(std::string text);
+	bool include(AssetStore &store, const std::string &path, const std::vector<std::string> *defines);
+public:
+	bool load(AssetStore &store, const std::string &path, const std::vector<std::string> &defines = {});
+
+	const std::vector<std::string_view> &pieces() const;
+	// The loaded file followed by every file it included.
+	const std::vector<std::string> &files() const;
+	const std::string &error() const;
+
+	void hash(fnv1a &hash) const;
+	std::string str() const;
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include <GL/glew.h>
+#include <Shadow/ShadowCascades.hpp>
+#include <Camera/Camera.hpp>
+#include <GlState/GlState.hpp>
+#include <Terrain/Terrain.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// The Shadows block in lighting/shader.frag.
+struct ShadowBlock {
+	glm::mat4 matrices[ShadowCascades::max_cascades];
+	glm::vec4 rects[ShadowCascades::max_cascades];
+	glm::vec4 bias;
+	GLint cascades;
+	GLint _padding0[3];
+};
+
+// Half the height range cascades are fitted around: water surface to the
+// highest ground, what can be lit and what can cast.
+const float half_height = (terrain_max_height - terrain_water_level)*0.5f;
+
+// Sun space looks towards the terrain along -sun.
+glm::mat3 sun_rotation(glm::vec3 sun)
+{
+	glm::vec3 up = std::abs(sun.z) > 0.99f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 0.f, 1.f);
+	return glm::mat3(glm::lookAt(glm::vec3(0.f), -sun, up));
+}
+
+}
+
+glm::ivec2 ShadowCascades::tile(unsigned cascade) const {
+	return glm::ivec2(cascade % m_columns, cascade / m_columns)*m_settings.resolution;
+}
+
+float ShadowCascades::radius(unsigned cascade) const {
+	float distance = m_cascades[cascade].distance;
+	return std::sqrt(distance*distance + half_height*half_height);
+}
+
+glm::vec3 ShadowCascades::center(glm::vec2 camera, const glm::mat3 &rotation) const {
+	return rotation*glm::vec3(camera, terrain_water_level + half_height);
+}
+
+bool ShadowCascades::due(unsigned cascade, glm::vec3 center, glm::vec3 sun) const {
+	const Cascade &rendered = m_cascades[cascade];
+	return !rendered.valid || sun != rendered.sun ||
+		glm::distance(center, rendered.center) > radius(cascade)*m_settings.slack;
+}
+
+void ShadowCascades::render(unsigned cascade, glm::vec3 center, glm::vec3 sun, const glm::mat3 &rotation, GlState &gl_state, const DrawFunction &draw) {
+	float size = radius(cascade)*(1.f + m_settings.slack);
+	float texel = 2.f*size/m_settings.resolution;
+	center.x = std::floor(center.x/texel)*texel;
+	center.y = std::floor(center.y/texel)*texel;
+
+	Cascade &rendered = m_cascades[cascade];
+	rendered.valid = true;
+	rendered.center = center;
+	rendered.sun = sun;
+	rendered.view_projection = reverse_z_ortho(
+		center.x - size, center.x + size, center.y - size, center.y + size,
+		-center.z - size, -center.z + size
+	)*glm::mat4(rotation);
+	rendered.rendered = m_update;
+	++m_stats.rendered[cascade];
+
+	glm::ivec2 offset = tile(cascade);
+	gl_state.viewport(offset.x, offset.y, m_settings.resolution, m_settings.resolution);
+	glScissor(offset.x, offset.y, m_settings.resolution, m_settings.resolution);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	draw(rendered.view_projection);
+}
+
+void ShadowCascades::upload() {
+	ShadowBlock block;
+	glm::vec2 atlas(m_atlas.width(), m_atlas.height());
+	glm::vec2 scale = static_cast<float>(m_settings.resolution)/atlas;
+	// Far enough inside the tile for the lighting pass's filter taps.
+	glm::vec2 inset = 1.5f/atlas;
+	for(unsigned i=0;i<max_cascades;++i) {
+		if(i >= m_cascades.size() || !m_cascades[i].valid) {
+			block.matrices[i] = glm::mat4(1.f);
+			block.rects[i] = glm::vec4(1.f, 1.f, 0.f, 0.f);
+			block.bias[i] = 0.f;
+			continue;
+		}
+		glm::vec2 origin = glm::vec2(tile(i))/atlas;
+		glm::mat4 to_atlas(1.f);
+		to_atlas[0][0] = 0.5f*scale.x;
+		to_atlas[1][1] = 0.5f*scale.y;
+		to_atlas[3][0] = origin.x + 0.5f*scale.x;
+		to_atlas[3][1] = origin.y + 0.5f*scale.y;
+		block.matrices[i] = to_atlas*m_cascades[i].view_projection;
+		block.rects[i] = glm::vec4(origin + inset, origin + scale - inset);
+		// Depth spans as much as a cascade side.
+		block.bias[i] = m_settings.bias_texels/m_settings.resolution;
+	}
+	block.cascades = m_cascades.size();
+	m_block.sub_data(0, sizeof(block), &block);
+}
+
+bool ShadowCascades::outdated(glm::vec2 camera, glm::vec3 sun) const {
+	sun = glm::normalize(sun);
+	glm::vec3 position = center(camera, sun_rotation(sun));
+	for(unsigned i=0;i<m_cascades.size();++i)
+		if(due(i, position, sun))
+			return true;
+	return false;
+}
+
+unsigned ShadowCascades::update(glm::vec2 camera, glm::vec3 sun, GlState &gl_state, const DrawFunction &draw) {
+	++m_update;
+	sun = glm::normalize(sun);
+	glm::mat3 rotation = sun_rotation(sun);
+	glm::vec3 position = center(camera, rotation);
+
+	unsigned rendered = 0;
+	m_pending = false;
+	for(unsigned i=0;i<m_cascades.size();++i) {
+		if(!due(i, position, sun))
+			continue;
+		// Cascade i at most every 2^i updates.
+		bool waiting = m_cascades[i].valid && m_update - m_cascades[i].rendered < (1ull << i);
+		if(waiting || rendered == m_settings.frame_budget) {
+			m_pending = true;
+			++m_stats.deferred;
+			continue;
+		}
+		if(!rendered) {
+			gl_state.bind_framebuffer(m_framebuffer);
+			gl_state.polygon_mode(GL_FILL);
+			gl_state.enable(GL_DEPTH_TEST);
+			gl_state.depth_func(GL_GREATER);
+			gl_state.depth_mask(true);
+			// Terrain between the sun and a cascade still casts into it,
+			// flattened onto the near plane.
+			gl_state.enable(GL_DEPTH_CLAMP);
+			gl_state.enable(GL_SCISSOR_TEST);
+		}
+		render(i, position, sun, rotation, gl_state, draw);
+		++rendered;
+	}
+	if(rendered) {
+		gl_state.disable(GL_DEPTH_CLAMP);
+		gl_state.disable(GL_SCISSOR_TEST);
+		upload();
+		++m_generation;
+	}
+	return rendered;
+}
+
+bool ShadowCascades::pending() const {
+	return m_pending;
+}
+
+uint64_t ShadowCascades::generation() const {
+	return m_generation;
+}
+
+ShadowCascades::Stats ShadowCascades::stats() const {
+	return m_stats;
+}
+
+ShadowCascades::ShadowCascades():
+	ShadowCascades(Settings())
+{;}
+
+ShadowCascades::ShadowCascades(const Settings &settings):
+	m_settings(settings),
+	m_update{0},
+	m_generation{0},
+	m_pending{false},
+	m_stats{}
+{
+	m_settings.cascades = std::clamp(m_settings.cascades, 1u, max_cascades);
+	m_settings.resolution = std::max(m_settings.resolution, 16);
+	m_settings.max_distance = std::max(m_settings.max_distance, 2.f);
+	m_settings.split_lambda = std::clamp(m_settings.split_lambda, 0.f, 1.f);
+	m_settings.slack = std::max(m_settings.slack, 0.f);
+	m_settings.frame_budget = std::max(m_settings.frame_budget, 1u);
+
+	// Practical split scheme from 1 unit out; the camera's near plane is
+	// far closer than any shadow worth a cascade.
+	float n = 1.f, f = m_settings.max_distance;
+	for(unsigned i=1;i<=m_settings.cascades;++i) {
+		float t = static_cast<float>(i)/m_settings.cascades;
+		float distance = m_settings.split_lambda*n*std::pow(f/n, t) + (1.f - m_settings.split_lambda)*(n + (f - n)*t);
+		m_cascades.push_back(Cascade{distance, false, glm::vec3(0.f), glm::vec3(0.f), glm::mat4(1.f), 0});
+	}
+
+	m_columns = m_settings.cascades > 1 ? 2 : 1;
+	int rows = (m_settings.cascades + m_columns - 1)/m_columns;
+	m_atlas = Texture("shadows", GL_DEPTH_COMPONENT32F, m_columns*m_settings.resolution, rows*m_settings.resolution);
+	m_atlas.parameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	m_atlas.parameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	m_atlas.parameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	m_atlas.parameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// Reverse-Z: lit where the compared depth is at least the stored one.
+	m_atlas.parameter(GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	m_atlas.parameter(GL_TEXTURE_COMPARE_FUNC, GL_GEQUAL);
+	m_atlas.label("shadow cascades");
+	m_atlas.bind(atlas_unit);
+
+	m_framebuffer.attach(GL_DEPTH_ATTACHMENT, m_atlas);
+	m_framebuffer.draw_buffers({GL_NONE});
+	m_framebuffer.label("shadow cascades");
+
+	m_block = Buffer("uniforms", sizeof(ShadowBlock), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	m_block.label("shadows");
+	glBindBufferBase(GL_UNIFORM_BUFFER, block_binding, m_block);
+	upload();
+}
@@ -0,0 +1,117 @@
+#ifndef SHADOW_CASCADES_HEADER
+#define SHADOW_CASCADES_HEADER
+
+#include <GL/gl.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <GpuResource/Buffer.hpp>
+#include <GpuResource/Framebuffer.hpp>
+#include <GpuResource/Texture.hpp>
+
+class GlState;
+
+// Cascaded shadow maps of the terrain for the sun, tiles of one reverse-Z
+// depth atlas.
+//
+// Cascade i covers the ground within a split distance of the camera, the
+// splits blending logarithmic and uniform spacing out to max_distance. Each
+// is fitted around the camera's horizontal position and the height range of
+// the terrain only, so turning the camera or changing its height never
+// invalidates one. Cascades are rendered with slack around what they must
+// cover and their centres snapped to whole texels: the camera can move a
+// fraction of a cascade's size before it is due again, and a re-rendered
+// cascade samples the terrain at the same places, so edges don't crawl.
+// A change of sun direction makes every cascade due.
+//
+// Due cascades are refreshed nearest first, cascade i at most every 2^i
+// updates and at most frame_budget of them per update. One held back stays
+// valid where it still reaches, and the lighting pass falls back to the
+// next cascade that covers a point; the shadows lag instead of the frame.
+//
+// The lighting program reads the cascades through the Shadows uniform
+// block (binding 3) and the atlas, with depth comparison, on unit 12.
+class ShadowCascades
+{
+public:
+	static constexpr unsigned max_cascades = 4;
+	static constexpr GLuint block_binding = 3;
+	static constexpr GLuint atlas_unit = 12;
+
+	struct Settings {
+		// At most max_cascades.
+		unsigned cascades = 4;
+		// Texels per cascade side.
+		int resolution = 1024;
+		// Ground covered by the last cascade.
+		float max_distance = 1500.f;
+		// 1 for logarithmic splits, 0 for uniform ones.
+		float split_lambda = 0.75f;
+		// Extra size of each cascade, as a fraction of what it must cover.
+		float slack = 0.2f;
+		// Cascades rendered per update.
+		unsigned frame_budget = 2;
+		// Depth bias, in texels of the cascade.
+		float bias_texels = 3.f;
+	};
+	struct Stats {
+		// Per cascade.
+		unsigned long long rendered[max_cascades];
+		// Due cascades held back by their interval or the frame budget.
+		unsigned long long deferred;
+	};
+	// Renders the terrain's depth with the given sun view and projection
+	// into the bound framebuffer.
+	using DrawFunction = std::function<void(const glm::mat4 &view_projection)>;
+private:
+	struct Cascade {
+		// Ground distance it must cover.
+		float distance;
+		bool valid;
+		// Snapped sun space centre and sun direction it was rendered with.
+		glm::vec3 center;
+		glm::vec3 sun;
+		glm::mat4 view_projection;
+		uint64_t rendered;
+	};
+
+	Settings m_settings;
+	std::vector<Cascade> m_cascades;
+	int m_columns;
+	uint64_t m_update;
+	uint64_t m_generation;
+	bool m_pending;
+
+	Texture m_atlas;
+	Framebuffer m_framebuffer;
+	Buffer m_block;
+
+	Stats m_stats;
+
+	glm::ivec2 tile(unsigned cascade) const;
+	// The cascade's sphere around the camera, its centre in sun space.
+	float radius(unsigned cascade) const;
+	glm::vec3 center(glm::vec2 camera, const glm::mat3 &rotation) const;
+	bool due(unsigned cascade, glm::vec3 center, glm::vec3 sun) const;
+	void render(unsigned cascade, glm::vec3 center, glm::vec3 sun, const glm::mat3 &rotation, GlState &gl_state, const DrawFunction &draw);
+	void upload();
+public:
+	// Whether update() would render anything with the camera at this
+	// terrain position.
+	bool outdated(glm::vec2 camera, glm::vec3 sun) const;
+	// Renders the due cascades the budgets allow, returns how many.
+	unsigned update(glm::vec2 camera, glm::vec3 sun, GlState &gl_state, const DrawFunction &draw);
+	// Whether the last update held back due cascades.
+	bool pending() const;
+	// Changes whenever what the lighting pass reads changed.
+	uint64_t generation() const;
+	Stats stats() const;
+
+	ShadowCascades();
+	explicit ShadowCascades(const Settings &settings);
+	ShadowCascades(const ShadowCascades&) = delete;
+	ShadowCascades &operator=(const ShadowCascades&) = delete;
+};
+
+#endif
@@ -0,0 +1,235 @@
+#include <Terrain/Terrain.hpp>
+#include <algorithm>
+#include <cmath>
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+
+namespace {
+
+float mod289(float x)
+{
+	return x - std::floor(x * (1.f / 289.f)) * 289.f;
+}
+
+float permute(float x)
+{
+	return mod289(((x*34.f)+1.f)*x);
+}
+
+float fract(float x)
+{
+	return x - std::floor(x);
+}
+
+// pow(x, 3.0) in the shader, multiplied out to match the SIMD version.
+float cube(float x)
+{
+	return x*x*x;
+}
+
+float sign(float x)
+{
+	return static_cast<float>((x > 0.f) - (x < 0.f));
+}
+
+#ifdef __SSE4_1__
+// The scalar functions below on four points at once, operation for
+// operation, so without -ffast-math the lanes match them bit for bit.
+
+__m128 mod289_ps(__m128 x)
+{
+	return _mm_sub_ps(x, _mm_mul_ps(_mm_floor_ps(_mm_mul_ps(x, _mm_set1_ps(1.f / 289.f))), _mm_set1_ps(289.f)));
+}
+
+__m128 permute_ps(__m128 x)
+{
+	return mod289_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(34.f)), _mm_set1_ps(1.f)), x));
+}
+
+__m128 abs_ps(__m128 x)
+{
+	return _mm_andnot_ps(_mm_set1_ps(-0.f), x);
+}
+
+__m128 simplex_noise_ps(__m128 x, __m128 y)
+{
+	const __m128 cx = _mm_set1_ps(0.211324865405187f);
+	const __m128 cy = _mm_set1_ps(0.366025403784439f);
+	const __m128 cz = _mm_set1_ps(-0.577350269189626f);
+	const __m128 cw = _mm_set1_ps(0.024390243902439f);
+	const __m128 one = _mm_set1_ps(1.f), half = _mm_set1_ps(0.5f), zero = _mm_setzero_ps();
+
+	__m128 skew = _mm_mul_ps(_mm_add_ps(x, y), cy);
+	__m128 ix = _mm_floor_ps(_mm_add_ps(x, skew)), iy = _mm_floor_ps(_mm_add_ps(y, skew));
+	__m128 unskew = _mm_mul_ps(_mm_add_ps(ix, iy), cx);
+	__m128 x0 = _mm_add_ps(_mm_sub_ps(x, ix), unskew), y0 = _mm_add_ps(_mm_sub_ps(y, iy), unskew);
+
+	__m128 i1x = _mm_and_ps(_mm_cmpgt_ps(x0, y0), one), i1y = _mm_sub_ps(one, i1x);
+	__m128 gx[3] = {x0, _mm_sub_ps(_mm_add_ps(x0, cx), i1x), _mm_add_ps(x0, cz)};
+	__m128 gy[3] = {y0, _mm_sub_ps(_mm_add_ps(y0, cx), i1y), _mm_add_ps(y0, cz)};
+
+	ix = mod289_ps(ix);
+	iy = mod289_ps(iy);
+	__m128 p[3] = {
+		permute_ps(_mm_add_ps(permute_ps(iy), ix)),
+		permute_ps(_mm_add_ps(_mm_add_ps(permute_ps(_mm_add_ps(iy, i1y)), ix), i1x)),
+		permute_ps(_mm_add_ps(_mm_add_ps(permute_ps(_mm_add_ps(iy, one)), ix), one)),
+	};
+
+	__m128 sum = zero;
+	for(int corner=0;corner<3;++corner) {
+		__m128 m = _mm_max_ps(_mm_sub_ps(half, _mm_add_ps(_mm_mul_ps(gx[corner], gx[corner]), _mm_mul_ps(gy[corner], gy[corner]))), zero);
+		__m128 scaled = _mm_mul_ps(p[corner], cw);
+		__m128 gradient = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(2.f), _mm_sub_ps(scaled, _mm_floor_ps(scaled))), one);
+		__m128 h = _mm_sub_ps(abs_ps(gradient), half);
+		__m128 a0 = _mm_sub_ps(gradient, _mm_floor_ps(_mm_add_ps(gradient, half)));
+		__m128 weight = _mm_mul_ps(m, m);
+		weight = _mm_mul_ps(weight, weight);
+		weight = _mm_mul_ps(weight, _mm_sub_ps(
+			_mm_set1_ps(1.79284291400159f),
+			_mm_mul_ps(_mm_set1_ps(0.85373472095314f), _mm_add_ps(_mm_mul_ps(a0, a0), _mm_mul_ps(h, h)))
+		));
+		sum = _mm_add_ps(sum, _mm_mul_ps(weight, _mm_add_ps(_mm_mul_ps(a0, gx[corner]), _mm_mul_ps(h, gy[corner]))));
+	}
+	return _mm_mul_ps(_mm_set1_ps(130.f), sum);
+}
+
+__m128 terrain_height_ps(__m128 x, __m128 y)
+{
+	const float frequencies[7] = {
+		1.f, 2.22123135f, 3.14159f, 8.2545734565225f, 16.21231235f, 32.25123987f, 64.123123523425f
+	};
+	x = _mm_mul_ps(x, _mm_set1_ps(terrain_reverse_period));
+	y = _mm_mul_ps(y, _mm_set1_ps(terrain_reverse_period));
+	__m128 noise = _mm_setzero_ps();
+	for(int octave=0;octave<7;++octave) {
+		__m128 frequency = _mm_set1_ps(frequencies[octave]);
+		__m128 value = simplex_noise_ps(_mm_mul_ps(x, frequency), _mm_mul_ps(y, frequency));
+		noise = _mm_add_ps(noise, _mm_div_ps(value, _mm_set1_ps(static_cast<float>(1 << octave))));
+	}
+	__m128 land = simplex_noise_ps(_mm_mul_ps(x, _mm_set1_ps(2.12124f)), _mm_mul_ps(y, _mm_set1_ps(2.12124f)));
+	// sign(land)*cube(cube(|land|)*2)
+	__m128 magnitude = abs_ps(land);
+	__m128 cubed = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(magnitude, magnitude), magnitude), _mm_set1_ps(2.f));
+	cubed = _mm_mul_ps(_mm_mul_ps(cubed, cubed), cubed);
+	noise = _mm_add_ps(noise, _mm_or_ps(cubed, _mm_and_ps(land, _mm_set1_ps(-0.f))));
+	noise = _mm_div_ps(noise, _mm_set1_ps(6.f));
+
+	__m128 height = _mm_mul_ps(noise, _mm_set1_ps(terrain_multiplier));
+	__m128 underwater = _mm_cmplt_ps(height, _mm_set1_ps(terrain_water_level));
+	return _mm_blendv_ps(height, _mm_mul_ps(height, _mm_set1_ps(10.f)), underwater);
+}
+#endif
+
+}
+
+float simplex_noise(float x, float y)
+{
+	const float cx = 0.211324865405187f;  // (3.0-sqrt(3.0))/6.0
+	const float cy = 0.366025403784439f;  // 0.5*(sqrt(3.0)-1.0)
+	const float cz = -0.577350269189626f; // -1.0 + 2.0 * C.x
+	const float cw = 0.024390243902439f;  // 1.0 / 41.0
+
+	// First corner
+	float skew = (x + y)*cy;
+	float ix = std::floor(x + skew), iy = std::floor(y + skew);
+	float unskew = (ix + iy)*cx;
+	float x0 = x - ix + unskew, y0 = y - iy + unskew;
+
+	// Other corners
+	float i1x = x0 > y0 ? 1.f : 0.f, i1y = x0 > y0 ? 0.f : 1.f;
+	float x1 = x0 + cx - i1x, y1 = y0 + cx - i1y;
+	float x2 = x0 + cz, y2 = y0 + cz;
+
+	// Permutations
+	ix = mod289(ix);
+	iy = mod289(iy);
+	float p[3] = {
+		permute(permute(iy      ) + ix      ),
+		permute(permute(iy + i1y) + ix + i1x),
+		permute(permute(iy + 1.f) + ix + 1.f),
+	};
+
+	float m[3] = {
+		std::max(0.5f - (x0*x0 + y0*y0), 0.f),
+		std::max(0.5f - (x1*x1 + y1*y1), 0.f),
+		std::max(0.5f - (x2*x2 + y2*y2), 0.f),
+	};
+	float gx[3] = {x0, x1, x2}, gy[3] = {y0, y1, y2};
+
+	// Gradients: 41 points uniformly over a line, mapped onto a diamond.
+	float sum = 0.f;
+	for(int corner=0;corner<3;++corner) {
+		float gradient = 2.f * fract(p[corner] * cw) - 1.f;
+		float h = std::abs(gradient) - 0.5f;
+		float a0 = gradient - std::floor(gradient + 0.5f);
+		float weight = m[corner]*m[corner];
+		weight *= weight;
+		// Normalise gradients implicitly by scaling m
+		weight *= 1.79284291400159f - 0.85373472095314f * (a0*a0 + h*h);
+		sum += weight * (a0*gx[corner] + h*gy[corner]);
+	}
+	return 130.f * sum;
+}
+
+float terrain_noise(float x, float y)
+{
+	float land = simplex_noise(x*2.12124f, y*2.12124f);
+	return (
+		simplex_noise(x, y) +
+		simplex_noise(x*2.22123135f, y*2.22123135f)/2.f +
+		simplex_noise(x*3.14159f, y*3.14159f)/4.f +
+		simplex_noise(x*8.2545734565225f, y*8.2545734565225f)/8.f +
+		simplex_noise(x*16.21231235f, y*16.21231235f)/16.f +
+		simplex_noise(x*32.25123987f, y*32.25123987f)/32.f +
+		simplex_noise(x*64.123123523425f, y*64.123123523425f)/64.f +
+		sign(land) * cube(cube(std::abs(land))*2.f)
+	) / 6.f;
+}
+
+float terrain_height(float x, float y)
+{
+	float height = terrain_noise(x*terrain_reverse_period, y*terrain_reverse_period)*terrain_multiplier;
+	if(height < terrain_water_level)
+		height *= 10.f;
+	return height;
+}
+
+void terrain_heights(const float *x, const float *y, float *heights, size_t count)
+{
+	size_t i = 0;
+#ifdef __SSE4_1__
+	for(; i + 4 <= count; i += 4)
+		_mm_storeu_ps(heights+i, terrain_height_ps(_mm_loadu_ps(x+i), _mm_loadu_ps(y+i)));
+#endif
+	for(; i < count; ++i)
+		heights[i] = terrain_height(x[i], y[i]);
+}
+
+void terrain_normals(const float *x, const float *y, float step, float *normals, size_t count)
+{
+	// Neighbours of a block of points: left, right, below, above.
+	const size_t block = 256;
+	float px[4*block], py[4*block], heights[4*block];
+	for(size_t first=0;first<count;first+=block) {
+		size_t n = std::min(block, count-first);
+		for(size_t i=0;i<n;++i) {
+			float cx = x[first+i], cy = y[first+i];
+			px[i] = cx - step;       py[i] = cy;
+			px[n+i] = cx + step;     py[n+i] = cy;
+			px[2*n+i] = cx;          py[2*n+i] = cy - step;
+			px[3*n+i] = cx;          py[3*n+i] = cy + step;
+		}
+		terrain_heights(px, py, heights, 4*n);
+		for(size_t i=0;i<n;++i) {
+			float dx = heights[i] - heights[n+i], dy = heights[2*n+i] - heights[3*n+i];
+			float nz = 2.f*step;
+			float length = std::sqrt(dx*dx + dy*dy + nz*nz);
+			float *normal = normals + 3*(first+i);
+			normal[0] = dx/length;
+			normal[1] = dy/length;
+			normal[2] = nz/length;
+		}
+	}
+}
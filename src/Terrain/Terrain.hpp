@@ -0,0 +1,32 @@
+#ifndef TERRAIN_HEADER
+#define TERRAIN_HEADER
+
+#include <cstddef>
+
+// CPU port of the terrain function in lib/terrain.glsl and lib/noise.glsl,
+// for code that needs heights without a GL context. Evaluated in single
+// precision like the shader; the two have to be changed together.
+
+// Positions are terrain coordinates, what the geometry shader feeds to
+// anoise() before scaling by reverse_period.
+const float terrain_reverse_period = 0.001f;
+const float terrain_multiplier = 100.f;
+// The water surface; ground below it is pushed ten times deeper.
+const float terrain_water_level = 0.f;
+// Above anything terrain_height() returns: with |snoise| <= 1 the octaves
+// add up to at most 127/64 and the land term to 8, over 6.
+const float terrain_max_height = 170.f;
+
+// Ashima Arts 2D simplex noise, snoise() in lib/noise.glsl.
+float simplex_noise(float x, float y);
+// anoise(), the octave sum of the height function.
+float terrain_noise(float x, float y);
+// Ground height at (x, y), before water is drawn over it.
+float terrain_height(float x, float y);
+
+// terrain_height() of count points, four at a time with SSE4.1.
+void terrain_heights(const float *x, const float *y, float *heights, size_t count);
+// Unit normals (x, y, z interleaved) from central differences step apart.
+void terrain_normals(const float *x, const float *y, float step, float *normals, size_t count);
+
+#endif
@@ -0,0 +1,186 @@
+#include <TileCache/TileCache.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const TileEntry &MappedTile::entry() const {
+	return m_entry;
+}
+
+uint32_t MappedTile::size() const {
+	return m_size;
+}
+
+float MappedTile::sample(uint32_t x, uint32_t y) const {
+	size_t i = static_cast<size_t>(y)*m_size + x;
+	if(m_format == TileFormat::f32)
+		return static_cast<const float*>(m_mapping)[i];
+	uint16_t quantised = static_cast<const uint16_t*>(m_mapping)[i];
+	return m_entry.min + (m_entry.max - m_entry.min)*(quantised*(1.f/65535.f));
+}
+
+MappedTile::MappedTile(void *mapping, size_t length, const TileEntry &entry, TileFormat format, uint32_t size):
+	m_mapping{mapping},
+	m_length{length},
+	m_entry(entry),
+	m_format{format},
+	m_size{size}
+{;}
+
+MappedTile::~MappedTile() {
+#ifndef _WIN32
+	munmap(m_mapping, m_length);
+#endif
+}
+
+bool TileCache::open(const std::string &path, size_t max_resident, std::string &error) {
+	close();
+#ifdef _WIN32
+	(void)path; (void)max_resident;
+	error = "The tile cache needs POSIX mmap";
+	return false;
+#else
+	m_fd = ::open(path.c_str(), O_RDONLY);
+	if(m_fd == -1) {
+		error = "Could not open " + path;
+		return false;
+	}
+	struct stat st;
+	bool ok = fstat(m_fd, &st) == 0
+	       && pread(m_fd, &m_header, sizeof(m_header), 0) == sizeof(m_header)
+	       && std::memcmp(m_header.magic, tile_file_magic, sizeof(tile_file_magic)) == 0
+	       && m_header.version == tile_file_version;
+	if(!ok) {
+		error = path + " is not a tile file";
+		close();
+		return false;
+	}
+
+	uint64_t data_bytes = static_cast<uint64_t>(m_header.tile_size)*m_header.tile_size*tile_sample_bytes(m_header.format);
+	ok = m_header.size == static_cast<uint64_t>(st.st_size)
+	  && m_header.tile_size >= 2
+	  && m_header.page_size > 0 && m_header.page_size % sysconf(_SC_PAGESIZE) == 0
+	  && m_header.tile_stride >= data_bytes
+	  && m_header.index_offset + static_cast<uint64_t>(m_header.tile_count)*sizeof(TileEntry) <= m_header.size;
+	if(ok) {
+		m_index.resize(m_header.tile_count);
+		size_t index_bytes = m_index.size()*sizeof(TileEntry);
+		ok = pread(m_fd, m_index.data(), index_bytes, m_header.index_offset) == static_cast<ssize_t>(index_bytes)
+		  && std::is_sorted(m_index.begin(), m_index.end());
+		for(auto &entry : m_index)
+			ok = ok && entry.offset % m_header.page_size == 0 && entry.offset + data_bytes <= m_header.size;
+	}
+	if(!ok) {
+		error = path + " is damaged";
+		close();
+		return false;
+	}
+	m_max_resident = std::max<size_t>(max_resident, 1);
+	return true;
+#endif
+}
+
+void TileCache::close() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_resident.clear();
+	m_lru.clear();
+	m_index.clear();
+	m_stats = {0, 0, 0, 0};
+#ifndef _WIN32
+	if(m_fd != -1)
+		::close(m_fd);
+#endif
+	m_fd = -1;
+}
+
+const TileFileHeader &TileCache::header() const {
+	return m_header;
+}
+
+const std::vector<TileEntry> &TileCache::index() const {
+	return m_index;
+}
+
+std::shared_ptr<const MappedTile> TileCache::tile(int x, int y, unsigned lod) {
+	TileEntry key{};
+	key.x = x;
+	key.y = y;
+	key.lod = lod;
+	auto found = std::lower_bound(m_index.begin(), m_index.end(), key);
+	if(found == m_index.end() || found->x != x || found->y != y || found->lod != lod)
+		return nullptr;
+	size_t position = found - m_index.begin();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto resident = m_resident.find(position);
+	if(resident != m_resident.end()) {
+		++m_stats.hits;
+		m_lru.splice(m_lru.begin(), m_lru, resident->second.second);
+		return resident->second.first;
+	}
+
+#ifdef _WIN32
+	return nullptr;
+#else
+	++m_stats.misses;
+	size_t length = static_cast<size_t>(m_header.tile_size)*m_header.tile_size*tile_sample_bytes(m_header.format);
+	void *mapping = mmap(nullptr, length, PROT_READ, MAP_SHARED, m_fd, found->offset);
+	if(mapping == MAP_FAILED)
+		return nullptr;
+	madvise(mapping, length, MADV_WILLNEED);
+	auto mapped = std::make_shared<const MappedTile>(mapping, length, *found, m_header.format, m_header.tile_size);
+
+	if(m_resident.size() >= m_max_resident) {
+		m_resident.erase(m_lru.back());
+		m_lru.pop_back();
+		++m_stats.evictions;
+	}
+	m_lru.push_front(position);
+	m_resident.emplace(position, Resident(mapped, m_lru.begin()));
+	return mapped;
+#endif
+}
+
+bool TileCache::height(float x, float y, unsigned lod, float &height) {
+	if(m_index.empty() || lod < m_header.min_lod || lod > m_header.max_lod)
+		return false;
+	float spacing = std::ldexp(m_header.spacing, lod);
+	int span = m_header.tile_size - 1;
+	float gx = (x - m_header.origin_x)/spacing, gy = (y - m_header.origin_y)/spacing;
+	int tx = static_cast<int>(std::floor(gx/span)), ty = static_cast<int>(std::floor(gy/span));
+	std::shared_ptr<const MappedTile> tile = this->tile(tx, ty, lod);
+	if(!tile)
+		return false;
+
+	float lx = gx - static_cast<float>(tx)*span, ly = gy - static_cast<float>(ty)*span;
+	int ix = std::clamp(static_cast<int>(lx), 0, span-1), iy = std::clamp(static_cast<int>(ly), 0, span-1);
+	float fx = std::clamp(lx - ix, 0.f, 1.f), fy = std::clamp(ly - iy, 0.f, 1.f);
+	float bottom = tile->sample(ix, iy)*(1.f-fx) + tile->sample(ix+1, iy)*fx;
+	float top = tile->sample(ix, iy+1)*(1.f-fx) + tile->sample(ix+1, iy+1)*fx;
+	height = bottom*(1.f-fy) + top*fy;
+	return true;
+}
+
+TileCache::Stats TileCache::stats() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Stats stats = m_stats;
+	stats.resident = m_resident.size();
+	return stats;
+}
+
+TileCache::TileCache():
+	m_fd{-1},
+	m_header{},
+	m_max_resident{1},
+	m_stats{0, 0, 0, 0}
+{;}
+
+TileCache::~TileCache() {
+	close();
+}
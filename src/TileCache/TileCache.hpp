@@ -0,0 +1,83 @@
+#ifndef TILE_CACHE_HEADER
+#define TILE_CACHE_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <TileCache/TileFile.hpp>
+
+// One tile's heights, mapped straight from the file. Stays mapped for as
+// long as it is referenced, also after the cache let go of it.
+class MappedTile
+{
+private:
+	void *m_mapping;
+	size_t m_length;
+	TileEntry m_entry;
+	TileFormat m_format;
+	uint32_t m_size;
+public:
+	const TileEntry &entry() const;
+	// Samples per edge.
+	uint32_t size() const;
+	float sample(uint32_t x, uint32_t y) const;
+
+	MappedTile(void *mapping, size_t length, const TileEntry &entry, TileFormat format, uint32_t size);
+	MappedTile(const MappedTile&) = delete;
+	MappedTile &operator=(const MappedTile&) = delete;
+	~MappedTile();
+};
+
+// Reads a baked tile file (see TileFile.hpp). Only the header and index are
+// read up front; tiles are mapped when first asked for and the most
+// recently used max_resident of them stay mapped, so repeated queries over
+// the same area are served from the page cache without any I/O or
+// re-mapping. Thread-safe.
+class TileCache
+{
+public:
+	struct Stats {
+		unsigned long long hits;
+		unsigned long long misses;
+		unsigned long long evictions;
+		size_t resident;
+	};
+private:
+	using Resident = std::pair<std::shared_ptr<const MappedTile>, std::list<size_t>::iterator>;
+
+	int m_fd;
+	TileFileHeader m_header;
+	std::vector<TileEntry> m_index;
+	size_t m_max_resident;
+
+	std::mutex m_mutex;
+	// Index positions of the mapped tiles, most recently used first.
+	std::list<size_t> m_lru;
+	std::unordered_map<size_t, Resident> m_resident;
+	Stats m_stats;
+public:
+	bool open(const std::string &path, size_t max_resident, std::string &error);
+	void close();
+	const TileFileHeader &header() const;
+	const std::vector<TileEntry> &index() const;
+
+	// Null when the file has no such tile or it could not be mapped.
+	std::shared_ptr<const MappedTile> tile(int x, int y, unsigned lod);
+	// Bilinear height at terrain position (x, y) from the given LOD. False
+	// outside the baked tiles.
+	bool height(float x, float y, unsigned lod, float &height);
+	Stats stats();
+
+	TileCache();
+	TileCache(const TileCache&) = delete;
+	TileCache &operator=(const TileCache&) = delete;
+	~TileCache();
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef TILE_FILE_HEADER
+#define TILE_FILE_HEADER
+
+#include <cstdint>
+#include <tuple>
+
+// Layout of a baked height tile file, written by tools/tilebake and read by
+// TileCache.
+//
+//   TileFileHeader | TileEntry[tile_count] | tile data, page aligned
+//
+// Every tile is tile_size by tile_size height samples, rows of increasing y
+// each of increasing x. Sample spacing is spacing at LOD 0 and doubles with
+// every LOD. Neighbouring tiles share their edge samples, so tile (x, y)
+// of a LOD starts at sample x*(tile_size-1), y*(tile_size-1) of that LOD's
+// grid, which has its first sample at origin. Tile data starts at a
+// multiple of page_size (at least the mapping granularity of every
+// platform) so each tile can be mapped on its own. All offsets are
+// relative to the start of the file, in native byte order.
+const char tile_file_magic[8] = {'I', 'T', 'T', 'I', 'L', 'E', 'S', '\0'};
+const uint32_t tile_file_version = 1;
+const uint32_t tile_file_page_size = 1 << 16;
+
+enum class TileFormat : uint32_t {
+	// Quantised between the tile's min and max, for 65536 steps per tile.
+	u16 = 0,
+	f32 = 1,
+};
+
+struct TileFileHeader {
+	char magic[8];
+	uint32_t version;
+	TileFormat format;
+	uint32_t tile_size;
+	uint32_t tile_count;
+	uint32_t min_lod;
+	uint32_t max_lod;
+	float spacing;
+	float origin_x;
+	float origin_y;
+	uint32_t page_size;
+	uint64_t index_offset;
+	// Distance between the starts of two tiles' data.
+	uint64_t tile_stride;
+	uint64_t size;
+};
+
+// Sorted by LOD, then y, then x.
+struct TileEntry {
+	int32_t x;
+	int32_t y;
+	uint32_t lod;
+	uint32_t reserved;
+	float min;
+	float max;
+	uint64_t offset;
+};
+
+inline uint32_t tile_sample_bytes(TileFormat format)
+{
+	return format == TileFormat::u16 ? 2 : 4;
+}
+
+inline bool operator<(const TileEntry &a, const TileEntry &b)
+{
+	return std::tie(a.lod, a.y, a.x) < std::tie(b.lod, b.y, b.x);
+}
+
+#endif
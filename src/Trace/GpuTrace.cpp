@@ -0,0 +1,81 @@
+#include <GL/glew.h>
+#include <Trace/GpuTrace.hpp>
+
+GLuint GpuTrace::query() {
+	if(m_free.empty()) {
+		GLuint query;
+		glCreateQueries(GL_TIMESTAMP, 1, &query);
+		return query;
+	}
+	GLuint query = m_free.back();
+	m_free.pop_back();
+	return query;
+}
+
+void GpuTrace::calibrate() {
+	GLint64 gpu;
+	glGetInteger64v(GL_TIMESTAMP, &gpu);
+	m_calibrated = trace_now();
+	m_offset = static_cast<int64_t>(m_calibrated) - gpu;
+}
+
+void GpuTrace::begin(const char *name) {
+	if(!trace_enabled()) {
+		m_stack.push_back(nullptr);
+		return;
+	}
+	m_zones.push_back({name, query(), query(), true});
+	Zone &zone = m_zones.back();
+	glQueryCounter(zone.begin, GL_TIMESTAMP);
+	m_stack.push_back(&zone);
+}
+
+void GpuTrace::end() {
+	if(m_stack.empty())
+		return;
+	Zone *zone = m_stack.back();
+	m_stack.pop_back();
+	if(!zone)
+		return;
+	glQueryCounter(zone->end, GL_TIMESTAMP);
+	zone->open = false;
+}
+
+void GpuTrace::poll() {
+	if(!m_zones.empty() && trace_now() - m_calibrated > 1000000000)
+		calibrate();
+	// Zones are kept in begin order; an enclosing zone ends after the zones
+	// inside it, so waiting on the front never skips a finished one for
+	// long.
+	while(!m_zones.empty() && !m_zones.front().open) {
+		Zone &zone = m_zones.front();
+		GLint available = 0;
+		glGetQueryObjectiv(zone.end, GL_QUERY_RESULT_AVAILABLE, &available);
+		if(!available)
+			break;
+		GLuint64 begin, end;
+		glGetQueryObjectui64v(zone.begin, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(zone.end, GL_QUERY_RESULT, &end);
+		trace_record(m_track, zone.name, begin + m_offset, end + m_offset);
+		m_free.push_back(zone.begin);
+		m_free.push_back(zone.end);
+		m_zones.pop_front();
+	}
+}
+
+GpuTrace::GpuTrace():
+	m_track{trace_track("GPU")},
+	m_offset{0},
+	m_calibrated{0}
+{
+	calibrate();
+}
+
+GpuTrace::~GpuTrace() {
+	for(auto &zone : m_zones) {
+		glDeleteQueries(1, &zone.begin);
+		glDeleteQueries(1, &zone.end);
+	}
+	if(!m_free.empty())
+		glDeleteQueries(m_free.size(), m_free.data());
+}
@@ -0,0 +1,74 @@
+#ifndef GPU_TRACE_HEADER
+#define GPU_TRACE_HEADER
+
+#include <GL/gl.h>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <Trace/Trace.hpp>
+
+// GPU zones on a "GPU" track of the trace (see Trace.hpp). begin() and
+// end() put timestamp queries around GL commands; poll(), once a frame,
+// turns the pairs that finished into events, mapped onto the CPU trace
+// clock, and never waits for the GPU. Zones nest. GL thread only; while
+// tracing is off no queries are issued.
+class GpuTrace
+{
+private:
+	struct Zone {
+		const char *name;
+		GLuint begin;
+		GLuint end;
+		bool open;
+	};
+	std::vector<GLuint> m_free;
+	std::deque<Zone> m_zones;
+	std::vector<Zone*> m_stack;
+	TraceTrack *m_track;
+	// CPU trace clock minus GPU clock, refreshed every second because the
+	// two drift apart.
+	int64_t m_offset;
+	uint64_t m_calibrated;
+
+	GLuint query();
+	void calibrate();
+public:
+	void begin(const char *name);
+	void end();
+	void poll();
+
+	GpuTrace();
+	GpuTrace(const GpuTrace&) = delete;
+	GpuTrace &operator=(const GpuTrace&) = delete;
+	~GpuTrace();
+};
+
+class GpuTraceZone
+{
+private:
+	GpuTrace &m_trace;
+public:
+	GpuTraceZone(GpuTrace &trace, const char *name);
+	GpuTraceZone(const GpuTraceZone&) = delete;
+	GpuTraceZone &operator=(const GpuTraceZone&) = delete;
+	~GpuTraceZone();
+};
+
+inline GpuTraceZone::GpuTraceZone(GpuTrace &trace, const char *name):
+	m_trace{trace}
+{
+	m_trace.begin(name);
+}
+
+inline GpuTraceZone::~GpuTraceZone()
+{
+	m_trace.end();
+}
+
+#ifdef NO_TRACE
+#define TRACE_GPU_ZONE(trace, name) do {} while(0)
+#else
+#define TRACE_GPU_ZONE(trace, name) GpuTraceZone TRACE_CONCAT(gpu_trace_zone_, __LINE__){trace, name}
+#endif
+
+#endif
@@ -0,0 +1,207 @@
+#include <Trace/Trace.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+	const char *name;
+	uint64_t start;
+	uint64_t end;
+};
+
+const size_t block_events = 4096;
+// 4M events, about 100 MB.
+const size_t max_blocks = 1024;
+
+struct TraceBlock {
+	TraceEvent events[block_events];
+	std::atomic<size_t> count{0};
+	std::atomic<TraceBlock*> next{nullptr};
+};
+
+std::atomic<size_t> blocks{0};
+std::atomic<unsigned long long> dropped{0};
+std::atomic<uint64_t> epoch{0};
+
+std::mutex &registry_mutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
+
+// Tracks live until the process exits, threads may end before the trace is
+// written.
+std::vector<std::unique_ptr<TraceTrack>> &registry()
+{
+	static std::vector<std::unique_ptr<TraceTrack>> tracks;
+	return tracks;
+}
+
+thread_local TraceTrack *thread_track = nullptr;
+
+void write_string(FILE *file, const std::string &str)
+{
+	std::fputc('"', file);
+	for(char c : str) {
+		if(c == '"' || c == '\\')
+			std::fputc('\\', file);
+		if(static_cast<unsigned char>(c) >= 0x20)
+			std::fputc(c, file);
+	}
+	std::fputc('"', file);
+}
+
+}
+
+struct TraceTrack {
+	std::string name;
+	unsigned id;
+	std::atomic<TraceBlock*> first{nullptr};
+	TraceBlock *last = nullptr;
+
+	~TraceTrack() {
+		for(TraceBlock *block = first; block;) {
+			TraceBlock *next = block->next;
+			delete block;
+			block = next;
+		}
+	}
+};
+
+std::atomic<bool> trace_recording{false};
+
+namespace {
+
+TraceTrack *new_track(std::string name)
+{
+	std::lock_guard<std::mutex> lock(registry_mutex());
+	registry().emplace_back(new TraceTrack);
+	TraceTrack *track = registry().back().get();
+	track->id = registry().size();
+	track->name = name.empty() ? "thread " + std::to_string(track->id) : std::move(name);
+	return track;
+}
+
+TraceTrack *current_track()
+{
+	if(!thread_track)
+		thread_track = new_track("");
+	return thread_track;
+}
+
+}
+
+uint64_t trace_now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()
+	).count();
+}
+
+void trace_start()
+{
+	uint64_t none = 0;
+	epoch.compare_exchange_strong(none, trace_now());
+	trace_recording.store(true, std::memory_order_relaxed);
+}
+
+void trace_stop()
+{
+	trace_recording.store(false, std::memory_order_relaxed);
+}
+
+void trace_thread_name(const std::string &name)
+{
+	TraceTrack *track = current_track();
+	std::lock_guard<std::mutex> lock(registry_mutex());
+	track->name = name;
+}
+
+TraceTrack *trace_track(const std::string &name)
+{
+	return new_track(name);
+}
+
+void trace_record(const char *name, uint64_t start, uint64_t end)
+{
+	trace_record(current_track(), name, start, end);
+}
+
+void trace_record(TraceTrack *track, const char *name, uint64_t start, uint64_t end)
+{
+	TraceBlock *block = track->last;
+	size_t count = block ? block->count.load(std::memory_order_relaxed) : block_events;
+	if(count == block_events) {
+		if(blocks.fetch_add(1, std::memory_order_relaxed) >= max_blocks) {
+			blocks.fetch_sub(1, std::memory_order_relaxed);
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		TraceBlock *fresh = new TraceBlock;
+		if(block)
+			block->next.store(fresh, std::memory_order_release);
+		else
+			track->first.store(fresh, std::memory_order_release);
+		track->last = block = fresh;
+		count = 0;
+	}
+	block->events[count] = {name, start, end};
+	block->count.store(count+1, std::memory_order_release);
+}
+
+unsigned long long trace_dropped()
+{
+	return dropped.load(std::memory_order_relaxed);
+}
+
+bool trace_write(const std::string &path, std::string &error)
+{
+	FILE *file = std::fopen(path.c_str(), "wb");
+	if(!file) {
+		error = "Could not open " + path + ": " + std::strerror(errno);
+		return false;
+	}
+
+	uint64_t start = epoch.load();
+	std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+	std::fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"infiniterrain\"}}", file);
+
+	std::lock_guard<std::mutex> lock(registry_mutex());
+	for(auto &track : registry()) {
+		std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", track->id);
+		write_string(file, track->name);
+		std::fprintf(file, "}},\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"sort_index\":%u}}", track->id, track->id);
+
+		for(TraceBlock *block = track->first.load(std::memory_order_acquire); block; block = block->next.load(std::memory_order_acquire)) {
+			size_t count = block->count.load(std::memory_order_acquire);
+			for(size_t i=0;i<count;++i) {
+				const TraceEvent &event = block->events[i];
+				// Events from before the trace started (GPU results mapped
+				// back onto the CPU clock) are clamped to its start.
+				uint64_t begin = std::max(event.start, start);
+				uint64_t end = std::max(event.end, begin);
+				std::fputs(",\n{\"name\":", file);
+				write_string(file, event.name);
+				std::fprintf(
+					file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					track->id, (begin-start)/1e3, (end-begin)/1e3
+				);
+			}
+		}
+	}
+	std::fputs("\n]}\n", file);
+
+	if(std::fclose(file) != 0) {
+		error = "Could not write " + path + ": " + std::strerror(errno);
+		return false;
+	}
+	return true;
+}
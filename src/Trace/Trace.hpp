@@ -0,0 +1,92 @@
+#ifndef TRACE_HEADER
+#define TRACE_HEADER
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Scoped timing zones, written out as Chrome trace events for
+// chrome://tracing or ui.perfetto.dev.
+//
+// Every thread records into its own track, a list of fixed-size blocks only
+// that thread appends to, so recording takes no locks: an event is written
+// and then published by a release store of the block's count, which
+// trace_write() reads. While tracing is off a zone costs one relaxed load;
+// building with -DNO_TRACE removes the zones of TRACE_ZONE and
+// TRACE_NAMED_ZONE altogether.
+//
+// Zone names are not copied and must outlive the trace; use literals.
+
+struct TraceTrack;
+
+extern std::atomic<bool> trace_recording;
+
+inline bool trace_enabled()
+{
+	return trace_recording.load(std::memory_order_relaxed);
+}
+
+// Nanoseconds on the trace clock, std::chrono::steady_clock.
+uint64_t trace_now();
+void trace_start();
+void trace_stop();
+// Names the calling thread's track.
+void trace_thread_name(const std::string &name);
+// A track not bound to a thread, e.g. for GPU zones. Only one thread at a
+// time may record into it.
+TraceTrack *trace_track(const std::string &name);
+void trace_record(const char *name, uint64_t start, uint64_t end);
+void trace_record(TraceTrack *track, const char *name, uint64_t start, uint64_t end);
+// Events lost because the trace reached its memory limit.
+unsigned long long trace_dropped();
+// Writes everything recorded so far as trace event JSON.
+bool trace_write(const std::string &path, std::string &error);
+
+class TraceZone
+{
+private:
+	const char *m_name;
+	uint64_t m_start;
+public:
+	// Closes the zone before the end of its scope.
+	void end();
+
+	explicit TraceZone(const char *name);
+	TraceZone(const TraceZone&) = delete;
+	TraceZone &operator=(const TraceZone&) = delete;
+	~TraceZone();
+};
+
+inline void TraceZone::end()
+{
+	if(m_name)
+		trace_record(m_name, m_start, trace_now());
+	m_name = nullptr;
+}
+
+inline TraceZone::TraceZone(const char *name):
+	m_name{trace_enabled() ? name : nullptr},
+	m_start{m_name ? trace_now() : 0}
+{;}
+
+inline TraceZone::~TraceZone()
+{
+	end();
+}
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#ifdef NO_TRACE
+// Stands in for a named zone so its end() calls still compile.
+struct NoTraceZone {
+	void end() {}
+};
+#define TRACE_ZONE(name) do {} while(0)
+#define TRACE_NAMED_ZONE(variable, name) NoTraceZone variable
+#else
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(trace_zone_, __LINE__){name}
+// A zone that can be closed early with variable.end().
+#define TRACE_NAMED_ZONE(variable, name) TraceZone variable{name}
+#endif
+
+#endif
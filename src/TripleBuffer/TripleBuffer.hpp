@@ -0,0 +1,58 @@
+#ifndef TRIPLE_BUFFER_HEADER
+#define TRIPLE_BUFFER_HEADER
+
+#include <array>
+#include <atomic>
+
+// Hands the newest value from one writer thread to one reader thread
+// without locks, and without either side ever waiting for the other. The
+// writer fills back() and publishes it, which swaps it with the middle
+// slot; the reader's update() swaps its front slot with the middle one
+// when that holds something newer. A value the reader never got round to
+// is simply replaced by the next one.
+template<typename T>
+class TripleBuffer
+{
+private:
+	static constexpr unsigned fresh_bit = 4;
+
+	std::array<T, 3> m_slots;
+	// Slot indices; the middle one carries fresh_bit while unread.
+	alignas(64) unsigned m_back;
+	alignas(64) std::atomic<unsigned> m_middle;
+	alignas(64) unsigned m_front;
+public:
+	// Writer side.
+	T &back() {
+		return m_slots[m_back];
+	}
+	void publish() {
+		m_back = m_middle.exchange(m_back | fresh_bit, std::memory_order_acq_rel) & ~fresh_bit;
+	}
+
+	// Reader side. Whether a value newer than front() was published.
+	bool fresh() const {
+		return m_middle.load(std::memory_order_acquire) & fresh_bit;
+	}
+	// Takes the newest published value as front(), true if there was one.
+	bool update() {
+		if(!fresh())
+			return false;
+		m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & ~fresh_bit;
+		return true;
+	}
+	const T &front() const {
+		return m_slots[m_front];
+	}
+
+	explicit TripleBuffer(const T &initial = T()):
+		m_slots{{initial, initial, initial}},
+		m_back{0},
+		m_middle{1},
+		m_front{2}
+	{;}
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer &operator=(const TripleBuffer&) = delete;
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef HASH_HEADER
+#define HASH_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Incremental 64-bit FNV-1a. Not cryptographic, only used for cache keys.
+class fnv1a
+{
+private:
+	uint64_t m_state;
+public:
+	void update(const void *data, size_t size) {
+		const unsigned char *bytes = static_cast<const unsigned char*>(data);
+		for(size_t i=0;i<size;++i) {
+			m_state ^= bytes[i];
+			m_state *= 0x100000001b3ULL;
+		}
+	}
+	// Strings are length-prefixed so that {"ab","c"} and {"a","bc"} differ.
+	void update(const std::string &str) {
+		uint64_t size = str.size();
+		update(&size, sizeof(size));
+		update(str.data(), str.size());
+	}
+	uint64_t digest() const {
+		return m_state;
+	}
+
+	fnv1a():m_state{0xcbf29ce484222325ULL}{;}
+};
+
+#endif
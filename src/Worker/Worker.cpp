@@ -0,0 +1,59 @@
+#include <Worker/Worker.hpp>
+#include <Trace/Trace.hpp>
+
+void Worker::run() {
+	trace_thread_name("worker");
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for(;;) {
+		m_cv.wait(lock, [this]{return m_stop || !m_tasks.empty();});
+		if(m_tasks.empty())
+			return;
+		std::function<void()> task = std::move(m_tasks.front());
+		m_tasks.pop_front();
+		++m_running;
+		lock.unlock();
+		{
+			TRACE_ZONE("task");
+			task();
+		}
+		lock.lock();
+		--m_running;
+	}
+}
+
+void Worker::push(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+	m_cv.notify_one();
+}
+
+size_t Worker::pending() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_tasks.size() + m_running;
+}
+
+unsigned Worker::threads() {
+	return m_threads.size();
+}
+
+Worker::Worker(unsigned threads):
+	m_running{0},
+	m_stop{false}
+{
+	if(threads == 0)
+		threads = 1;
+	for(unsigned i=0;i<threads;++i)
+		m_threads.emplace_back(&Worker::run, this);
+}
+
+Worker::~Worker() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+	for(auto &thread : m_threads)
+		thread.join();
+}
@@ -0,0 +1,38 @@
+#ifndef WORKER_HEADER
+#define WORKER_HEADER
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Background threads running queued tasks. Tasks are started in submission
+// order; with a single thread they also finish in that order. Pending tasks
+// are still run before the destructor returns.
+class Worker
+{
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::deque<std::function<void()>> m_tasks;
+	size_t m_running;
+	bool m_stop;
+	std::vector<std::thread> m_threads;
+
+	void run();
+public:
+	void push(std::function<void()> task);
+	// Queued plus running tasks.
+	size_t pending();
+	unsigned threads();
+
+	explicit Worker(unsigned threads = 1);
+	Worker(const Worker&) = delete;
+	Worker &operator=(const Worker&) = delete;
+	~Worker();
+};
+
+#endif
@@ -8,8 +8,35 @@
 #include "Logger/Logger.hpp"
 #include "Shader/Shader.hpp"
 #include "Program/Program.hpp"
+#include "ProgramCache/ProgramCache.hpp"
+#include "Pipeline/Pipeline.hpp"
+#include "FileWatcher/FileWatcher.hpp"
+#include "Asset/Asset.hpp"
+#include "Jobs/JobSystem.hpp"
+#include "Screenshot/Screenshot.hpp"
+#include "Capture/Capture.hpp"
+#include "Poster/Poster.hpp"
+#include "FrameExport/FrameExport.hpp"
+#include "FrameStats/FrameStats.hpp"
+#include "FramePacer/FramePacer.hpp"
+#include "GpuTimer/GpuTimer.hpp"
+#include "GpuTimer/PassCounter.hpp"
+#include "Trace/Trace.hpp"
+#include "Trace/GpuTrace.hpp"
+#include "GlDebug/GlDebug.hpp"
+#include "GlState/GlState.hpp"
+#include "GpuResource/Buffer.hpp"
+#include "GpuResource/Framebuffer.hpp"
+#include "GpuResource/GpuMemory.hpp"
+#include "GpuResource/Texture.hpp"
+#include "GpuResource/VertexArray.hpp"
+#include "Options/Options.hpp"
 #include "Util/Util.hpp"
 #include "Light/Light.hpp"
+#include "Camera/Camera.hpp"
+#include "Horizon/HorizonMaps.hpp"
+#include "Shadow/ShadowCascades.hpp"
+#include "TripleBuffer/TripleBuffer.hpp"
 #include <thread>
 #include <vector>
 #include <sstream>
@@ -21,6 +48,9 @@
 #include <array>
 #include <ctime>
 #include <random>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "ext/stb_image_write.h"
@@ -62,242 +92,604 @@ struct camera {
 	}
 };
 
-GLuint framebuffer_display_color_texture;
+// What the simulation on the main thread hands the render thread: the
+// camera, toggles and tuning values as of one tick. One-shot requests are
+// counters rather than flags, so none is lost when the render thread only
+// sees a later snapshot.
+struct FrameInput {
+	camera cam;
+	bool lighting = true;
+	bool draw_water = true;
+	bool draw_land = true;
+	bool wireframe = false;
+	bool depth_prepass = false;
+	bool show_overlay = false;
+	bool limit_fps = true;
+	float intensity = 0.91f;
+	float bias = 0.21f;
+	float scale = 0.27f;
+	float sample_radius = 0.20f;
+	int win_width = 0;
+	int win_height = 0;
+	struct Requests {
+		unsigned screenshot = 0;
+		unsigned poster = 0;
+		unsigned reload = 0;
+		unsigned capture = 0;
+		unsigned frame_export = 0;
+		unsigned refresh = 0;
+	} requests;
+	unsigned long long sequence = 0;
+};
+
+// Everything the terrain pass depends on, the same inputs draw the same
+// G-buffer.
+struct TerrainInputs {
+	glm::mat4 view;
+	bool lighting;
+	bool draw_water;
+	bool draw_land;
+	bool wireframe;
+	unsigned shader_generation;
+
+	bool operator==(const TerrainInputs &other) const {
+		return view == other.view && lighting == other.lighting &&
+			draw_water == other.draw_water && draw_land == other.draw_land &&
+			wireframe == other.wireframe && shader_generation == other.shader_generation;
+	}
+};
+
+// What lighting an unchanged G-buffer into the window depends on.
+struct PresentInputs {
+	float intensity;
+	float bias;
+	float scale;
+	float sample_radius;
+	int win_width;
+	int win_height;
+	bool show_overlay;
+	uint64_t horizon_generation;
+	uint64_t shadow_generation;
+
+	bool operator==(const PresentInputs &other) const {
+		return intensity == other.intensity && bias == other.bias &&
+			scale == other.scale && sample_radius == other.sample_radius &&
+			win_width == other.win_width && win_height == other.win_height &&
+			show_overlay == other.show_overlay && horizon_generation == other.horizon_generation &&
+			shadow_generation == other.shadow_generation;
+	}
+};
+
+Texture framebuffer_display_color_texture;
 
 constexpr float pi = 3.14159;
 
+// Debug builds (DEBUG=1) report GL problems through debug output from the
+// start, release builds with --gl-debug.
+#ifdef DEBUG_GL
+constexpr bool gl_debug_default = true;
+#else
+constexpr bool gl_debug_default = false;
+#endif
+
+// Declared first, the logger writes into it until it is destroyed.
+std::wofstream log_file;
 Logger<wchar_t> wlog{std::wcout};
 
-Shader *shader_render_vert;
-Shader *shader_render_tcs;
-Shader *shader_render_tes;
-Shader *shader_render_geom;
-Shader *shader_render_frag;
-Shader *shader_lighting_vert;
-Shader *shader_lighting_frag;
-Shader *shader_display_vert;
-Shader *shader_display_frag;
-Program *render_program;
-Program *lighting_program;
-Program *display_program;
+Pipeline *render_pipeline;
+Pipeline *depth_pipeline;
+Pipeline *shadow_pipeline;
+Pipeline *lighting_pipeline;
+Pipeline *display_pipeline;
+Pipeline *overlay_pipeline;
+Pipeline *horizon_heights_pipeline;
+Pipeline *horizon_pipeline;
 
 bool shaders_reloaded = false;
-bool limit_fps = true;
-bool lighting = true;
-bool draw_water = true;
-bool draw_land = true;
-
-bool load_shaders() {
-	shader_render_vert = new Shader;
-	shader_render_tcs = new Shader;
-	shader_render_tes = new Shader;
-	shader_render_geom = new Shader;
-	shader_render_frag = new Shader;
-	shader_lighting_vert = new Shader;
-	shader_lighting_frag = new Shader;
-	shader_display_vert = new Shader;
-	shader_display_frag = new Shader;
-	render_program = new Program;
-	lighting_program = new Program;
-	display_program = new Program;
-
+float target_fps = 60.f;
+// Paces with SwapBuffers instead of the frame pacer when non-zero.
+int swap_interval = 0;
+FramePacer *frame_pacer = nullptr;
+// Always light into the 4K lit frame and copy it to the window, as
+// screenshots, captures and exports need, instead of lighting straight
+// into the window.
+bool always_lit_frame = false;
+PassCounter *prepass_counter = nullptr;
+PassCounter *gbuffer_counter = nullptr;
+constexpr const_vec<float> clear_color(0.517f, 0.733f, 0.996f);
+
+AssetStore *assets = nullptr;
+ProgramCache *program_cache = nullptr;
+FileWatcher *shader_watcher = nullptr;
+JobSystem *jobs = nullptr;
+Screenshot *screenshot = nullptr;
+Capture *capture = nullptr;
+Capture::Format capture_format = Capture::Format::png;
+std::string capture_directory = "/tmp/infiniterrain_capture";
+int capture_fps = 60;
+std::string poster_path = "/tmp/poster.png";
+int poster_width = 4*render_size.x;
+int poster_height = 4*render_size.y;
+int poster_apron = 128;
+size_t poster_band_bytes = 64 << 20;
+FrameExport *frame_export = nullptr;
+std::string export_name = "/infiniterrain-frames";
+unsigned export_slots = 3;
+FrameStats *frame_stats = nullptr;
+GpuTimer *gpu_timer = nullptr;
+int bench_seconds = 0;
+std::string bench_out;
+std::string trace_path;
+GpuTrace *gpu_trace = nullptr;
+GlState *gl_state = nullptr;
+HorizonMaps *horizon_maps = nullptr;
+ShadowCascades *shadow_cascades = nullptr;
+// Frames whose inputs match the last drawn one are not drawn again; the
+// loop blocks on input for up to idle_wait_ms instead.
+bool idle_skip = true;
+int idle_wait_ms = 250;
+
+// Main thread state: the simulation's working copy of the frame input, and
+// whether anything in it changed since it was last published.
+FrameInput sim;
+bool sim_changed = false;
+int sim_hz = 120;
+// Snapshots from the simulation to the render thread. Publishing never
+// waits; an idle render thread sleeps on input_published until the next
+// one arrives.
+TripleBuffer<FrameInput> *frame_inputs = nullptr;
+std::mutex input_mutex;
+std::condition_variable input_published;
+std::atomic<bool> render_quit{false};
+// Sequence of the last snapshot the render thread presented.
+std::atomic<unsigned long long> inputs_drawn{0};
+// Non-zero while recording: the simulation then advances by exactly this
+// step once per presented frame instead of by the clock.
+std::atomic<float> lockstep_step{0.f};
+
+std::wstring widen(const std::string &str)
+{
+	return std::wstring{str.begin(), str.end()};
+}
 
-	wlog.log(L"Creating Shaders.\n");
+void log_gl_debug_message(const GlDebugMessage &message)
+{
+	std::wstring text = L"GL " + widen(gl_debug_describe(message));
+	if(text.empty() || text.back() != L'\n')
+		text += L'\n';
+	if(message.type == GL_DEBUG_TYPE_ERROR || message.severity == GL_DEBUG_SEVERITY_HIGH)
+		LOG_ERROR(wlog, text);
+	else
+		LOG_WARNING(wlog, text);
+}
 
-	wlog.log(L"Creating render vertex shader.\n");
-	shader_render_vert->load_file(GL_VERTEX_SHADER, "assets/shaders/render/shader.vert");
+// Averages of the last interval, nothing if the pass did not run.
+void log_pass(const std::wstring &name, PassCounter &counter)
+{
+	PassCounter::Interval interval = counter.next_interval();
+	if(!interval.frames)
+		return;
+	std::wstring str = name + L": " + std::to_wstring(interval.time_ms) + L"ms";
+	if(counter.counts_fragments())
+		str += L", " + std::to_wstring(static_cast<unsigned long long>(interval.fragments)) + L" fragment shader invocations";
+	wlog.log(str + L" per frame.\n");
+}
 
-	wlog.log(L"Creating render TCS shader.\n");
-	shader_render_tes->load_file(GL_TESS_CONTROL_SHADER, "assets/shaders/render/shader.tcs");
+std::vector<Pipeline*> pipelines() {
+	return {
+		render_pipeline, depth_pipeline, shadow_pipeline, lighting_pipeline, display_pipeline,
+		overlay_pipeline, horizon_heights_pipeline, horizon_pipeline
+	};
+}
 
-	wlog.log(L"Creating render geometry shader.\n");
-	shader_render_tcs->load_file(GL_TESS_EVALUATION_SHADER, "assets/shaders/render/shader.tes");
+// Advances in-flight rebuilds without blocking. Returns true if any program
+// was swapped, in which case uniform and attribute locations are stale.
+bool poll_shaders() {
+	TRACE_ZONE("poll_shaders");
+	bool swapped = false;
+	for(auto pipeline : pipelines()) {
+		switch(pipeline->poll()) {
+			case Pipeline::Status::swapped: {
+				swapped = true;
+				if(pipeline->from_cache())
+					wlog.log(
+						L"Loaded " + widen(pipeline->name()) + L" program from cache, saved " +
+						std::to_wstring(pipeline->saved_us()) + L"µs.\n"
+					);
+				else
+					wlog.log(
+						L"Built " + widen(pipeline->name()) + L" program in " +
+						std::to_wstring(pipeline->build_us()) + L"µs.\n"
+					);
+			} break;
+			case Pipeline::Status::failed: {
+				wlog.log(
+					L"Rebuilding " + widen(pipeline->name()) + L" program failed, keeping the old one:\n" +
+					widen(pipeline->log()) + L"\n"
+				);
+			} break;
+			default: break;
+		}
+	}
+	return swapped;
+}
 
-	wlog.log(L"Creating render geometry shader.\n");
-	shader_render_geom->load_file(GL_GEOMETRY_SHADER, "assets/shaders/render/shader.geom");
+bool load_shaders() {
+	TRACE_ZONE("load_shaders");
+	render_pipeline = new Pipeline("render", {
+		{GL_VERTEX_SHADER,          "assets/shaders/render/shader.vert"},
+		{GL_TESS_CONTROL_SHADER,    "assets/shaders/render/shader.tcs"},
+		{GL_TESS_EVALUATION_SHADER, "assets/shaders/render/shader.tes"},
+		{GL_GEOMETRY_SHADER,        "assets/shaders/render/shader.geom"},
+		{GL_FRAGMENT_SHADER,        "assets/shaders/render/shader.frag"},
+	}, {{0, "outColor"}, {1, "outNormal"}}, {}, *assets, program_cache);
+
+	// Terrain positions only, for the depth pre-pass.
+	depth_pipeline = new Pipeline("depth", {
+		{GL_VERTEX_SHADER,          "assets/shaders/render/shader.vert"},
+		{GL_TESS_CONTROL_SHADER,    "assets/shaders/render/shader.tcs"},
+		{GL_TESS_EVALUATION_SHADER, "assets/shaders/render/shader.tes"},
+		{GL_GEOMETRY_SHADER,        "assets/shaders/render/shader.geom"},
+	}, {}, {}, *assets, program_cache);
+
+	// The same with the sun's view, for the shadow cascades.
+	shadow_pipeline = new Pipeline("shadow", {
+		{GL_VERTEX_SHADER,          "assets/shaders/render/shader.vert"},
+		{GL_TESS_CONTROL_SHADER,    "assets/shaders/render/shader.tcs"},
+		{GL_TESS_EVALUATION_SHADER, "assets/shaders/render/shader.tes"},
+		{GL_GEOMETRY_SHADER,        "assets/shaders/render/shader.geom"},
+	}, {}, {"SHADOW"}, *assets, program_cache);
+
+	lighting_pipeline = new Pipeline("lighting", {
+		{GL_VERTEX_SHADER,   "assets/shaders/lighting/shader.vert"},
+		{GL_FRAGMENT_SHADER, "assets/shaders/lighting/shader.frag"},
+	}, {{0, "outCol"}}, {}, *assets, program_cache);
+
+	display_pipeline = new Pipeline("display", {
+		{GL_VERTEX_SHADER,   "assets/shaders/display/shader.vert"},
+		{GL_FRAGMENT_SHADER, "assets/shaders/display/shader.frag"},
+	}, {{0, "color"}}, {}, *assets, program_cache);
+
+	overlay_pipeline = new Pipeline("overlay", {
+		{GL_VERTEX_SHADER,   "assets/shaders/overlay/shader.vert"},
+		{GL_FRAGMENT_SHADER, "assets/shaders/overlay/shader.frag"},
+	}, {{0, "color"}}, {}, *assets, program_cache);
+
+	// The two passes building a horizon map region, see HorizonMaps.
+	horizon_heights_pipeline = new Pipeline("horizon heights", {
+		{GL_COMPUTE_SHADER, "assets/shaders/horizon/heights.comp"},
+	}, {}, {}, *assets, program_cache);
+
+	horizon_pipeline = new Pipeline("horizon", {
+		{GL_COMPUTE_SHADER, "assets/shaders/horizon/shader.comp"},
+	}, {}, {}, *assets, program_cache);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	assets->reset_stats();
+	wlog.log(L"Creating Shaders.\n");
 
-	wlog.log(L"Creating render fragment shader.\n");
-	shader_render_frag->load_file(GL_FRAGMENT_SHADER, "assets/shaders/render/shader.frag");
+	// Submit everything first so a parallel-compiling driver works on all
+	// programs at once, then wait for the whole set.
+	for(auto pipeline : pipelines())
+		pipeline->rebuild();
+
+	bool ok = true;
+	long long saved_us = 0;
+	for(auto pipeline : pipelines()) {
+		Pipeline::Status status;
+		while((status = pipeline->poll()) == Pipeline::Status::pending)
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		if(status == Pipeline::Status::failed) {
+			LOG_ERROR(wlog, L"Building " + widen(pipeline->name()) + L" program failed:\n" + widen(pipeline->log()) + L"\n");
+			ok = false;
+		}
+		else if(pipeline->from_cache()) {
+			wlog.log(L"Loaded " + widen(pipeline->name()) + L" program from cache.\n");
+			saved_us += pipeline->saved_us();
+		}
+	}
 
-	wlog.log(L"Creating and linking render shader program.\n");
+	wlog.log(
+		L"Shaders loaded in " + std::to_wstring(
+			std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::high_resolution_clock::now()-start
+			).count()
+		) + L"µs, program cache saved " + std::to_wstring(saved_us) + L"µs.\n"
+	);
+	wlog.log(
+		L"Shader I/O: " + std::to_wstring(assets->stats().files) + L" files, " +
+		std::to_wstring(assets->stats().bytes) + L" bytes mapped in " +
+		std::to_wstring(assets->stats().io_us) + L"µs.\n"
+	);
+	return ok;
+}
 
-	render_program->attach(*shader_render_vert);
-	render_program->attach(*shader_render_tcs);
-	render_program->attach(*shader_render_tes);
-	render_program->attach(*shader_render_geom);
-	render_program->attach(*shader_render_frag);
-	glBindFragDataLocation(*render_program, 0, "outColor");
-	glBindFragDataLocation(*render_program, 1, "outNormal");
-	render_program->link();
+bool destroy_shaders() {
+	delete render_pipeline;
+	delete depth_pipeline;
+	delete shadow_pipeline;
+	delete lighting_pipeline;
+	delete display_pipeline;
+	delete overlay_pipeline;
+	delete horizon_heights_pipeline;
+	delete horizon_pipeline;
+	return true;
+}
 
+bool reload_shaders() {
+	for(auto pipeline : pipelines())
+		pipeline->rebuild();
+	return true;
+}
 
-	wlog.log(L"Creating lighting vertex shader.\n");
-	shader_lighting_vert->load_file(GL_VERTEX_SHADER, "assets/shaders/lighting/shader.vert");
+void apply_swap_interval(bool limit_fps) {
+	glfwSwapInterval(limit_fps ? swap_interval : 0);
+}
 
-	wlog.log(L"Creating lighting fragment shader.\n");
-	shader_lighting_frag->load_file(GL_FRAGMENT_SHADER, "assets/shaders/lighting/shader.frag");
+void toggle_export() {
+	if(frame_export->active()) {
+		frame_export->stop();
+		wlog.log(
+			L"Frame export stopped after " + std::to_wstring(frame_export->stats().published) +
+			L" frames.\n"
+		);
+		return;
+	}
+	std::string error;
+	if(frame_export->open(export_name, export_slots, render_size.x, render_size.y, error))
+		wlog.log(L"Exporting frames to shared memory " + widen(export_name) + L"\n");
+	else
+		wlog.log(L"Could not start frame export: " + widen(error) + L"\n");
+}
 
+void toggle_capture() {
+	if(capture->recording()) {
+		capture->stop();
+		wlog.log(
+			L"Capture stopped after " + std::to_wstring(capture->stats().captured) +
+			L" frames, finishing encodes in the background.\n"
+		);
+		return;
+	}
+	std::string error;
+	if(capture->start(capture_directory, capture_format, capture_fps, render_size.x, render_size.y, error))
+		wlog.log(L"Capturing frames to " + widen(capture_directory) + L"\n");
+	else
+		wlog.log(L"Could not start capture: " + widen(error) + L"\n");
+}
 
-	wlog.log(L"Creating and linking lighting shader program.\n");
+// Keys sampled every simulation tick rather than acted on once.
+constexpr int sim_keys[] = {
+	GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_Q, GLFW_KEY_E,
+	GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_RIGHT, GLFW_KEY_LEFT, GLFW_KEY_SPACE, GLFW_KEY_RIGHT_CONTROL,
+	GLFW_KEY_G, GLFW_KEY_V, GLFW_KEY_H, GLFW_KEY_B, GLFW_KEY_J, GLFW_KEY_N, GLFW_KEY_K, GLFW_KEY_M,
+};
 
-	
-	lighting_program->attach(*shader_lighting_vert);
-	lighting_program->attach(*shader_lighting_frag);
-	glBindFragDataLocation(*lighting_program, 0, "outCol");
-	lighting_program->link();
+bool sim_keys_held(GLFWwindow *win)
+{
+	for(int key : sim_keys)
+		if(glfwGetKey(win, key))
+			return true;
+	return false;
+}
 
+// One fixed step of dt seconds of camera movement and tuning.
+void simulate(GLFWwindow *win, float dt)
+{
+	camera &cam = sim.cam;
+	float mult = 1.0f;
 
-	wlog.log(L"Creating display vertex shader.\n");
-	
-	shader_display_vert->load_file(GL_VERTEX_SHADER, "assets/shaders/display/shader.vert");
+	if(glfwGetKey(win, GLFW_KEY_LEFT_SHIFT)) {
+		mult = 0.3f;
+	}
 
-	wlog.log(L"Creating display fragment shader.\n");
-	
-	shader_display_frag->load_file(GL_FRAGMENT_SHADER, "assets/shaders/display/shader.frag");
+	if(glfwGetKey(win, GLFW_KEY_W)) {
+		cam.rotate({-1.f, 0.f, 0.f}, dt*3.f);
+	}
+	if(glfwGetKey(win, GLFW_KEY_S)) {
+		cam.rotate({ 1.f, 0.f, 0.f}, dt*3.f);
+	}
+	if(glfwGetKey(win, GLFW_KEY_A)) {
+		cam.rotate({ 0.f,-1.f, 0.f}, dt*3.f);
+	}
+	if(glfwGetKey(win, GLFW_KEY_D)) {
+		cam.rotate({ 0.f, 1.f, 0.f}, dt*3.f);
+	}
+	if(glfwGetKey(win, GLFW_KEY_Q)) {
+		cam.rotate({ 0.f, 0.f,-1.f}, dt*3.f);
+	}
+	if(glfwGetKey(win, GLFW_KEY_E)) {
+		cam.rotate({ 0.f, 0.f, 1.f}, dt*3.f);
+	}
+	if(glfwGetKey(win, GLFW_KEY_UP)) {
+		cam.advance(mult*dt*100.f);
+	}
+	if(glfwGetKey(win, GLFW_KEY_DOWN)) {
+		cam.advance(mult*dt*-100.f);
+	}
+	if(glfwGetKey(win, GLFW_KEY_RIGHT)) {
+		cam.strafe(mult*dt*100.f);
+	}
+	if(glfwGetKey(win, GLFW_KEY_LEFT)) {
+		cam.strafe(mult*dt*-100.f);
+	}
+	if(glfwGetKey(win, GLFW_KEY_SPACE)) {
+		cam.climb(mult*dt*100.f);
+	}
+	if(glfwGetKey(win, GLFW_KEY_RIGHT_CONTROL)) {
+		cam.climb(mult*dt*-100.f);
+	}
 
-	wlog.log(L"Creating and linking display shader program.\n");
+	// 0.6 per second, what 0.01 a frame used to be at 60 FPS.
+	float tune = dt*0.6f;
+	if(glfwGetKey(win, GLFW_KEY_G)) {
+		sim.intensity += tune;
+	}
+	if(glfwGetKey(win, GLFW_KEY_V)) {
+		sim.intensity -= tune;
+	}
+	if(glfwGetKey(win, GLFW_KEY_H)) {
+		sim.bias += tune;
+	}
+	if(glfwGetKey(win, GLFW_KEY_B)) {
+		sim.bias -= tune;
+	}
+	if(glfwGetKey(win, GLFW_KEY_J)) {
+		sim.sample_radius += tune;
+	}
+	if(glfwGetKey(win, GLFW_KEY_N)) {
+		sim.sample_radius -= tune;
+	}
+	if(glfwGetKey(win, GLFW_KEY_K)) {
+		sim.scale += tune;
+	}
+	if(glfwGetKey(win, GLFW_KEY_M)) {
+		sim.scale -= tune;
+	}
 
-	
-	display_program->attach(*shader_display_vert);
-	display_program->attach(*shader_display_frag);
-	glBindFragDataLocation(*display_program, 0, "color");
-	display_program->link();
-	return true;
+	if(bench_seconds)
+		cam.advance(dt*50.f);
 }
 
-bool destroy_shaders() {
-	delete shader_render_frag;
-	delete shader_render_tcs;
-	delete shader_render_tes;
-	delete shader_render_geom;
-	delete shader_render_vert;
-	delete shader_lighting_frag;
-	delete shader_lighting_vert;
-	delete shader_display_frag;
-	delete shader_display_vert;
-	delete render_program;
-	delete lighting_program;
-	delete display_program;
-	return true;
+void publish_input()
+{
+	++sim.sequence;
+	frame_inputs->back() = sim;
+	frame_inputs->publish();
+	sim_changed = false;
+	// Taking the lock orders this against an idle render thread's check.
+	{
+		std::lock_guard<std::mutex> lock(input_mutex);
+	}
+	input_published.notify_one();
 }
 
-bool reload_shaders() {
-	destroy_shaders();
-	load_shaders();
-	return true;
+// Render thread. Returns once a snapshot is waiting, on quit, or after
+// timeout.
+void wait_for_input(std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(input_mutex);
+	input_published.wait_for(lock, timeout, []{
+		return frame_inputs->fresh() || render_quit.load();
+	});
 }
 
-bool readfile(const char* filename, std::string &contents);
 bool process_gl_errors();
 
-int main()
+// Owns the GL context: sets up every GL resource, then draws whatever
+// the simulation last published until render_quit.
+int render_main(GLFWwindow *win, const Options &options, const std::vector<double> &hitch_ms, bool gl_debug)
 {
 	using namespace std::literals::chrono_literals;
 
-	wlog.log(L"Starting up.\n");
-	wlog.log(L"Initializing GLFW.\n");
-
-	if(!glfwInit())
-		return -1;
-
-	glfwSetErrorCallback(
-		[](int, const char* msg){
-			wlog.log(std::wstring{msg, msg+std::strlen(msg)}+L"\n");
-		}
-	);
-
-	// Create window with context params etc.
-	wlog.log(L"Creating window.\n");
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
-	glfwWindowHint(GLFW_DEPTH_BITS, 32);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-	glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-	GLFWwindow *win = glfwCreateWindow(
-		init_win_size.x, init_win_size.y, "infiniterrain", nullptr, nullptr
-	);
-
-	// If window creation fails, exit.
-	if(!win)
-		return -2;
-
-	int win_size[2];
-	int &win_size_x=win_size[0], &win_size_y=win_size[1];
-	glfwGetWindowSize(win, &win_size_x, &win_size_y);
+	trace_thread_name("render");
+	TRACE_NAMED_ZONE(startup_zone, "render startup");
+	bool gl_debug_sync = options.get("gl-debug", "sync") != "async";
+	FrameInput input = frame_inputs->front();
 
 	glfwMakeContextCurrent(win);
 
 	wlog.log(L"Initializing GLEW.\n");
+	TRACE_NAMED_ZONE(glew_zone, "glewInit");
 	glewExperimental = GL_TRUE;
 	if(glewInit())
 		return -3;
+	glew_zone.end();
 
 	process_gl_errors();
 
+	if(gl_debug) {
+		if(gl_debug_enable(gl_debug_sync, options.has("gl-debug-verbose")))
+			wlog.log(gl_debug_sync ? L"GL debug output enabled.\n" : L"GL debug output enabled, asynchronous.\n");
+		else
+			LOG_WARNING(wlog, L"GL debug output unavailable, polling glGetError once a second.\n");
+	}
+
 	wlog.log(
 		L"Any errors produced directly after GLEW initialization "
 		L"should be ignorable.\n"
 	);
 
 	wlog.log("Generating Vertex Array Object.\n");
-	GLuint vao;
-	glGenVertexArrays(1, &vao);
+	VertexArray vao;
 	glBindVertexArray(vao);
 
-	load_shaders();
-
-	process_gl_errors();
+	program_cache = new ProgramCache(default_cache_directory());
+	if(program_cache->enabled())
+		wlog.log(L"Program binary cache: " + widen(program_cache->directory()) + L"\n");
+	else
+		wlog.log(L"Program binary cache unavailable, compiling from source.\n");
 
-	glUseProgram(*render_program);
+	if(enable_parallel_shader_compile())
+		wlog.log(L"Using parallel shader compilation.\n");
 
-	glViewport(0.f, 0.f, win_size_x, win_size_y);
+	assets = new AssetStore;
+	if(assets->open_pack("assets.pak"))
+		wlog.log(L"Using asset pack assets.pak, loose files take precedence.\n");
 
+	load_shaders();
 
-	wlog.log(L"Creating and getting camera position uniform data.\n");
+	shader_watcher = new FileWatcher;
+	for(auto pipeline : pipelines())
+		for(auto &file : pipeline->files())
+			shader_watcher->watch(file);
+	if(shader_watcher->enabled())
+		wlog.log(L"Watching shader files for changes.\n");
 
-	camera cam;
+	process_gl_errors();
 
-	cam.position = glm::vec3(0.f, 69.f, -20.f);
-	cam.rotate(glm::vec3(1.f, 0.f, 0.f), -pi/3.f);
+	glUseProgram(render_pipeline->program());
 
-	process_gl_errors();
+	glViewport(0.f, 0.f, input.win_width, input.win_height);
 
 	wlog.log(L"Creating and getting view uniform data.\n");
-	glm::mat4 view = cam.get_view();
-
-	GLint camera_position_uni = glGetUniformLocation(*render_program, "camera_position");
-	glUniform3fv(camera_position_uni, 1, glm::value_ptr(cam.position));
+	glm::mat4 view = input.cam.get_view();
 
-	GLint draw_water_uni = glGetUniformLocation(*render_program, "draw_water");
+	GLint draw_water_uni = glGetUniformLocation(render_pipeline->program(), "draw_water");
 	glUniform1i(draw_water_uni, 0);
-
-	GLint view_uni = glGetUniformLocation(*render_program, "view");
-	glUniformMatrix4fv(view_uni, 1, GL_FALSE, glm::value_ptr(view));
+	// The pre-pass only draws land.
+	GLint depth_draw_water_uni = glGetUniformLocation(depth_pipeline->program(), "draw_water");
+	glProgramUniform1i(depth_pipeline->program(), depth_draw_water_uni, 0);
+	GLint shadow_view_projection_uni = glGetUniformLocation(shadow_pipeline->program(), "shadow_view_projection");
 
 	process_gl_errors();
 
 
 	wlog.log(L"Creating and getting projection uniform data.\n");
-	glm::mat4 projection = glm::perspective(
+	// Reverse-Z into a float depth buffer.
+	glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+	glClearDepth(0.0);
+	glm::mat4 projection = reverse_z_perspective(
+		pi/3.f, render_size.x/render_size.y, 0.01f, 3000.0f
+	);
+	glm::mat4 frame_projection = glm::perspective(
 		pi/3.f, render_size.x/render_size.y, 0.01f, 3000.0f
 	);
-	GLint projection_uni = glGetUniformLocation(*render_program, "projection");
-	glUniformMatrix4fv(projection_uni, 1, GL_FALSE, glm::value_ptr(projection));
 
-	GLint render_spritesheet_uni = glGetUniformLocation(*render_program, "spritesheet");
+	CameraBlock camera_block;
+	camera_block.view = view;
+	camera_block.projection = projection;
+	camera_block.frame_projection = frame_projection;
+	camera_block.camera_position = glm::vec4(input.cam.position, 1.f);
+	Buffer camera_buffer("uniforms", sizeof(camera_block), &camera_block, GL_DYNAMIC_STORAGE_BIT);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 1, camera_buffer);
+	camera_buffer.label("camera");
+
+	GLint render_spritesheet_uni = glGetUniformLocation(render_pipeline->program(), "spritesheet");
 
 	process_gl_errors();
 
-	glUseProgram(*lighting_program);
+	glUseProgram(lighting_pipeline->program());
 
-	GLint light_color_uni = glGetUniformLocation(*lighting_program, "colorTex");
-	GLint light_normals_uni = glGetUniformLocation(*lighting_program, "normalsTex");
-	GLint light_depth_uni = glGetUniformLocation(*lighting_program, "depthTex");
-	GLint light_proj_uni = glGetUniformLocation(*lighting_program, "projection");
-	glUniformMatrix4fv(light_proj_uni, 1, GL_FALSE, glm::value_ptr(projection));
-	GLint light_view_uni = glGetUniformLocation(*lighting_program, "view");
-	glUniformMatrix4fv(light_view_uni, 1, GL_FALSE, glm::value_ptr(view));
+	GLint light_color_uni = glGetUniformLocation(lighting_pipeline->program(), "colorTex");
+	GLint light_normals_uni = glGetUniformLocation(lighting_pipeline->program(), "normalsTex");
+	GLint light_depth_uni = glGetUniformLocation(lighting_pipeline->program(), "depthTex");
+	GLint light_image_rect_uni = glGetUniformLocation(lighting_pipeline->program(), "image_rect");
+	GLint light_viewport_scale_uni = glGetUniformLocation(lighting_pipeline->program(), "viewport_scale");
+	GLint light_max_offset_uni = glGetUniformLocation(lighting_pipeline->program(), "max_sample_offset");
+	GLint light_resolve_uni = glGetUniformLocation(lighting_pipeline->program(), "resolve");
+	GLint light_background_uni = glGetUniformLocation(lighting_pipeline->program(), "background");
+	glUniform3f(light_background_uni, clear_color.x, clear_color.y, clear_color.z);
 
 	LightArray lights;
 	lights.light_count = 1;
@@ -306,17 +698,24 @@ int main()
 	lights.lights[0].fade = 30.f;
 	lights.lights[0].position = glm::vec4(8.f, 8.f, 70.f, 1.f);
 	lights.lights[0].color = glm::vec4(1.f, 0.9f, 1.f, 1.f);
-	GLuint light_buffer;
-	glGenBuffers(1, &light_buffer);
-	glBindBuffer(GL_UNIFORM_BUFFER, light_buffer);
-	glBufferData(GL_UNIFORM_BUFFER, sizeof(lights), &lights, GL_STREAM_COPY);
+	Buffer light_buffer("uniforms", sizeof(lights), &lights, GL_DYNAMIC_STORAGE_BIT);
 	glBindBufferBase(GL_UNIFORM_BUFFER, 0, light_buffer);
+	light_buffer.label("lights");
+
 
+	GLint light_intensity_uni = glGetUniformLocation(lighting_pipeline->program(), "intensity");
+	GLint light_bias_uni = glGetUniformLocation(lighting_pipeline->program(), "bias");
+	GLint light_rad_uni = glGetUniformLocation(lighting_pipeline->program(), "sample_radius");
+	GLint light_scale_uni = glGetUniformLocation(lighting_pipeline->program(), "scale");
 
-	GLint light_intensity_uni = glGetUniformLocation(*lighting_program, "intensity");
-	GLint light_bias_uni = glGetUniformLocation(*lighting_program, "bias");
-	GLint light_rad_uni = glGetUniformLocation(*lighting_program, "sample_radius");
-	GLint light_scale_uni = glGetUniformLocation(*lighting_program, "scale");
+	// Degrees, the azimuth from the terrain's x axis towards y.
+	float sun_azimuth = glm::radians(options.get("sun-azimuth", 135.f));
+	float sun_elevation = glm::radians(glm::clamp(options.get("sun-elevation", 20.f), -90.f, 90.f));
+	glm::vec3 sun_direction(
+		std::cos(sun_elevation)*std::cos(sun_azimuth), std::cos(sun_elevation)*std::sin(sun_azimuth), std::sin(sun_elevation)
+	);
+	GLint light_sun_direction_uni = glGetUniformLocation(lighting_pipeline->program(), "sun_direction");
+	glProgramUniform3fv(lighting_pipeline->program(), light_sun_direction_uni, 1, glm::value_ptr(sun_direction));
 
 	process_gl_errors();
 
@@ -328,61 +727,61 @@ int main()
 
 	glEnable(GL_FRAMEBUFFER_SRGB);
 
-	GLuint framebuffer_render;
-	glGenFramebuffers(1, &framebuffer_render);
-	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_render);
-
-	GLuint framebuffer_render_color_texture;
-	glGenTextures(1, &framebuffer_render_color_texture);
-	glActiveTexture(GL_TEXTURE0+4);
-	glProgramUniform1i(*lighting_program, light_color_uni, 4);
-	glBindTexture(GL_TEXTURE_2D, framebuffer_render_color_texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, render_size.x, render_size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-	glEnablei(GL_BLEND, framebuffer_render_color_texture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, framebuffer_render_color_texture, 0);
-
-	GLuint framebuffer_render_normals_texture;
-	glGenTextures(1, &framebuffer_render_normals_texture);
-	glActiveTexture(GL_TEXTURE0+5);
-	glProgramUniform1i(*lighting_program, light_normals_uni, 5);
-	glBindTexture(GL_TEXTURE_2D, framebuffer_render_normals_texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, render_size.x, render_size.y, 0, GL_RG, GL_UNSIGNED_BYTE, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, framebuffer_render_normals_texture, 0);
-	
-	GLuint framebuffer_render_depth_texture;
-	glGenTextures(1, &framebuffer_render_depth_texture);
-	glActiveTexture(GL_TEXTURE0+6);
-	glProgramUniform1i(*lighting_program, light_depth_uni, 6);
-	glBindTexture(GL_TEXTURE_2D, framebuffer_render_depth_texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, render_size.x, render_size.y, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, framebuffer_render_depth_texture, 0);
-
-	GLenum drawbuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_DEPTH_ATTACHMENT};
-	glDrawBuffers(2, drawbuffers);
-
-	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-		wlog.log("Incomplete framebuffer!\n");
-
-	GLuint framebuffer_display;
-	glGenFramebuffers(1, &framebuffer_display);
-	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_display);
-
-	GLint framebuffer_uni = glGetUniformLocation(*display_program, "framebuffer");
-
-	glGenTextures(1, &framebuffer_display_color_texture);
-	glActiveTexture(GL_TEXTURE0+7);
-	glProgramUniform1i(*display_program, framebuffer_uni, 7);
-	glBindTexture(GL_TEXTURE_2D, framebuffer_display_color_texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB_ALPHA, render_size.x, render_size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, framebuffer_display_color_texture, 0);
+	TRACE_NAMED_ZONE(framebuffers_zone, "framebuffers");
+	Framebuffer framebuffer_render;
+
+	Texture framebuffer_render_color_texture("G-buffer", GL_SRGB8_ALPHA8, render_size.x, render_size.y);
+	framebuffer_render_color_texture.parameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	framebuffer_render_color_texture.parameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	framebuffer_render_color_texture.bind(4);
+	glProgramUniform1i(lighting_pipeline->program(), light_color_uni, 4);
+	framebuffer_render.attach(GL_COLOR_ATTACHMENT0, framebuffer_render_color_texture);
+
+	// Packed normal and material bits, see lib/gbuffer.glsl. Integer
+	// textures are never filtered.
+	Texture framebuffer_render_normals_texture("G-buffer", GL_R16UI, render_size.x, render_size.y);
+	framebuffer_render_normals_texture.parameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	framebuffer_render_normals_texture.parameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	framebuffer_render_normals_texture.bind(5);
+	glProgramUniform1i(lighting_pipeline->program(), light_normals_uni, 5);
+	framebuffer_render.attach(GL_COLOR_ATTACHMENT1, framebuffer_render_normals_texture);
+
+	Texture framebuffer_render_depth_texture("G-buffer", GL_DEPTH_COMPONENT32F, render_size.x, render_size.y);
+	framebuffer_render_depth_texture.parameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	framebuffer_render_depth_texture.parameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	framebuffer_render_depth_texture.bind(6);
+	glProgramUniform1i(lighting_pipeline->program(), light_depth_uni, 6);
+	framebuffer_render.attach(GL_DEPTH_ATTACHMENT, framebuffer_render_depth_texture);
+
+	framebuffer_render.draw_buffers({GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1});
+
+	framebuffer_render.label("G-buffer");
+	framebuffer_render_color_texture.label("G-buffer color");
+	framebuffer_render_normals_texture.label("G-buffer normals");
+	framebuffer_render_depth_texture.label("G-buffer depth");
+
+	if(!framebuffer_render.complete())
+		LOG_ERROR(wlog, "Incomplete framebuffer!\n");
+
+	wlog.log(
+		L"G-buffer: " + std::to_wstring(
+			(framebuffer_render_color_texture.bytes() + framebuffer_render_normals_texture.bytes() +
+			framebuffer_render_depth_texture.bytes()) / (framebuffer_render_color_texture.width()*framebuffer_render_color_texture.height())
+		) + L" bytes per pixel.\n"
+	);
+
+	Framebuffer framebuffer_display;
+
+	GLint framebuffer_uni = glGetUniformLocation(display_pipeline->program(), "framebuffer");
+
+	framebuffer_display_color_texture = Texture("frame", GL_SRGB8_ALPHA8, render_size.x, render_size.y);
+	framebuffer_display_color_texture.parameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	framebuffer_display_color_texture.parameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	framebuffer_display_color_texture.bind(7);
+	glProgramUniform1i(display_pipeline->program(), framebuffer_uni, 7);
+	framebuffer_display.attach(GL_COLOR_ATTACHMENT0, framebuffer_display_color_texture);
+	framebuffer_display.label("lit frame");
+	framebuffer_display_color_texture.label("lit frame color");
 
 	float fb_vertices[] = {
 		// Coords  Texcoords
@@ -393,164 +792,412 @@ int main()
 		 1.f, -1.f,   1.f, 0.f,
 		-1.f,  1.f,   0.f, 1.f,
 	};
-	GLuint fb_vbo, fb_vao;
-	glGenVertexArrays(1, &fb_vao);
-	glBindVertexArray(fb_vao);
-	glGenBuffers(1, &fb_vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, fb_vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(fb_vertices), fb_vertices, GL_STATIC_DRAW);
-
-	GLint fb_vao_pos_attrib = glGetAttribLocation(*display_program, "pos");
-	if(fb_vao_pos_attrib != -1) {
-		glEnableVertexAttribArray(fb_vao_pos_attrib);
-		glVertexAttribPointer(fb_vao_pos_attrib, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), 0);
-	}
-
-	GLint fb_vao_texcoord_attrib = glGetAttribLocation(*display_program, "texcoords");
-	if(fb_vao_texcoord_attrib != -1) {
-		glEnableVertexAttribArray(fb_vao_texcoord_attrib);
-		glVertexAttribPointer(fb_vao_texcoord_attrib, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), BUFFER_OFFSET(sizeof(float)*2));
-	}
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	glUseProgram(*render_program);
-
+	Buffer fb_vbo("geometry", sizeof(fb_vertices), fb_vertices, 0);
+	VertexArray fb_vao;
+	fb_vao.vertex_buffer(0, fb_vbo, 0, 4*sizeof(float));
+
+	GLint fb_vao_pos_attrib = glGetAttribLocation(display_pipeline->program(), "pos");
+	if(fb_vao_pos_attrib != -1)
+		fb_vao.attribute(fb_vao_pos_attrib, 0, 2, GL_FLOAT, 0);
+
+	GLint fb_vao_texcoord_attrib = glGetAttribLocation(display_pipeline->program(), "texcoords");
+	if(fb_vao_texcoord_attrib != -1)
+		fb_vao.attribute(fb_vao_texcoord_attrib, 0, 2, GL_FLOAT, 2*sizeof(float));
+
+	fb_vbo.label("fullscreen quad");
+	fb_vao.label("fullscreen quad");
+
+	framebuffers_zone.end();
+
+	// Recent frame times for the overlay, one row per FrameStats series.
+	Texture overlay_texture("overlay", GL_R32F, FrameStats::recent_count, FrameStats::series_count);
+	overlay_texture.parameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	overlay_texture.parameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	overlay_texture.bind(8);
+	overlay_texture.label("frame time overlay");
+
+	GLint overlay_samples_uni = glGetUniformLocation(overlay_pipeline->program(), "samples");
+	GLint overlay_hitch_uni = glGetUniformLocation(overlay_pipeline->program(), "hitch_ms");
+	GLint overlay_percentiles_uni = glGetUniformLocation(overlay_pipeline->program(), "percentiles_ms");
+	glm::vec4 overlay_hitch_ms(0.f);
+	for(size_t i=0;i<std::min<size_t>(4, hitch_ms.size());++i)
+		overlay_hitch_ms[i] = hitch_ms[i];
+	glProgramUniform1i(overlay_pipeline->program(), overlay_samples_uni, 8);
+	glProgramUniform4fv(overlay_pipeline->program(), overlay_hitch_uni, 1, glm::value_ptr(overlay_hitch_ms));
+
+	gpu_timer = new GpuTimer;
+	prepass_counter = new PassCounter;
+	gbuffer_counter = new PassCounter;
+	gpu_trace = new GpuTrace;
+	gl_state = new GlState;
+	std::vector<uint64_t> gpu_times;
+
+	HorizonMaps::Settings horizon_settings;
+	horizon_settings.view_distance = 3000.f;
+	horizon_settings.budget = options.get("horizon-budget", horizon_settings.budget);
+	horizon_maps = new HorizonMaps(horizon_settings);
+	unsigned long long horizons_logged = 0;
+
+	ShadowCascades::Settings shadow_settings;
+	shadow_settings.resolution = options.get("shadow-size", shadow_settings.resolution);
+	shadow_settings.max_distance = options.get("shadow-distance", shadow_settings.max_distance);
+	shadow_settings.frame_budget = std::max(1, options.get("shadow-budget", static_cast<int>(shadow_settings.frame_budget)));
+	shadow_cascades = new ShadowCascades(shadow_settings);
+	ShadowCascades::Stats shadows_logged = shadow_cascades->stats();
+
+	// One core is left to the render thread. hardware_concurrency() may
+	// not know and return 0.
+	unsigned cores = std::thread::hardware_concurrency();
+	int job_threads = cores > 1 ? cores-1 : 1;
+	job_threads = options.get("job-threads", options.get("capture-threads", job_threads));
+	jobs = new JobSystem(static_cast<unsigned>(std::max(1, job_threads)));
+	screenshot = new Screenshot(*jobs);
+	capture = new Capture(*jobs, options.get("capture-ring", 4));
+	frame_export = new FrameExport;
+
+	if(options.has("export"))
+		toggle_export();
+
+	glUseProgram(render_pipeline->program());
+
+	TRACE_NAMED_ZONE(map_zone, "map");
 	glm::vec2 map_size(200.f, 200.f);
 
 	float multiplier = 10.f;
 
 	std::vector<glm::vec2> map(int(map_size.x * map_size.y * 3 * 2));
 
-	for(int x = 0; x < map_size.x; ++x) {
-		for(int y = 0; y < map_size.y; ++y) {
-			map[(x*map_size.y + y)*3*2 + 0] = (glm::vec2(  x, y  ) - map_size*0.5f) * multiplier;
-			map[(x*map_size.y + y)*3*2 + 1] = (glm::vec2(x+1, y  ) - map_size*0.5f) * multiplier;
-			map[(x*map_size.y + y)*3*2 + 2] = (glm::vec2(x  , y+1) - map_size*0.5f) * multiplier;
-			map[(x*map_size.y + y)*3*2 + 3] = (glm::vec2(x  , y+1) - map_size*0.5f) * multiplier;
-			map[(x*map_size.y + y)*3*2 + 4] = (glm::vec2(x+1, y  ) - map_size*0.5f) * multiplier;
-			map[(x*map_size.y + y)*3*2 + 5] = (glm::vec2(x+1, y+1) - map_size*0.5f) * multiplier;
+	jobs->parallel_for(0, static_cast<size_t>(map_size.x), 16, [&](size_t first, size_t last) {
+		for(int x = first; x < static_cast<int>(last); ++x) {
+			for(int y = 0; y < map_size.y; ++y) {
+				map[(x*map_size.y + y)*3*2 + 0] = (glm::vec2(  x, y  ) - map_size*0.5f) * multiplier;
+				map[(x*map_size.y + y)*3*2 + 1] = (glm::vec2(x+1, y  ) - map_size*0.5f) * multiplier;
+				map[(x*map_size.y + y)*3*2 + 2] = (glm::vec2(x  , y+1) - map_size*0.5f) * multiplier;
+				map[(x*map_size.y + y)*3*2 + 3] = (glm::vec2(x  , y+1) - map_size*0.5f) * multiplier;
+				map[(x*map_size.y + y)*3*2 + 4] = (glm::vec2(x+1, y  ) - map_size*0.5f) * multiplier;
+				map[(x*map_size.y + y)*3*2 + 5] = (glm::vec2(x+1, y+1) - map_size*0.5f) * multiplier;
+			}
 		}
-	}
+	});
 
 	glPatchParameteri(GL_PATCH_VERTICES, 3);
 
-	glUseProgram(*render_program);
-
-	GLuint map_vbo;
-	glGenBuffers(1, &map_vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, map_vbo);
-	glBufferData(GL_ARRAY_BUFFER, map.size() * sizeof(glm::vec2), map.data(), GL_STATIC_DRAW);
-
-	GLuint map_vao;
-	glGenVertexArrays(1, &map_vao);
-	glBindVertexArray(map_vao);
-	glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, 2*sizeof(float), BUFFER_OFFSET(0));
-	glEnableVertexAttribArray(4);
+	glUseProgram(render_pipeline->program());
 
-	glfwSetKeyCallback(win, [](GLFWwindow*, int key, int, int action, int){
-		switch(action) {
-			case GLFW_PRESS: {
-				switch(key) {
+	Buffer map_vbo("geometry", map.size() * sizeof(glm::vec2), map.data(), 0);
+	VertexArray map_vao;
+	map_vao.vertex_buffer(0, map_vbo, 0, sizeof(glm::vec2));
+	map_vao.attribute(4, 0, 2, GL_FLOAT, 0);
+	map_vbo.label("terrain grid");
+	map_vao.label("terrain grid");
+	map_zone.end();
 
-				}
-			} break;
-			case GLFW_RELEASE: {
-				switch(key) {
-					case GLFW_KEY_F: {
-						static bool wireframe=false;
-						wireframe = !wireframe;
-						if(wireframe)
-							glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-						else
-							glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-					} break;
-					case GLFW_KEY_U: {
-						uint8_t *pixels = new uint8_t[static_cast<int>(render_size.x)*static_cast<int>(render_size.y)*4];
-						glBindTexture(GL_TEXTURE_2D, framebuffer_display_color_texture);
-						glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-						uint8_t *topbottom_pixels = new uint8_t[static_cast<int>(render_size.x)*static_cast<int>(render_size.y)*4];
-						for(int y = 0; y < render_size.y; ++y) {
-							for(int x = 0; x < render_size.x; ++x) {
-								int ny = (render_size.y-1) - y;
-								topbottom_pixels[(x+y*int(render_size.x))*4+0] = pixels[(x+ny*int(render_size.x))*4+0];
-								topbottom_pixels[(x+y*int(render_size.x))*4+1] = pixels[(x+ny*int(render_size.x))*4+1];
-								topbottom_pixels[(x+y*int(render_size.x))*4+2] = pixels[(x+ny*int(render_size.x))*4+2];
-								topbottom_pixels[(x+y*int(render_size.x))*4+3] = pixels[(x+ny*int(render_size.x))*4+3];
-							}
-						}
-						if(!stbi_write_png("/tmp/screenshot.png", render_size.x, render_size.y, 4, topbottom_pixels, 0)) {
-							wlog.log(L"ERROR SAVING SCREENSHOT!\n");
-						}
-						else {
-							wlog.log(L"Screenshot saved to /tmp/screenshot.png \n");
-						}
-						delete[] pixels;
-					} break;
-					case GLFW_KEY_R: {
-						//Reload shaders
-						reload_shaders();
-						shaders_reloaded = true;
-					} break;
-					case GLFW_KEY_P: {
-						limit_fps = !limit_fps;
-					} break;
-					case GLFW_KEY_L: {
-						lighting = !lighting;
-					} break;
-					case GLFW_KEY_O: {
-						draw_water = !draw_water;
-					} break;
-					case GLFW_KEY_I: {
-						draw_land = !draw_land;
-					} break;
-				}
-			} break;
-		}
-	});
+	wlog.log(L"GPU memory:\n" + widen(gpu_memory_describe()));
 
-	std::chrono::high_resolution_clock::time_point start, end, timetoprint;
-	timetoprint = end = start = std::chrono::high_resolution_clock::now();
+	std::chrono::high_resolution_clock::time_point start, end, timetoprint, presented;
+	timetoprint = end = start = presented = std::chrono::high_resolution_clock::now();
+	auto bench_end = start + std::chrono::seconds(bench_seconds);
+	bool limit_fps = input.limit_fps;
+	apply_swap_interval(limit_fps);
 
 	long long cnt=0;
 	long double ft_total=0.f;
 
-	glClearColor(0.517f, 0.733f, 0.996f, 1.f);
+	glClearColor(clear_color.x, clear_color.y, clear_color.z, 1.f);
 
-	float intensity = 0.91;
-	float bias = 0.21;
-	float scale = 0.27;
-	float sample_radius = 0.20;
+	// Tuning values last set on the lighting program.
+	float intensity = input.intensity;
+	float bias = input.bias;
+	float scale = input.scale;
+	float sample_radius = input.sample_radius;
+	glProgramUniform1f(lighting_pipeline->program(), light_intensity_uni, intensity);
+	glProgramUniform1f(lighting_pipeline->program(), light_bias_uni, bias);
+	glProgramUniform1f(lighting_pipeline->program(), light_rad_uni, sample_radius);
+	glProgramUniform1f(lighting_pipeline->program(), light_scale_uni, scale);
 
-	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glBlendEquation(GL_FUNC_ADD);
 	// glBlendFuncSeparate(GL_SRC_COLOR, GL_ZERO, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	// glBlendEquationSeparate(GL_FUNC_ADD, GL_FUNC_ADD);
 
-	while(!glfwWindowShouldClose(win)) {
+	// Terrain into whichever framebuffer is bound. With the depth pre-pass,
+	// land depth is laid down first without colour, then the G-buffer pass
+	// tests GL_EQUAL so each pixel runs the fragment shader for its nearest
+	// land surface only. Water blends over land and never goes into the
+	// pre-pass. Counted passes feed the per-second report.
+	auto draw_terrain = [&](bool count){
+		TRACE_ZONE("terrain");
+		TRACE_GPU_ZONE(*gpu_trace, "terrain");
+		GL_DEBUG_GROUP("terrain");
+		gl_state->enable(GL_DEPTH_TEST);
+		gl_state->polygon_mode(input.wireframe ? GL_LINE : GL_FILL);
+		gl_state->color_mask(true);
+		gl_state->depth_mask(true);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		gl_state->bind_vertex_array(map_vao);
+
+		bool prepass = input.depth_prepass && input.draw_land;
+		if(prepass) {
+			TRACE_ZONE("depth pre-pass");
+			TRACE_GPU_ZONE(*gpu_trace, "depth pre-pass");
+			GL_DEBUG_GROUP("depth pre-pass");
+			if(count)
+				prepass_counter->begin();
+			gl_state->use_program(depth_pipeline->program());
+			gl_state->color_mask(false);
+			gl_state->depth_func(GL_GREATER);
+			glDrawArrays(GL_PATCHES, 0, map.size());
+			gl_state->color_mask(true);
+			if(count)
+				prepass_counter->end();
+		}
+
+		if(count)
+			gbuffer_counter->begin();
+		gl_state->use_program(render_pipeline->program());
+		if(input.draw_land) {
+			gl_state->depth_func(prepass ? GL_EQUAL : GL_GREATER);
+			gl_state->depth_mask(!prepass);
+			glUniform1i(draw_water_uni, 0);
+			glDrawArrays(GL_PATCHES, 0, map.size());
+			// glDrawArrays(GL_TRIANGLES, 0, map.size());
+		}
+		if(input.draw_water) {
+			gl_state->depth_func(GL_GREATER);
+			gl_state->depth_mask(true);
+			glUniform1i(draw_water_uni, 1);
+			glDrawArrays(GL_PATCHES, 0, map.size());
+			// glDrawArrays(GL_TRIANGLES, 0, map.size());
+		}
+		if(count)
+			gbuffer_counter->end();
+	};
+
+	// Lights the G-buffer into framebuffer_display, or with to_window
+	// straight into the window, downsampling on the way; depth testing off.
+	// Lights into the window or the lit frame, over viewport pixels of the
+	// G-buffer; whatever viewport an earlier pass left is never relied on.
+	auto draw_lighting = [&](bool to_window, glm::ivec2 viewport){
+		TRACE_ZONE("lighting");
+		TRACE_GPU_ZONE(*gpu_trace, "lighting");
+		GL_DEBUG_GROUP("lighting");
+		gl_state->disable(GL_DEPTH_TEST);
+		gl_state->polygon_mode(GL_FILL);
+
+		gl_state->bind_vertex_array(fb_vao);
+
+		gl_state->use_program(lighting_pipeline->program());
+		glUniform1i(light_resolve_uni, to_window);
+
+		if(to_window) {
+			// Every pixel is written, no clear needed.
+			gl_state->bind_framebuffer(0);
+		}
+		else {
+			gl_state->bind_framebuffer(framebuffer_display);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		}
+		gl_state->viewport(0, 0, viewport.x, viewport.y);
+
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+	};
+
+	// Renders the current view as a poster-sized PNG, tile by tile through
+	// the same passes, then restores the per-frame uniforms.
+	auto render_poster = [&]{
+		TRACE_ZONE("poster");
+		GL_DEBUG_GROUP("poster");
+		Poster poster(
+			poster_width, poster_height, glm::ivec2(render_size.x, render_size.y),
+			poster_apron, poster_band_bytes, pi/3.f, 0.01f, 3000.0f
+		);
+		wlog.log(
+			L"Rendering " + std::to_wstring(poster.width()) + L"x" + std::to_wstring(poster.height()) +
+			L" poster in " + std::to_wstring(poster.tiles().size()) + L" tiles.\n"
+		);
+		auto poster_start = std::chrono::high_resolution_clock::now();
+
+		camera_block.frame_projection = poster.projection();
+
+		// Posters are never wireframe.
+		bool was_wireframe = input.wireframe;
+		input.wireframe = false;
+
+		std::string error;
+		bool ok = poster.render(poster_path, framebuffer_display_color_texture, [&](const Poster::Tile &tile){
+			camera_block.projection = tile.projection;
+			camera_buffer.sub_data(0, sizeof(camera_block), &camera_block);
+			glProgramUniform4fv(lighting_pipeline->program(), light_image_rect_uni, 1, glm::value_ptr(tile.image_rect));
+			glProgramUniform2f(
+				lighting_pipeline->program(), light_viewport_scale_uni,
+				tile.viewport.x/render_size.x, tile.viewport.y/render_size.y
+			);
+			glProgramUniform2f(
+				lighting_pipeline->program(), light_max_offset_uni,
+				static_cast<float>(poster.apron())/tile.viewport.x, static_cast<float>(poster.apron())/tile.viewport.y
+			);
+
+			gl_state->bind_framebuffer(framebuffer_render);
+			gl_state->viewport(0, 0, tile.viewport.x, tile.viewport.y);
+			draw_terrain(false);
+			draw_lighting(false, tile.viewport);
+		}, jobs, error);
+
+		input.wireframe = was_wireframe;
+		gl_state->bind_framebuffer(0);
+
+		camera_block.projection = projection;
+		camera_block.frame_projection = frame_projection;
+		camera_buffer.sub_data(0, sizeof(camera_block), &camera_block);
+		glProgramUniform4f(lighting_pipeline->program(), light_image_rect_uni, 0.f, 0.f, 1.f, 1.f);
+		glProgramUniform2f(lighting_pipeline->program(), light_viewport_scale_uni, 1.f, 1.f);
+		glProgramUniform2f(lighting_pipeline->program(), light_max_offset_uni, 1e6f, 1e6f);
+
+		if(ok)
+			wlog.log(
+				L"Poster saved to " + widen(poster_path) + L" in " + std::to_wstring(
+					std::chrono::duration_cast<std::chrono::milliseconds>(
+						std::chrono::high_resolution_clock::now()-poster_start
+					).count()
+				) + L"ms.\n"
+			);
+		else
+			wlog.log(L"Could not render poster: " + widen(error) + L"\n");
+	};
+
+	// Frame time graph in the bottom left corner of the window: CPU bars in
+	// green, GPU in orange, the present interval as a white trace, hitch
+	// thresholds in red and the rolling CPU p50/p99 in blue and magenta.
+	auto draw_overlay = [&]{
+		// Nothing to draw into inside the margins of a minimized or tiny window.
+		if(input.win_width <= 16 || input.win_height <= 16)
+			return;
+		TRACE_ZONE("overlay");
+		TRACE_GPU_ZONE(*gpu_trace, "overlay");
+		GL_DEBUG_GROUP("overlay");
+		for(unsigned i=0;i<FrameStats::series_count;++i) {
+			auto recent = frame_stats->recent(static_cast<FrameStats::Series>(i));
+			glTextureSubImage2D(overlay_texture, 0, 0, i, FrameStats::recent_count, 1, GL_RED, GL_FLOAT, recent.data());
+		}
+		FrameStats::Summary cpu = frame_stats->summary(FrameStats::Series::cpu, FrameStats::Window::rolling);
+		glProgramUniform2f(overlay_pipeline->program(), overlay_percentiles_uni, cpu.p50_ms, cpu.p99_ms);
+
+		gl_state->polygon_mode(GL_FILL);
+		gl_state->disable(GL_DEPTH_TEST);
+
+		gl_state->bind_framebuffer(0);
+		gl_state->viewport(8, 8, std::min(512, input.win_width-16), std::min(160, input.win_height-16));
+		gl_state->use_program(overlay_pipeline->program());
+		gl_state->bind_vertex_array(fb_vao);
+		gl_state->bind_texture_unit(8, overlay_texture);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+	};
+
+	// Setup above bound things behind the tracker's back.
+	gl_state->invalidate();
+
+	// Inputs of the last drawn frame, for idle frame skipping.
+	TerrainInputs drawn_terrain{};
+	PresentInputs drawn_present{};
+	bool drawn_valid = false;
+	bool drew_last = true;
+	unsigned shader_generation = 0;
+	FrameInput::Requests handled = input.requests;
+
+	startup_zone.end();
+	while(!render_quit) {
+		TRACE_ZONE("frame");
 		end = std::chrono::high_resolution_clock::now();
+		bool measure_frame = true;
 		long int ft = std::chrono::duration_cast<std::chrono::microseconds>(
 			end-start
 		).count();
-		double fts = static_cast<double>(ft)/1e6L;
-		float fts_float = static_cast<float>(fts);
-		ft_total += ft;
-		++cnt;
+		// Only drawn frames count towards the averages.
+		if(drew_last) {
+			ft_total += ft;
+			++cnt;
+		}
 		auto tslastprint = std::chrono::duration_cast<std::chrono::seconds>(
 			end-timetoprint
 		).count();
 		if(tslastprint >= 1) {
 			timetoprint = std::chrono::high_resolution_clock::now();
-			float ft_avg = ft_total/cnt;
-			std::wstring frametimestr = L"FPS avg: " + 
-				std::to_wstring(1e6L/ft_avg) + L"\t" +
-				L"Frametime avg: "+std::to_wstring(ft_avg)+L"µs\n";
-			wlog.log(frametimestr);
-			cnt=0;
-			ft_total=0.L;
-			wlog.log(L"Position: {" + std::to_wstring(cam.position.x) + std::to_wstring(cam.position.y) + std::to_wstring(cam.position.z) + L"}\n");
+			// Without debug output errors are still noticed, but the
+			// glGetError round trip stays off the per-frame path.
+			if(!gl_debug_enabled())
+				process_gl_errors();
+			// Nothing to report for a second spent idle.
+			if(cnt) {
+				float ft_avg = ft_total/cnt;
+				std::wstring frametimestr = L"FPS avg: " + 
+					std::to_wstring(1e6L/ft_avg) + L"\t" +
+					L"Frametime avg: "+std::to_wstring(ft_avg)+L"µs\n";
+				wlog.log(frametimestr);
+				GlState::Counters gl_calls = gl_state->last_frame();
+				LOG_DEBUG(wlog,
+					L"GL state calls last frame: " + std::to_wstring(gl_calls.issued) + L" issued, " +
+					std::to_wstring(gl_calls.elided) + L" elided.\n"
+				);
+				cnt=0;
+				ft_total=0.L;
+				wlog.log(L"Frame times of the last second:\n" + widen(frame_stats->report(FrameStats::Window::interval)));
+				frame_stats->next_interval();
+				log_pass(L"Depth pre-pass", *prepass_counter);
+				log_pass(L"G-buffer pass", *gbuffer_counter);
+				FramePacer::Summary pacing = frame_pacer->next_interval();
+				if(pacing.frames)
+					wlog.log(
+						L"Pacing to " + std::to_wstring(frame_pacer->rate()) + L" FPS, late by p50 " +
+						std::to_wstring(pacing.p50_us) + L"µs p99 " + std::to_wstring(pacing.p99_us) +
+						L"µs max " + std::to_wstring(pacing.max_us) + L"µs, " +
+						std::to_wstring(pacing.missed) + L" deadlines missed.\n"
+					);
+				LOG_DEBUG(wlog, L"Position: {" + std::to_wstring(input.cam.position.x) + std::to_wstring(input.cam.position.y) + std::to_wstring(input.cam.position.z) + L"}\n");
+			}
+			if(capture->recording() || capture->busy()) {
+				Capture::Stats stats = capture->stats();
+				wlog.log(
+					L"Capture: " + std::to_wstring(stats.captured) + L" captured, " +
+					std::to_wstring(stats.encoded) + L" encoded, " +
+					std::to_wstring(stats.failed) + L" failed, " +
+					std::to_wstring(stats.encoder_queue) + L" queued for encoding\n"
+				);
+				if(stats.stalled_frames)
+					wlog.log(
+						L"Capture back-pressure: encoders behind the GPU, " +
+						std::to_wstring(stats.stalled_frames) + L" frames waited " +
+						std::to_wstring(stats.stall_us/1000) + L"ms in total\n"
+					);
+			}
+			HorizonMaps::Stats horizon_stats = horizon_maps->stats();
+			if(horizon_stats.built != horizons_logged) {
+				horizons_logged = horizon_stats.built;
+				wlog.log(
+					L"Horizon maps: " + std::to_wstring(horizon_stats.built) + L" regions built, " +
+					std::to_wstring(horizon_stats.evicted) + L" evicted, " +
+					std::to_wstring(horizon_stats.pending) + L" waiting\n"
+				);
+			}
+			ShadowCascades::Stats shadow_stats = shadow_cascades->stats();
+			if(shadow_stats.deferred != shadows_logged.deferred ||
+					!std::equal(std::begin(shadow_stats.rendered), std::end(shadow_stats.rendered), std::begin(shadows_logged.rendered))) {
+				std::wstring rendered;
+				for(unsigned i=0;i<ShadowCascades::max_cascades;++i)
+					rendered += (i ? L", " : L"") + std::to_wstring(shadow_stats.rendered[i] - shadows_logged.rendered[i]);
+				wlog.log(
+					L"Shadow cascades rendered " + rendered + L" times, " +
+					std::to_wstring(shadow_stats.deferred - shadows_logged.deferred) + L" due ones deferred\n"
+				);
+				shadows_logged = shadow_stats;
+			}
+			if(frame_export->active()) {
+				FrameExport::Stats stats = frame_export->stats();
+				wlog.log(
+					L"Frame export: " + std::to_wstring(stats.published) + L" published, " +
+					std::to_wstring(stats.dropped) + L" dropped\n"
+				);
+			}
 			// wlog.log(L"SSAO Intensity : \t" + std::to_wstring(intensity) + L"\n");
 			// wlog.log(L"SSAO Bias : \t" + std::to_wstring(bias) + L"\n");
 			// wlog.log(L"SSAO Scale : \t" + std::to_wstring(scale) + L"\n");
@@ -558,219 +1205,610 @@ int main()
 		}
 		start=end;
 
+		bool fresh_input = frame_inputs->update();
+		if(fresh_input)
+			input = frame_inputs->front();
+		FrameInput::Requests &requests = input.requests;
+		if(requests.reload != handled.reload)
+			reload_shaders();
+		if(requests.screenshot != handled.screenshot)
+			screenshot->request("/tmp/screenshot.png");
+		for(; handled.capture != requests.capture; ++handled.capture)
+			toggle_capture();
+		for(; handled.frame_export != requests.frame_export; ++handled.frame_export)
+			toggle_export();
+		bool poster_requested = requests.poster != handled.poster;
+		bool window_damaged = requests.refresh != handled.refresh;
+		handled = requests;
+		if(input.limit_fps != limit_fps) {
+			limit_fps = input.limit_fps;
+			frame_pacer->reset();
+			apply_swap_interval(limit_fps);
+		}
+		// The simulation steps once per presented frame while recording.
+		bool lockstep = capture->recording();
+		lockstep_step = lockstep ? capture->timestep() : 0.f;
+
+		for(auto &path : shader_watcher->poll()) {
+			wlog.log(L"Shader changed: " + widen(path) + L"\n");
+			for(auto pipeline : pipelines())
+				pipeline->rebuild(path);
+		}
+		if(poll_shaders()) {
+			shaders_reloaded = true;
+			// Pick up files that were newly #included.
+			for(auto pipeline : pipelines())
+				for(auto &file : pipeline->files())
+					shader_watcher->watch(file);
+		}
+
 		if(shaders_reloaded) {
 			shaders_reloaded = false;
+			++shader_generation;
+			// Replaced programs were deleted and their names may come back.
+			gl_state->invalidate();
 
-			glUseProgram(*render_program);
-
-			view_uni = glGetUniformLocation(*render_program, "view");
-			glUniformMatrix4fv(view_uni, 1, GL_FALSE, glm::value_ptr(view));
-
-			camera_position_uni = glGetUniformLocation(*render_program, "camera_position");
-			glUniform3fv(camera_position_uni, 1, glm::value_ptr(cam.position));
+			gl_state->use_program(render_pipeline->program());
 
-			GLint draw_water_uni = glGetUniformLocation(*render_program, "draw_water");
+			draw_water_uni = glGetUniformLocation(render_pipeline->program(), "draw_water");
 			glUniform1i(draw_water_uni, 0);
+			depth_draw_water_uni = glGetUniformLocation(depth_pipeline->program(), "draw_water");
+			glProgramUniform1i(depth_pipeline->program(), depth_draw_water_uni, 0);
+			shadow_view_projection_uni = glGetUniformLocation(shadow_pipeline->program(), "shadow_view_projection");
+
+			render_spritesheet_uni = glGetUniformLocation(render_pipeline->program(), "spritesheet");
+
+			gl_state->use_program(lighting_pipeline->program());
+
+			light_color_uni = glGetUniformLocation(lighting_pipeline->program(), "colorTex");
+			light_normals_uni = glGetUniformLocation(lighting_pipeline->program(), "normalsTex");
+			light_depth_uni = glGetUniformLocation(lighting_pipeline->program(), "depthTex");
+			light_image_rect_uni = glGetUniformLocation(lighting_pipeline->program(), "image_rect");
+			light_viewport_scale_uni = glGetUniformLocation(lighting_pipeline->program(), "viewport_scale");
+			light_max_offset_uni = glGetUniformLocation(lighting_pipeline->program(), "max_sample_offset");
+			light_resolve_uni = glGetUniformLocation(lighting_pipeline->program(), "resolve");
+			light_background_uni = glGetUniformLocation(lighting_pipeline->program(), "background");
+			glUniform3f(light_background_uni, clear_color.x, clear_color.y, clear_color.z);
+
+
+			light_intensity_uni = glGetUniformLocation(lighting_pipeline->program(), "intensity");
+			light_bias_uni = glGetUniformLocation(lighting_pipeline->program(), "bias");
+			light_rad_uni = glGetUniformLocation(lighting_pipeline->program(), "sample_radius");
+			light_scale_uni = glGetUniformLocation(lighting_pipeline->program(), "scale");
+			light_sun_direction_uni = glGetUniformLocation(lighting_pipeline->program(), "sun_direction");
+			glProgramUniform3fv(lighting_pipeline->program(), light_sun_direction_uni, 1, glm::value_ptr(sun_direction));
+
+			// Keep tuned values across reloads instead of resetting them to
+			// the shader defaults.
+			glProgramUniform1f(lighting_pipeline->program(), light_intensity_uni, intensity);
+			glProgramUniform1f(lighting_pipeline->program(), light_bias_uni, bias);
+			glProgramUniform1f(lighting_pipeline->program(), light_rad_uni, sample_radius);
+			glProgramUniform1f(lighting_pipeline->program(), light_scale_uni, scale);
+
+			glProgramUniform1i(lighting_pipeline->program(), light_color_uni, 4);
+			glProgramUniform1i(lighting_pipeline->program(), light_normals_uni, 5);
+			glProgramUniform1i(lighting_pipeline->program(), light_depth_uni, 6);
+			glProgramUniform1i(display_pipeline->program(), framebuffer_uni, 7);
+
+			overlay_samples_uni = glGetUniformLocation(overlay_pipeline->program(), "samples");
+			overlay_hitch_uni = glGetUniformLocation(overlay_pipeline->program(), "hitch_ms");
+			overlay_percentiles_uni = glGetUniformLocation(overlay_pipeline->program(), "percentiles_ms");
+			glProgramUniform1i(overlay_pipeline->program(), overlay_samples_uni, 8);
+			glProgramUniform4fv(overlay_pipeline->program(), overlay_hitch_uni, 1, glm::value_ptr(overlay_hitch_ms));
+
+			fb_vao_pos_attrib = glGetAttribLocation(display_pipeline->program(), "pos");
+			if(fb_vao_pos_attrib != -1)
+				fb_vao.attribute(fb_vao_pos_attrib, 0, 2, GL_FLOAT, 0);
+
+			fb_vao_texcoord_attrib = glGetAttribLocation(display_pipeline->program(), "texcoords");
+			if(fb_vao_texcoord_attrib != -1)
+				fb_vao.attribute(fb_vao_texcoord_attrib, 0, 2, GL_FLOAT, 2*sizeof(float));
+		}
 
-			projection_uni = glGetUniformLocation(*render_program, "projection");
-			glUniformMatrix4fv(projection_uni, 1, GL_FALSE, glm::value_ptr(projection));
+		if(input.intensity != intensity || input.bias != bias || input.scale != scale || input.sample_radius != sample_radius) {
+			intensity = input.intensity;
+			bias = input.bias;
+			scale = input.scale;
+			sample_radius = input.sample_radius;
+			glProgramUniform1f(lighting_pipeline->program(), light_intensity_uni, intensity);
+			glProgramUniform1f(lighting_pipeline->program(), light_bias_uni, bias);
+			glProgramUniform1f(lighting_pipeline->program(), light_rad_uni, sample_radius);
+			glProgramUniform1f(lighting_pipeline->program(), light_scale_uni, scale);
+		}
 
-			render_spritesheet_uni = glGetUniformLocation(*render_program, "spritesheet");
+		gl_state->use_program(render_pipeline->program());
 
-			glUseProgram(*lighting_program);
+		view = input.cam.get_view();
+		camera_block.view = view;
+		camera_block.camera_position = glm::vec4(input.cam.position, 1.f);
+		camera_buffer.sub_data(0, sizeof(camera_block), &camera_block);
+		glUniform1i(render_spritesheet_uni, 0);
 
-			light_color_uni = glGetUniformLocation(*lighting_program, "colorTex");
-			light_normals_uni = glGetUniformLocation(*lighting_program, "normalsTex");
-			light_depth_uni = glGetUniformLocation(*lighting_program, "depthTex");
-			light_proj_uni = glGetUniformLocation(*lighting_program, "projection");
-			glUniformMatrix4fv(light_proj_uni, 1, GL_FALSE, glm::value_ptr(projection));
-			light_view_uni = glGetUniformLocation(*lighting_program, "view");
-			glUniformMatrix4fv(light_view_uni, 1, GL_FALSE, glm::value_ptr(view));
+		// Horizon maps and shadow cascades follow the camera, the lit
+		// picture changes as they are brought up to date.
+		glm::vec2 terrain_camera = -glm::vec2(input.cam.position);
+		if(input.lighting && horizon_maps->outdated(terrain_camera)) {
+			TRACE_ZONE("horizons");
+			TRACE_GPU_ZONE(*gpu_trace, "horizons");
+			GL_DEBUG_GROUP("horizons");
+			horizon_maps->update(
+				terrain_camera, horizon_heights_pipeline->program(), horizon_pipeline->program(), *gl_state
+			);
+		}
+		if(input.lighting && shadow_cascades->outdated(terrain_camera, sun_direction)) {
+			TRACE_ZONE("shadows");
+			TRACE_GPU_ZONE(*gpu_trace, "shadows");
+			GL_DEBUG_GROUP("shadows");
+			shadow_cascades->update(terrain_camera, sun_direction, *gl_state, [&](const glm::mat4 &view_projection){
+				gl_state->use_program(shadow_pipeline->program());
+				glProgramUniformMatrix4fv(
+					shadow_pipeline->program(), shadow_view_projection_uni, 1, GL_FALSE, glm::value_ptr(view_projection)
+				);
+				gl_state->bind_vertex_array(map_vao);
+				glDrawArrays(GL_PATCHES, 0, map.size());
+			});
+		}
 
+		if(poster_requested) {
+			render_poster();
+			// Keep the time spent on the poster out of the frame statistics.
+			start = std::chrono::high_resolution_clock::now();
+			measure_frame = false;
+			frame_pacer->reset();
+			// The tiles overwrote the G-buffer.
+			drawn_valid = false;
+		}
 
-			light_intensity_uni = glGetUniformLocation(*lighting_program, "intensity");
-			light_bias_uni = glGetUniformLocation(*lighting_program, "bias");
-			light_rad_uni = glGetUniformLocation(*lighting_program, "sample_radius");
-			light_scale_uni = glGetUniformLocation(*lighting_program, "scale");
+		// Unchanged inputs give the picture already in the window, so nothing
+		// is drawn or swapped. When only the lighting or the window changed
+		// the G-buffer is still good and is just lit again. Readbacks and
+		// benchmarks need every frame drawn; while recording, every new
+		// snapshot is one frame and nothing else is.
+		TerrainInputs terrain_inputs{view, input.lighting, input.draw_water, input.draw_land, input.wireframe, shader_generation};
+		PresentInputs present_inputs{
+			intensity, bias, scale, sample_radius, input.win_width, input.win_height, input.show_overlay,
+			horizon_maps->generation(), shadow_cascades->generation()
+		};
+		bool forced = !idle_skip || bench_seconds || !drawn_valid ||
+			screenshot->pending() || frame_export->active();
+		bool terrain_changed = forced || !(terrain_inputs == drawn_terrain);
+		bool present = terrain_changed || window_damaged || !(present_inputs == drawn_present);
+		if(lockstep)
+			terrain_changed = present = fresh_input;
+		// Without lighting the terrain pass draws straight into the window.
+		bool draw_scene = terrain_changed || (present && !input.lighting);
+		measure_frame = measure_frame && present;
+
+		if(measure_frame)
+			gpu_timer->begin();
+
+		if(draw_scene) {
+			if(input.lighting) {
+				gl_state->bind_framebuffer(framebuffer_render);
+				gl_state->viewport(0, 0, render_size.x, render_size.y);
+			}
+			else {
+				gl_state->bind_framebuffer(0);
+				gl_state->viewport(0, 0, input.win_width, input.win_height);
+			}
 
-			glProgramUniform1i(*lighting_program, light_color_uni, 4);
-			glProgramUniform1i(*lighting_program, light_normals_uni, 5);
-			glProgramUniform1i(*lighting_program, light_depth_uni, 6);
-			glProgramUniform1i(*display_program, framebuffer_uni, 7);
+			draw_terrain(measure_frame);
+		}
 
-			glBindBuffer(GL_ARRAY_BUFFER, map_vbo);
-			glBindVertexArray(map_vao);
-			glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, 2*sizeof(float), BUFFER_OFFSET(0));
-			glEnableVertexAttribArray(4);
+		// The lit frame only when something reads it back; the window alone
+		// is served by lighting straight into it.
+		bool lit_frame = always_lit_frame || screenshot->pending() || capture->recording() || frame_export->active();
 
-			glBindBuffer(GL_ARRAY_BUFFER, fb_vbo);
-			glBindVertexArray(fb_vao);
+		if(present && input.lighting && !lit_frame) {
+			draw_lighting(true, glm::ivec2(input.win_width, input.win_height));
+		}
+		else if(present && input.lighting) {
+			draw_lighting(false, glm::ivec2(render_size.x, render_size.y));
 
-			fb_vao_pos_attrib = glGetAttribLocation(*display_program, "pos");
-			if(fb_vao_pos_attrib != -1) {
-				glEnableVertexAttribArray(fb_vao_pos_attrib);
-				glVertexAttribPointer(fb_vao_pos_attrib, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), 0);
-			}
+			{
+				TRACE_ZONE("display");
+				TRACE_GPU_ZONE(*gpu_trace, "display");
+				GL_DEBUG_GROUP("display");
+				gl_state->bind_framebuffer(0);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-			fb_vao_texcoord_attrib = glGetAttribLocation(*display_program, "texcoords");
-			if(fb_vao_texcoord_attrib != -1) {
-				glEnableVertexAttribArray(fb_vao_texcoord_attrib);
-				glVertexAttribPointer(fb_vao_texcoord_attrib, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), BUFFER_OFFSET(sizeof(float)*2));
+				gl_state->use_program(display_pipeline->program());
+				gl_state->viewport(0, 0, input.win_width, input.win_height);
+
+				glDrawArrays(GL_TRIANGLES, 0, 6);
 			}
 		}
 
-		float mult = 1.0f;
-
-		if(glfwGetKey(win, GLFW_KEY_LEFT_SHIFT)) {
-			mult = 0.3f;
-		}
+		if(present && input.show_overlay)
+			draw_overlay();
 
-		if(glfwGetKey(win, GLFW_KEY_W)) {
-			cam.rotate({-1.f, 0.f, 0.f}, fts_float*3.f);
-		}
-		if(glfwGetKey(win, GLFW_KEY_S)) {
-			cam.rotate({ 1.f, 0.f, 0.f}, fts_float*3.f);
-		}
-		if(glfwGetKey(win, GLFW_KEY_A)) {
-			cam.rotate({ 0.f,-1.f, 0.f}, fts_float*3.f);
-		}
-		if(glfwGetKey(win, GLFW_KEY_D)) {
-			cam.rotate({ 0.f, 1.f, 0.f}, fts_float*3.f);
-		}
-		if(glfwGetKey(win, GLFW_KEY_Q)) {
-			cam.rotate({ 0.f, 0.f,-1.f}, fts_float*3.f);
+		{
+			TRACE_ZONE("readbacks");
+			TRACE_GPU_ZONE(*gpu_trace, "readbacks");
+			GL_DEBUG_GROUP("readbacks");
+			screenshot->update(framebuffer_display_color_texture, render_size.x, render_size.y);
+			capture->update(framebuffer_display_color_texture, render_size.x, render_size.y, present);
+			frame_export->update(framebuffer_display_color_texture, render_size.x, render_size.y);
 		}
-		if(glfwGetKey(win, GLFW_KEY_E)) {
-			cam.rotate({ 0.f, 0.f, 1.f}, fts_float*3.f);
-		}
-		if(glfwGetKey(win, GLFW_KEY_UP)) {
-			cam.advance(mult*fts_float*100.f);
-		}
-		if(glfwGetKey(win, GLFW_KEY_DOWN)) {
-			cam.advance(mult*fts_float*-100.f);
-		}
-		if(glfwGetKey(win, GLFW_KEY_RIGHT)) {
-			cam.strafe(mult*fts_float*100.f);
-		}
-		if(glfwGetKey(win, GLFW_KEY_LEFT)) {
-			cam.strafe(mult*fts_float*-100.f);
-		}
-		if(glfwGetKey(win, GLFW_KEY_SPACE)) {
-			cam.climb(mult*fts_float*100.f);
-		}
-		if(glfwGetKey(win, GLFW_KEY_RIGHT_CONTROL)) {
-			cam.climb(mult*fts_float*-100.f);
+		{
+			std::string path;
+			bool ok;
+			while(screenshot->finished(path, ok)) {
+				if(ok)
+					wlog.log(L"Screenshot saved to " + widen(path) + L"\n");
+				else
+					LOG_ERROR(wlog, L"ERROR SAVING SCREENSHOT!\n");
+			}
 		}
 
-		if(glfwGetKey(win, GLFW_KEY_G)) {
-			intensity += 0.01;
-			glProgramUniform1f(*lighting_program, light_intensity_uni, intensity);
-		}
-		if(glfwGetKey(win, GLFW_KEY_V)) {
-			intensity -= 0.01;
-			glProgramUniform1f(*lighting_program, light_intensity_uni, intensity);
-		}
-		if(glfwGetKey(win, GLFW_KEY_H)) {
-			bias += 0.01;
-			glProgramUniform1f(*lighting_program, light_bias_uni, bias);
-		}
-		if(glfwGetKey(win, GLFW_KEY_B)) {
-			bias -= 0.01;
-			glProgramUniform1f(*lighting_program, light_bias_uni, bias);
-		}
-		if(glfwGetKey(win, GLFW_KEY_J)) {
-			sample_radius += 0.01;
-			glProgramUniform1f(*lighting_program, light_rad_uni, sample_radius);
+		if(measure_frame) {
+			gpu_timer->end();
+			frame_stats->record(
+				FrameStats::Series::cpu,
+				std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::high_resolution_clock::now()-end
+				).count()
+			);
 		}
-		if(glfwGetKey(win, GLFW_KEY_N)) {
-			sample_radius -= 0.01;
-			glProgramUniform1f(*lighting_program, light_rad_uni, sample_radius);
+		auto now = std::chrono::high_resolution_clock::now();
+		if(present) {
+			{
+				TRACE_ZONE("swap");
+				glfwSwapBuffers(win);
+			}
+			gl_state->end_frame();
+			now = std::chrono::high_resolution_clock::now();
+			if(measure_frame)
+				frame_stats->record(
+					FrameStats::Series::present,
+					std::chrono::duration_cast<std::chrono::microseconds>(now-presented).count()
+				);
+			presented = now;
+
+			drawn_terrain = terrain_inputs;
+			drawn_present = present_inputs;
+			drawn_valid = true;
+			inputs_drawn = input.sequence;
+			// A simulation in lockstep waits for this.
+			if(lockstep)
+				glfwPostEmptyEvent();
 		}
-		if(glfwGetKey(win, GLFW_KEY_K)) {
-			scale += 0.01;
-			glProgramUniform1f(*lighting_program, light_scale_uni, scale);
+		drew_last = present;
+
+		gpu_times.clear();
+		gpu_timer->poll(gpu_times);
+		for(auto ns : gpu_times)
+			frame_stats->record(FrameStats::Series::gpu, ns/1000);
+		gpu_trace->poll();
+		prepass_counter->poll();
+		gbuffer_counter->poll();
+
+		if(!present) {
+			TRACE_ZONE("idle");
+			// Cascades held back by their budgets catch up without input.
+			if(!input.lighting || !shadow_cascades->pending())
+				wait_for_input(std::chrono::milliseconds(idle_wait_ms));
+			// Keep the wait out of the next frame's step and present interval.
+			start = presented = std::chrono::high_resolution_clock::now();
+			frame_pacer->reset();
 		}
-		if(glfwGetKey(win, GLFW_KEY_M)) {
-			scale -= 0.01;
-			glProgramUniform1f(*lighting_program, light_scale_uni, scale);
+		if(gl_debug_enabled())
+			for(auto &message : gl_debug_fresh())
+				log_gl_debug_message(message);
+
+		if(bench_seconds && now >= bench_end) {
+			wlog.log(L"Benchmark results:\n" + widen(frame_stats->report(FrameStats::Window::run)));
+			if(!bench_out.empty()) {
+				std::ofstream out(bench_out);
+				out << frame_stats->csv(FrameStats::Window::run);
+				if(!out)
+					wlog.log(L"Could not write " + widen(bench_out) + L"\n");
+			}
+			render_quit = true;
 		}
 
-		glUseProgram(*render_program);
-
-		view = cam.get_view();
-		glUniform3fv(camera_position_uni, 1, glm::value_ptr(cam.position));
-		glUniformMatrix4fv(view_uni, 1, GL_FALSE, glm::value_ptr(view));
-		glProgramUniformMatrix4fv(*lighting_program, light_view_uni, 1, GL_FALSE, glm::value_ptr(view));
-		glUniform1i(render_spritesheet_uni, 0);
-
-
-		if(lighting) {
-			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_render);
-			glViewport(0.f, 0.f, render_size.x, render_size.y);
-		}
-		else {
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		// With a swap interval SwapBuffers already waited.
+		if(input.limit_fps && present && !swap_interval) {
+			TRACE_ZONE("pace");
+			frame_pacer->wait();
 		}
-		
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glBindBuffer(GL_ARRAY_BUFFER, map_vbo);
-		glBindVertexArray(map_vao);
+	}
 
-		if(draw_land) {
-			glUniform1i(draw_water_uni, 0);
-			glDrawArrays(GL_PATCHES, 0, map.size());
-			// glDrawArrays(GL_TRIANGLES, 0, map.size());
-		}
-		if(draw_water) {
-			glUniform1i(draw_water_uni, 1);
-			glDrawArrays(GL_PATCHES, 0, map.size());
-			// glDrawArrays(GL_TRIANGLES, 0, map.size());
+	// Finish pending encodes while the context (and the mapped readback
+	// buffer) is still alive.
+	delete screenshot;
+	capture->stop();
+	while(capture->busy()) {
+		capture->update(framebuffer_display_color_texture, render_size.x, render_size.y, false);
+		std::this_thread::sleep_for(1ms);
+	}
+	delete jobs;
+	delete capture;
+	delete frame_export;
+	delete gpu_timer;
+	delete horizon_maps;
+	delete shadow_cascades;
+	delete prepass_counter;
+	delete gbuffer_counter;
+	delete frame_stats;
+	delete frame_pacer;
+
+	// Release GPU resources while the context is still current.
+	overlay_texture.reset();
+	map_vao.reset();
+	map_vbo.reset();
+	fb_vao.reset();
+	fb_vbo.reset();
+	framebuffer_display.reset();
+	framebuffer_display_color_texture.reset();
+	framebuffer_render.reset();
+	framebuffer_render_depth_texture.reset();
+	framebuffer_render_normals_texture.reset();
+	framebuffer_render_color_texture.reset();
+	light_buffer.reset();
+	camera_buffer.reset();
+	vao.reset();
+	if(gpu_memory_total())
+		LOG_WARNING(wlog, L"GPU memory still in use at exit:\n" + widen(gpu_memory_describe()));
+
+	if(!trace_path.empty()) {
+		// Collect the last GPU zones before writing.
+		glFinish();
+		gpu_trace->poll();
+		trace_stop();
+		std::string error;
+		if(trace_write(trace_path, error))
+			wlog.log(L"Trace written to " + widen(trace_path) + L"\n");
+		else
+			wlog.log(L"Could not write trace: " + widen(error) + L"\n");
+		if(trace_dropped())
+			wlog.log(L"Trace memory ran out, " + std::to_wstring(trace_dropped()) + L" events dropped.\n");
+	}
+	delete gpu_trace;
+	delete gl_state;
+
+	if(gl_debug_enabled()) {
+		auto messages = gl_debug_messages();
+		if(!messages.empty()) {
+			wlog.log(L"GL debug messages this session:\n");
+			for(auto &message : messages)
+				wlog.log(L"\t" + widen(gl_debug_describe(message)) + L"\n", false);
 		}
+		gl_debug_disable();
+	}
 
-		if(lighting) {
-			glDisable(GL_DEPTH_TEST);
-			
-			GLint poly_mode;
+	glfwMakeContextCurrent(nullptr);
 
-			glGetIntegerv(GL_POLYGON_MODE, &poly_mode);
+	return 0;
+}
 
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+int main(int argc, char **argv)
+{
+	wlog.log(L"Starting up.\n");
 
-			glBindVertexArray(fb_vao);
-			glBindBuffer(GL_ARRAY_BUFFER, fb_vbo);
+	Options options(argc, argv);
+	for(auto &arg : options.invalid())
+		wlog.log(L"Ignoring argument " + widen(arg) + L"\n");
+	if(options.has("log-file")) {
+		log_file.open(options.get("log-file", ""), std::ios::app);
+		if(log_file)
+			wlog.stream(log_file);
+		else
+			LOG_WARNING(wlog, L"Could not open --log-file, logging to the console.\n");
+	}
+	// Tracing starts before anything else so startup shows up in the trace.
+	trace_path = options.get("trace", "");
+	if(!trace_path.empty()) {
+		trace_thread_name("main");
+		trace_start();
+	}
+	TRACE_NAMED_ZONE(startup_zone, "startup");
+
+	if(!parse_capture_format(options.get("capture-format", "png"), capture_format))
+		wlog.log(L"Unknown --capture-format, using png.\n");
+	capture_directory = options.get("capture-dir", capture_directory);
+	capture_fps = std::max(1, options.get("capture-fps", capture_fps));
+	if(options.has("poster-size") && !parse_poster_size(options.get("poster-size", ""), poster_width, poster_height))
+		wlog.log(L"Invalid --poster-size, expected e.g. 32768x16384.\n");
+	poster_path = options.get("poster-path", poster_path);
+	poster_apron = std::max(0, options.get("poster-apron", poster_apron));
+	poster_band_bytes = static_cast<size_t>(std::max(1, options.get("poster-band-mb", 64))) << 20;
+	export_name = options.get("export-name", export_name);
+	export_slots = std::max(1, options.get("export-slots", static_cast<int>(export_slots)));
+	std::vector<double> hitch_ms = {16.7, 33.3, 100.0};
+	if(options.has("hitch-ms") && !parse_hitch_thresholds(options.get("hitch-ms", ""), hitch_ms))
+		wlog.log(L"Invalid --hitch-ms, expected e.g. 16.7,33.3,100.\n");
+	int stats_window = std::max(1, options.get("stats-window", 10));
+	frame_stats = new FrameStats(stats_window, hitch_ms);
+	sim.show_overlay = options.has("overlay");
+	sim.depth_prepass = options.has("depth-prepass");
+	bench_seconds = std::max(0, options.get("bench", 0));
+	bench_out = options.get("bench-out", "");
+	always_lit_frame = options.has("lit-frame");
+	target_fps = std::max(1.f, options.get("fps", target_fps));
+	frame_pacer = new FramePacer(target_fps);
+	if(options.has("vsync"))
+		swap_interval = std::max(1, options.get("vsync", 1));
+	idle_skip = !options.has("no-idle-skip");
+	idle_wait_ms = std::max(1, options.get("idle-wait-ms", idle_wait_ms));
+	sim_hz = std::max(1, options.get("sim-hz", sim_hz));
+	// --gl-debug reports synchronously, --gl-debug=async is cheaper but
+	// loses the exact debug group of a message.
+	bool gl_debug = gl_debug_default || options.has("gl-debug");
+	wlog.log(L"Initializing GLFW.\n");
 
-			glUseProgram(*lighting_program);
+	TRACE_NAMED_ZONE(glfw_zone, "glfwInit");
+	if(!glfwInit())
+		return -1;
+	glfw_zone.end();
 
-			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_display);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glfwSetErrorCallback(
+		[](int, const char* msg){
+			wlog.log(std::wstring{msg, msg+std::strlen(msg)}+L"\n");
+		}
+	);
 
-			glDrawArrays(GL_TRIANGLES, 0, 6);
+	// Create window with context params etc.
+	wlog.log(L"Creating window.\n");
+	TRACE_NAMED_ZONE(window_zone, "create window");
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+	glfwWindowHint(GLFW_DEPTH_BITS, 32);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+	if(gl_debug)
+		glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+	GLFWwindow *win = glfwCreateWindow(
+		init_win_size.x, init_win_size.y, "infiniterrain", nullptr, nullptr
+	);
 
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	// If window creation fails, exit.
+	if(!win)
+		return -2;
+	window_zone.end();
+
+	// Kept current by the callback rather than asked for every frame.
+	glfwGetWindowSize(win, &sim.win_width, &sim.win_height);
+	glfwSetWindowSizeCallback(win, [](GLFWwindow*, int width, int height){
+		sim.win_width = width;
+		sim.win_height = height;
+		sim_changed = true;
+	});
+	// The window contents were lost and need presenting again.
+	glfwSetWindowRefreshCallback(win, [](GLFWwindow*){
+		++sim.requests.refresh;
+		sim_changed = true;
+	});
 
-			glUseProgram(*display_program);
-			glfwGetWindowSize(win, &win_size_x, &win_size_y);
-			glViewport(0.f, 0.f, win_size_x, win_size_y);
+	glfwSetKeyCallback(win, [](GLFWwindow*, int key, int, int action, int){
+		switch(action) {
+			case GLFW_PRESS: {
+				switch(key) {
+
+				}
+			} break;
+			case GLFW_RELEASE: {
+				switch(key) {
+					case GLFW_KEY_F: {
+						// Only the terrain pass draws in wireframe.
+						sim.wireframe = !sim.wireframe;
+					} break;
+					case GLFW_KEY_U: {
+						++sim.requests.screenshot;
+					} break;
+					case GLFW_KEY_T: {
+						++sim.requests.poster;
+					} break;
+					case GLFW_KEY_R: {
+						//Reload shaders
+						++sim.requests.reload;
+					} break;
+					case GLFW_KEY_C: {
+						++sim.requests.capture;
+					} break;
+					case GLFW_KEY_X: {
+						++sim.requests.frame_export;
+					} break;
+					case GLFW_KEY_P: {
+						sim.limit_fps = !sim.limit_fps;
+					} break;
+					case GLFW_KEY_L: {
+						sim.lighting = !sim.lighting;
+					} break;
+					case GLFW_KEY_O: {
+						sim.draw_water = !sim.draw_water;
+					} break;
+					case GLFW_KEY_I: {
+						sim.draw_land = !sim.draw_land;
+					} break;
+					case GLFW_KEY_F1: {
+						sim.show_overlay = !sim.show_overlay;
+					} break;
+					case GLFW_KEY_F2: {
+						sim.depth_prepass = !sim.depth_prepass;
+						wlog.log(sim.depth_prepass ? L"Depth pre-pass on.\n" : L"Depth pre-pass off.\n");
+					} break;
+				}
+			} break;
+		}
+		sim_changed = true;
+	});
 
-			glDrawArrays(GL_TRIANGLES, 0, 6);
+	wlog.log(L"Creating camera.\n");
+	sim.cam.position = glm::vec3(0.f, 69.f, -20.f);
+	sim.cam.rotate(glm::vec3(1.f, 0.f, 0.f), -pi/3.f);
+	if(bench_seconds) {
+		sim.limit_fps = false;
+		wlog.log(L"Benchmarking for " + std::to_wstring(bench_seconds) + L"s.\n");
+	}
 
-			glPolygonMode(GL_FRONT_AND_BACK, poly_mode);
+	// The context moves to the render thread; this thread keeps the window
+	// events and the simulation, so slow submission never delays input.
+	frame_inputs = new TripleBuffer<FrameInput>(sim);
+	int render_result = 0;
+	std::thread render_thread([&]{
+		render_result = render_main(win, options, hitch_ms, gl_debug);
+		glfwSetWindowShouldClose(win, GL_TRUE);
+		glfwPostEmptyEvent();
+	});
+	startup_zone.end();
+
+	// Fixed-step simulation. Ticks run while a simulated key is held (or a
+	// benchmark flies the camera); otherwise the thread sleeps until the
+	// next event. While recording it instead steps exactly once per frame
+	// the render thread presented.
+	using sim_clock = std::chrono::steady_clock;
+	const sim_clock::duration tick = std::chrono::duration_cast<sim_clock::duration>(
+		std::chrono::duration<double>(1.0/sim_hz)
+	);
+	const float tick_seconds = 1.f/sim_hz;
+	sim_clock::time_point next_tick = sim_clock::now();
+	while(!glfwWindowShouldClose(win)) {
+		float step = lockstep_step.load();
+		bool ticking = bench_seconds || sim_keys_held(win);
+		{
+			TRACE_ZONE("simulate");
+			if(step > 0.f) {
+				if(inputs_drawn.load() == sim.sequence) {
+					simulate(win, step);
+					sim_changed = true;
+				}
+				next_tick = sim_clock::now();
+			}
+			else if(ticking) {
+				sim_clock::time_point now = sim_clock::now();
+				// After a stall, carry on from now rather than catching up.
+				if(now - next_tick > 4*tick)
+					next_tick = now;
+				for(; next_tick <= now; next_tick += tick)
+					simulate(win, tick_seconds);
+				sim_changed = true;
+			}
+			else
+				next_tick = sim_clock::now();
 
-			glEnable(GL_DEPTH_TEST);
+			if(sim_changed)
+				publish_input();
 		}
 
-		glfwSwapBuffers(win);
-		glfwPollEvents();
-		process_gl_errors();
+		if(step > 0.f || !ticking)
+			glfwWaitEvents();
+		else
+			glfwWaitEventsTimeout(std::max(0.0, std::chrono::duration<double>(next_tick - sim_clock::now()).count()));
+	}
 
-		if(limit_fps)
-			std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	render_quit = true;
+	{
+		std::lock_guard<std::mutex> lock(input_mutex);
 	}
+	input_published.notify_one();
+	render_thread.join();
+	delete frame_inputs;
 
 	glfwDestroyWindow(win);
 
-	return 0;
+	return render_result;
 }
 
 bool process_gl_errors()
@@ -779,22 +1817,22 @@ bool process_gl_errors()
 	bool no_err=true;
 	while((gl_err = glGetError()) != GL_NO_ERROR) {
 		no_err=false;
-		wlog.log("OpenGL Error:\n");
+		LOG_ERROR(wlog, "OpenGL Error:\n");
 		switch(gl_err) {
 			case GL_INVALID_ENUM:
-				wlog.log("\tInvalid enum.\n");
+				LOG_ERROR(wlog, "\tInvalid enum.\n");
 				break;
 			case GL_INVALID_VALUE:
-				wlog.log("\tInvalid value.\n");
+				LOG_ERROR(wlog, "\tInvalid value.\n");
 				break;
 			case GL_INVALID_OPERATION:
-				wlog.log("\tInvalid operation.\n");
+				LOG_ERROR(wlog, "\tInvalid operation.\n");
 				break;
 			case GL_INVALID_FRAMEBUFFER_OPERATION:
-				wlog.log("\tInvalid framebuffer operation.\n");
+				LOG_ERROR(wlog, "\tInvalid framebuffer operation.\n");
 				break;
 			case GL_OUT_OF_MEMORY:
-				wlog.log("\tOut of memory.\n");
+				LOG_ERROR(wlog, "\tOut of memory.\n");
 				break;
 		}
 	}
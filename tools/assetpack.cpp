@@ -0,0 +1,20 @@
+// Packs asset files into a single archive readable by AssetStore.
+//   assetpack <output.pak> <file>...
+#include <Asset/Asset.hpp>
+#include <iostream>
+
+int main(int argc, char **argv)
+{
+	if(argc < 3) {
+		std::cerr << "usage: " << argv[0] << " <output.pak> <file>...\n";
+		return 1;
+	}
+	std::vector<std::string> files(argv+2, argv+argc);
+	std::string error;
+	if(!AssetPack::write(argv[1], files, error)) {
+		std::cerr << error << "\n";
+		return 1;
+	}
+	std::cout << "Packed " << files.size() << " files into " << argv[1] << "\n";
+	return 0;
+}
@@ -0,0 +1,157 @@
+// Reference consumer for the shared memory frame ring (FrameRing.hpp).
+// Follows the newest frame, reports rate, missed and torn frames and the
+// publish-to-consume latency, and optionally saves one frame as QOI.
+//   frame_consumer [--name=/infiniterrain-frames] [--seconds=0] [--dump=frame.qoi]
+#include <FrameExport/FrameRing.hpp>
+#include <Image/Image.hpp>
+#include <Options/Options.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+int64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()
+	).count();
+}
+
+const FrameRingHeader *map_ring(const std::string &name, size_t &size)
+{
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if(fd == -1)
+		return nullptr;
+	struct stat st;
+	if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FrameRingHeader)) {
+		close(fd);
+		return nullptr;
+	}
+	size = st.st_size;
+	void *memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(memory == MAP_FAILED)
+		return nullptr;
+
+	auto header = static_cast<const FrameRingHeader*>(memory);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if(std::memcmp(header->magic, frame_ring_magic, sizeof(frame_ring_magic)) != 0
+	|| header->version != frame_ring_version
+	|| header->size > size) {
+		munmap(memory, size);
+		return nullptr;
+	}
+	return header;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	Options options(argc, argv);
+	std::string name = options.get("name", "/infiniterrain-frames");
+	int seconds = options.get("seconds", 0);
+	std::string dump = options.get("dump", "");
+	if(!options.invalid().empty()) {
+		std::cerr << "usage: " << argv[0] << " [--name=/infiniterrain-frames] [--seconds=0] [--dump=frame.qoi]\n";
+		return 1;
+	}
+
+	size_t size = 0;
+	const FrameRingHeader *header;
+	std::cout << "Waiting for " << name << "\n";
+	while(!(header = map_ring(name, size)))
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	std::cout << header->width << "x" << header->height << ", " << header->slot_count
+	          << " slots, producer pid " << header->producer_pid << "\n";
+
+	const uint8_t *base = reinterpret_cast<const uint8_t*>(header);
+	auto slots = reinterpret_cast<const FrameSlot*>(base + header->slots_offset);
+	size_t row_bytes = static_cast<size_t>(header->width)*4;
+
+	unsigned long long received = 0, missed = 0, torn = 0;
+	unsigned long long total_received = 0;
+	int64_t latency_total = 0, latency_max = 0;
+	uint64_t next = header->published.load(std::memory_order_acquire);
+	int64_t start = now_ns(), last_report = start;
+	for(;;) {
+		uint64_t published = header->published.load(std::memory_order_acquire);
+		if(published == next) {
+			if(header->closed.load(std::memory_order_acquire)) {
+				std::cout << "Producer closed the ring.\n";
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+		else {
+			// Always jump to the newest frame, like a live consumer would.
+			uint64_t frame = published-1;
+			missed += frame - next;
+			next = published;
+
+			const FrameSlot &slot = slots[frame % header->slot_count];
+			const uint8_t *pixels = base + header->data_offset + (frame % header->slot_count)*header->slot_stride;
+			uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+			int64_t timestamp = slot.timestamp_ns;
+
+			// Work on the frame in place. Here: a cheap checksum over a
+			// sparse sample of pixels standing in for real processing.
+			uint64_t checksum = 0;
+			for(size_t offset=0;offset<header->height*row_bytes;offset+=4099)
+				checksum += pixels[offset];
+			std::vector<uint8_t> copy;
+			if(!dump.empty())
+				copy.assign(pixels, pixels + header->height*row_bytes);
+
+			// Only now is it known whether the producer overwrote the slot
+			// while it was being read.
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if(sequence != frame_slot_complete(frame) || slot.sequence.load(std::memory_order_relaxed) != sequence) {
+				++torn;
+			}
+			else {
+				++received;
+				++total_received;
+				int64_t latency = now_ns() - timestamp;
+				latency_total += latency;
+				latency_max = std::max(latency_max, latency);
+				if(!dump.empty()) {
+					if(write_qoi(dump, header->width, header->height, copy.data()))
+						std::cout << "Saved frame " << frame << " to " << dump << "\n";
+					else
+						std::cerr << "Could not write " << dump << "\n";
+					dump.clear();
+				}
+				(void)checksum;
+			}
+		}
+
+		int64_t now = now_ns();
+		if(now - last_report >= 1000000000) {
+			double elapsed = (now - last_report)/1e9;
+			std::printf(
+				"%.1f frames/s, %llu missed, %llu torn, latency avg %.2f ms max %.2f ms\n",
+				received/elapsed, missed, torn,
+				received ? latency_total/1e6/received : 0.0, latency_max/1e6
+			);
+			received = missed = torn = 0;
+			latency_total = latency_max = 0;
+			last_report = now;
+		}
+		if(seconds > 0 && now - start >= seconds*1000000000LL)
+			break;
+	}
+
+	std::cout << "Received " << total_received << " frames.\n";
+	munmap(const_cast<FrameRingHeader*>(header), size);
+	return 0;
+}
@@ -0,0 +1,239 @@
+// Answers batched terrain height queries over a Unix socket (framing in
+// HeightProtocol.hpp), for programs that need the ground the renderer
+// draws but have no GL context. Each batch is split across the job system;
+// answers already given are kept in a HeightCache.
+//   heightd [--socket=/tmp/infiniterrain-heights.sock] [--threads=N]
+//           [--cache-tiles=4096] [--tile-size=256] [--normal-step=1] [--grain=1024]
+#include <HeightService/HeightCache.hpp>
+#include <HeightService/HeightProtocol.hpp>
+#include <Jobs/JobSystem.hpp>
+#include <Options/Options.hpp>
+#include <Terrain/Terrain.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+std::atomic<bool> stopping{false};
+
+void stop(int)
+{
+	stopping = true;
+}
+
+struct Counters {
+	std::atomic<unsigned long long> batches{0};
+	std::atomic<unsigned long long> points{0};
+	std::atomic<unsigned long long> refused{0};
+};
+
+struct Service {
+	JobSystem &jobs;
+	HeightCache &cache;
+	Counters &counters;
+	float normal_step;
+	size_t grain;
+};
+
+// Heights and, if wanted, normals of count points, cached ones taken from
+// the cache and the rest computed a chunk at a time.
+void answer(Service &service, const float *x, const float *y, size_t count, bool normals, float *heights, float *normal_out)
+{
+	service.jobs.parallel_for(0, count, service.grain, [&](size_t first, size_t last) {
+		std::vector<size_t> missing;
+		std::vector<float> mx, my;
+		HeightCache::Result result;
+		for(size_t i=first;i<last;++i) {
+			if(service.cache.find(x[i], y[i], normals, result)) {
+				heights[i] = result.height;
+				if(normals)
+					std::copy(result.normal, result.normal+3, normal_out + 3*i);
+				continue;
+			}
+			missing.push_back(i);
+			mx.push_back(x[i]);
+			my.push_back(y[i]);
+		}
+		if(missing.empty())
+			return;
+
+		std::vector<float> mh(missing.size()), mn(normals ? 3*missing.size() : 0);
+		terrain_heights(mx.data(), my.data(), mh.data(), missing.size());
+		if(normals)
+			terrain_normals(mx.data(), my.data(), service.normal_step, mn.data(), missing.size());
+		for(size_t m=0;m<missing.size();++m) {
+			size_t i = missing[m];
+			result.height = heights[i] = mh[m];
+			result.has_normal = normals;
+			if(normals) {
+				std::copy(&mn[3*m], &mn[3*m]+3, result.normal);
+				std::copy(&mn[3*m], &mn[3*m]+3, normal_out + 3*i);
+			}
+			service.cache.insert(x[i], y[i], result);
+		}
+	});
+}
+
+void serve(Service &service, int fd)
+{
+	std::vector<float> points, x, y, response;
+	for(;;) {
+		pollfd readable = {fd, POLLIN, 0};
+		int ready = poll(&readable, 1, 200);
+		if(stopping)
+			break;
+		if(ready <= 0)
+			continue;
+
+		HeightHeader header;
+		if(!read_exact(fd, &header, sizeof(header)))
+			break;
+		bool valid = header.magic == height_magic && header.version == height_version && header.count <= height_max_count;
+		if(!valid) {
+			// The stream can not be trusted past a bad header.
+			++service.counters.refused;
+			header.count = 0;
+			write_exact(fd, &header, sizeof(header));
+			break;
+		}
+
+		size_t count = header.count;
+		bool normals = header.flags & height_flag_normals;
+		points.resize(2*count);
+		if(!read_exact(fd, points.data(), points.size()*sizeof(float)))
+			break;
+		x.resize(count);
+		y.resize(count);
+		bool covered = true;
+		for(size_t i=0;i<count;++i) {
+			x[i] = points[2*i];
+			y[i] = points[2*i+1];
+			covered = covered && service.cache.covers(x[i], y[i]);
+		}
+		if(!covered) {
+			// The stream is still in step, only this batch is refused.
+			++service.counters.refused;
+			header.count = 0;
+			if(!write_exact(fd, &header, sizeof(header)))
+				break;
+			continue;
+		}
+		response.resize(count*(normals ? 4 : 1));
+		answer(service, x.data(), y.data(), count, normals, response.data(), response.data() + count);
+		if(!write_exact(fd, &header, sizeof(header)) || !write_exact(fd, response.data(), response.size()*sizeof(float)))
+			break;
+		++service.counters.batches;
+		service.counters.points += count;
+	}
+	close(fd);
+}
+
+struct Connection {
+	std::thread thread;
+	std::atomic<bool> done{false};
+};
+
+}
+
+int main(int argc, char **argv)
+{
+	Options options(argc, argv);
+	std::string path = options.get("socket", "/tmp/infiniterrain-heights.sock");
+	int threads = options.get("threads", static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+	int cache_tiles = options.get("cache-tiles", 4096);
+	float tile_size = options.get("tile-size", 256.f);
+	float normal_step = options.get("normal-step", 1.f);
+	int grain = options.get("grain", 1024);
+	if(!options.invalid().empty() || threads <= 0 || cache_tiles < 0 || tile_size <= 0.f || normal_step <= 0.f || grain <= 0
+	|| path.size() >= sizeof(sockaddr_un::sun_path)) {
+		std::cerr << "usage: " << argv[0] << " [--socket=/tmp/infiniterrain-heights.sock] [--threads=N]\n"
+		          << "       [--cache-tiles=4096] [--tile-size=256] [--normal-step=1] [--grain=1024]\n";
+		return 1;
+	}
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path)-1);
+	unlink(path.c_str());
+	if(listener == -1 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 64) != 0) {
+		std::cerr << "Could not listen on " << path << ": " << std::strerror(errno) << "\n";
+		return 1;
+	}
+	std::signal(SIGINT, stop);
+	std::signal(SIGTERM, stop);
+	std::signal(SIGPIPE, SIG_IGN);
+
+	JobSystem jobs(threads);
+	// Most tiles see a few points each, a cap keeps a flood of random
+	// queries from growing a tile without bound.
+	HeightCache cache(tile_size, cache_tiles, 16384);
+	Counters counters;
+	Service service{jobs, cache, counters, normal_step, static_cast<size_t>(grain)};
+	std::cout << "Serving heights on " << path << " with " << threads << (threads == 1 ? " thread" : " threads") << "\n";
+
+	std::list<Connection> connections;
+	auto last_report = std::chrono::steady_clock::now();
+	unsigned long long last_batches = 0, last_points = 0, last_hits = 0, last_misses = 0;
+	while(!stopping) {
+		pollfd incoming = {listener, POLLIN, 0};
+		if(poll(&incoming, 1, 200) > 0) {
+			int fd = accept(listener, nullptr, nullptr);
+			if(fd != -1) {
+				connections.emplace_back();
+				Connection &connection = connections.back();
+				connection.thread = std::thread([&service, &connection, fd]{
+					serve(service, fd);
+					connection.done = true;
+				});
+			}
+		}
+		for(auto connection=connections.begin();connection!=connections.end();) {
+			if(connection->done) {
+				connection->thread.join();
+				connection = connections.erase(connection);
+			}
+			else
+				++connection;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		double elapsed = std::chrono::duration<double>(now - last_report).count();
+		if(elapsed >= 1.0) {
+			unsigned long long batches = counters.batches, points = counters.points;
+			HeightCache::Stats stats = cache.stats();
+			if(batches != last_batches) {
+				unsigned long long lookups = stats.hits - last_hits + stats.misses - last_misses;
+				std::printf("%zu clients, %.0f batches/s, %.0f points/s, %.1f%% cached, %zu tiles, %llu evicted\n",
+					connections.size(), (batches - last_batches)/elapsed, (points - last_points)/elapsed,
+					lookups ? 100.0*(stats.hits - last_hits)/lookups : 0.0, stats.tiles, stats.evictions);
+				std::fflush(stdout);
+			}
+			last_batches = batches;
+			last_points = points;
+			last_hits = stats.hits;
+			last_misses = stats.misses;
+			last_report = now;
+		}
+	}
+
+	for(auto &connection : connections)
+		connection.thread.join();
+	close(listener);
+	unlink(path.c_str());
+	std::cout << "Answered " << counters.batches << " batches, " << counters.points << " points, refused "
+	          << counters.refused << "\n";
+	return 0;
+}
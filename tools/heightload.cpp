@@ -0,0 +1,158 @@
+// Load generator for heightd: a number of connections each sending batches
+// back to back, reporting points per second and batch latency. Heights of
+// the first batch are checked against the local terrain function.
+//   heightload [--socket=/tmp/infiniterrain-heights.sock] [--connections=4]
+//              [--batch=4096] [--seconds=10] [--normals=1] [--area=20000] [--distinct=0]
+// With --distinct=N the points are drawn from a fixed set of N, so repeated
+// queries can be answered from the server's cache.
+#include <FrameStats/Histogram.hpp>
+#include <HeightService/HeightProtocol.hpp>
+#include <Options/Options.hpp>
+#include <Terrain/Terrain.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+int connect_to(const std::string &path)
+{
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path)-1);
+	if(fd != -1 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+		close(fd);
+		fd = -1;
+	}
+	return fd;
+}
+
+struct Client {
+	Histogram latency;
+	unsigned long long points = 0;
+	float max_error = 0.f;
+	bool failed = false;
+};
+
+}
+
+int main(int argc, char **argv)
+{
+	Options options(argc, argv);
+	std::string path = options.get("socket", "/tmp/infiniterrain-heights.sock");
+	int connections = options.get("connections", 4);
+	int batch = options.get("batch", 4096);
+	float seconds = options.get("seconds", 10.f);
+	bool normals = options.get("normals", 1) != 0;
+	float area = options.get("area", 20000.f);
+	int distinct = options.get("distinct", 0);
+	if(!options.invalid().empty() || connections <= 0 || batch <= 0 || static_cast<uint32_t>(batch) > height_max_count
+	|| seconds <= 0.f || area <= 0.f || distinct < 0) {
+		std::cerr << "usage: " << argv[0] << " [--socket=/tmp/infiniterrain-heights.sock] [--connections=4]\n"
+		          << "       [--batch=4096] [--seconds=10] [--normals=1] [--area=20000] [--distinct=0]\n";
+		return 1;
+	}
+
+	std::vector<float> pool;
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> coordinate(-area, area);
+	for(int i=0;i<2*distinct;++i)
+		pool.push_back(coordinate(random));
+
+	std::vector<Client> clients(connections);
+	std::vector<std::thread> threads;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(seconds)
+	);
+	auto start = std::chrono::steady_clock::now();
+	for(int c=0;c<connections;++c) {
+		threads.emplace_back([&, c]{
+			Client &client = clients[c];
+			int fd = connect_to(path);
+			if(fd == -1) {
+				client.failed = true;
+				return;
+			}
+			std::mt19937 random(c+2);
+			std::uniform_real_distribution<float> coordinate(-area, area);
+			std::uniform_int_distribution<int> pick(0, std::max(distinct-1, 0));
+			std::vector<float> points(2*batch), response(batch*(normals ? 4 : 1));
+			for(uint32_t id=0;std::chrono::steady_clock::now() < deadline;++id) {
+				for(int i=0;i<batch;++i) {
+					if(distinct) {
+						int p = pick(random);
+						points[2*i] = pool[2*p];
+						points[2*i+1] = pool[2*p+1];
+					} else {
+						points[2*i] = coordinate(random);
+						points[2*i+1] = coordinate(random);
+					}
+				}
+				HeightHeader header = {height_magic, height_version, static_cast<uint16_t>(normals ? height_flag_normals : 0), static_cast<uint32_t>(batch), id};
+				auto sent = std::chrono::steady_clock::now();
+				HeightHeader reply;
+				bool ok = write_exact(fd, &header, sizeof(header))
+				       && write_exact(fd, points.data(), points.size()*sizeof(float))
+				       && read_exact(fd, &reply, sizeof(reply))
+				       && reply.id == id && reply.count == header.count
+				       && read_exact(fd, response.data(), response.size()*sizeof(float));
+				if(!ok) {
+					client.failed = true;
+					break;
+				}
+				client.latency.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sent).count());
+				client.points += batch;
+
+				if(id == 0) {
+					std::vector<float> x(batch), y(batch), expected(batch);
+					for(int i=0;i<batch;++i) {
+						x[i] = points[2*i];
+						y[i] = points[2*i+1];
+					}
+					terrain_heights(x.data(), y.data(), expected.data(), batch);
+					for(int i=0;i<batch;++i)
+						client.max_error = std::max(client.max_error, std::abs(response[i] - expected[i]));
+				}
+			}
+			close(fd);
+		});
+	}
+	for(auto &thread : threads)
+		thread.join();
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	Histogram latency;
+	unsigned long long points = 0;
+	float max_error = 0.f;
+	int failed = 0;
+	for(auto &client : clients) {
+		latency.add(client.latency);
+		points += client.points;
+		max_error = std::max(max_error, client.max_error);
+		failed += client.failed;
+	}
+	if(latency.count() == 0) {
+		std::cerr << "No answers from " << path << "\n";
+		return 1;
+	}
+	std::printf("%d connections, batches of %d%s, %.1f s\n", connections, batch, normals ? " with normals" : "", elapsed);
+	std::printf("%.0f points/s, %.0f batches/s\n", points/elapsed, latency.count()/elapsed);
+	std::printf("latency p50 %llu us, p99 %llu us, p99.9 %llu us, max %llu us\n",
+		static_cast<unsigned long long>(latency.percentile(0.5)), static_cast<unsigned long long>(latency.percentile(0.99)),
+		static_cast<unsigned long long>(latency.percentile(0.999)), static_cast<unsigned long long>(latency.max()));
+	std::printf("first batch differs from the local terrain function by at most %g\n", max_error);
+	if(failed)
+		std::printf("%d connections failed\n", failed);
+	return failed ? 1 : 0;
+}
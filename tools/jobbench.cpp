@@ -0,0 +1,142 @@
+// Measures how the job system scales from one worker thread up to N.
+//   jobbench [--threads=N] [--runs=5] [--size=4194304]
+// Each workload is timed serially on the calling thread first; speedups are
+// relative to that.
+#include <Jobs/JobSystem.hpp>
+#include <Options/Options.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Enough arithmetic per element that the loop is not bound by memory.
+float terrain(size_t i)
+{
+	float x = static_cast<float>(i % 2048), y = static_cast<float>(i / 2048);
+	float height = 0.f, amplitude = 1.f, frequency = 0.01f;
+	for(int octave=0;octave<6;++octave) {
+		height += amplitude*std::sin(x*frequency)*std::cos(y*frequency);
+		amplitude *= 0.5f;
+		frequency *= 2.f;
+	}
+	return height;
+}
+
+struct Workload {
+	const char *name;
+	// Runs the workload on jobs, or serially without.
+	std::function<void(JobSystem*)> run;
+};
+
+double median_ms(int runs, const std::function<void()> &run)
+{
+	std::vector<double> times;
+	for(int i=0;i<runs;++i) {
+		auto start = std::chrono::high_resolution_clock::now();
+		run();
+		times.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now()-start).count());
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size()/2];
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	Options options(argc, argv);
+	int max_threads = options.get("threads", static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+	int runs = std::max(1, options.get("runs", 5));
+	int size = options.get("size", 1 << 22);
+	if(!options.invalid().empty() || max_threads <= 0 || size <= 0) {
+		std::cerr << "usage: " << argv[0] << " [--threads=N] [--runs=5] [--size=4194304]\n";
+		return 1;
+	}
+
+	std::vector<float> heights(size);
+	size_t count = heights.size();
+	// Blocks of the graph workload: each is smoothed against its neighbours
+	// once they were generated, then all of them are summed up.
+	const size_t block = 1 << 14;
+	size_t blocks = (count + block - 1)/block;
+	std::vector<float> smoothed(count);
+	std::vector<double> sums(blocks);
+	double total = 0.0;
+
+	auto generate = [&](size_t first, size_t last) {
+		for(size_t i=first;i<last;++i)
+			heights[i] = terrain(i);
+	};
+	auto smooth = [&](size_t b) {
+		size_t first = b*block, last = std::min(count, first+block);
+		double sum = 0.0;
+		for(size_t i=first;i<last;++i) {
+			float left = heights[i > 0 ? i-1 : i], right = heights[i+1 < count ? i+1 : i];
+			smoothed[i] = 0.25f*left + 0.5f*heights[i] + 0.25f*right;
+			sum += smoothed[i];
+		}
+		sums[b] = sum;
+	};
+	auto reduce = [&] {
+		total = 0.0;
+		for(double sum : sums)
+			total += sum;
+	};
+	std::atomic<unsigned long long> touched{0};
+
+	std::vector<Workload> workloads = {
+		{"parallel_for, 16K grain", [&](JobSystem *jobs) {
+			if(jobs)
+				jobs->parallel_for(0, count, 1 << 14, generate);
+			else
+				generate(0, count);
+		}},
+		{"task graph", [&](JobSystem *jobs) {
+			if(!jobs) {
+				generate(0, count);
+				for(size_t b=0;b<blocks;++b)
+					smooth(b);
+				reduce();
+				return;
+			}
+			std::vector<JobSystem::Task> generated(blocks), smoothing(blocks);
+			for(size_t b=0;b<blocks;++b)
+				generated[b] = jobs->spawn([&, b]{generate(b*block, std::min(count, (b+1)*block));});
+			for(size_t b=0;b<blocks;++b) {
+				smoothing[b] = jobs->spawn([&, b]{smooth(b);}, {
+					b > 0 ? generated[b-1] : nullptr, generated[b], b+1 < blocks ? generated[b+1] : nullptr
+				});
+			}
+			jobs->wait(jobs->spawn(reduce, smoothing));
+		}},
+		{"parallel_for, empty bodies", [&](JobSystem *jobs) {
+			auto touch = [&](size_t first, size_t last) {touched += last-first;};
+			if(jobs)
+				jobs->parallel_for(0, 1 << 16, 1, touch);
+			else
+				for(size_t i=0;i<(1 << 16);++i)
+					touch(i, i+1);
+		}},
+	};
+
+	std::printf("%zu elements, median of %d runs\n", count, runs);
+	for(auto &workload : workloads) {
+		double serial = median_ms(runs, [&]{workload.run(nullptr);});
+		std::printf("\n%s\n%-10s %9.2f ms\n", workload.name, "serial", serial);
+		for(int threads=1;threads<=max_threads;++threads) {
+			JobSystem jobs(threads);
+			double ms = median_ms(runs, [&]{workload.run(&jobs);});
+			std::string name = std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+			std::printf("%-10s %9.2f ms %6.2fx %5.0f%%\n", name.c_str(), ms, serial/ms, 100.0*serial/ms/threads);
+		}
+	}
+	return 0;
+}
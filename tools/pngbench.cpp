@@ -0,0 +1,125 @@
+// Compares PngWriter against stbi_write_png on a synthetic frame.
+//   pngbench [--width=3840] [--height=2160] [--runs=5] [--threads=N] [--out=/tmp]
+#include <PngWriter/PngWriter.hpp>
+#include <Options/Options.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "ext/stb_image_write.h"
+
+namespace {
+
+// Something that compresses roughly like a rendered frame: a smooth sky over
+// shaded, noisy terrain.
+std::vector<uint8_t> make_frame(int width, int height)
+{
+	std::vector<uint8_t> pixels(static_cast<size_t>(width)*height*4);
+	uint32_t seed = 1;
+	for(int y=0;y<height;++y) {
+		for(int x=0;x<width;++x) {
+			uint8_t *p = &pixels[(static_cast<size_t>(y)*width+x)*4];
+			float u = static_cast<float>(x)/width, v = static_cast<float>(y)/height;
+			float horizon = 0.35f + 0.08f*std::sin(u*17.f) + 0.03f*std::sin(u*71.f+1.f);
+			seed = seed*1664525u + 1013904223u;
+			int noise = static_cast<int>(seed >> 28) - 8;
+			if(v < horizon) {
+				p[0] = static_cast<uint8_t>(90 + 80*v);
+				p[1] = static_cast<uint8_t>(140 + 60*v);
+				p[2] = 230;
+			} else {
+				float shade = 0.6f + 0.4f*std::sin(u*40.f + v*90.f)*std::cos(v*25.f);
+				p[0] = static_cast<uint8_t>(std::clamp(static_cast<int>(70*shade) + noise, 0, 255));
+				p[1] = static_cast<uint8_t>(std::clamp(static_cast<int>(110*shade) + noise, 0, 255));
+				p[2] = static_cast<uint8_t>(std::clamp(static_cast<int>(50*shade) + noise/2, 0, 255));
+			}
+			p[3] = 255;
+		}
+	}
+	return pixels;
+}
+
+long long file_size(const std::string &path)
+{
+	std::FILE *f = std::fopen(path.c_str(), "rb");
+	if(!f)
+		return -1;
+	std::fseek(f, 0, SEEK_END);
+	long long size = std::ftell(f);
+	std::fclose(f);
+	return size;
+}
+
+void run(const std::string &name, const std::string &path, int runs, size_t raw_bytes, const std::function<bool()> &encode)
+{
+	std::vector<double> times;
+	for(int i=0;i<runs;++i) {
+		auto start = std::chrono::high_resolution_clock::now();
+		if(!encode()) {
+			std::cerr << name << ": encoding failed\n";
+			return;
+		}
+		times.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now()-start).count());
+	}
+	std::sort(times.begin(), times.end());
+	double median = times[times.size()/2];
+	long long size = file_size(path);
+	std::printf("%-32s %9.1f ms %8.1f MB/s %10.2f MB  %5.1f%%\n",
+		name.c_str(), median, raw_bytes/median/1e3, size/1e6, 100.0*size/raw_bytes);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	Options options(argc, argv);
+	int width = options.get("width", 3840);
+	int height = options.get("height", 2160);
+	int runs = std::max(1, options.get("runs", 5));
+	int threads = options.get("threads", static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+	std::string out = options.get("out", "/tmp");
+	if(!options.invalid().empty() || width <= 0 || height <= 0 || threads <= 0) {
+		std::cerr << "usage: " << argv[0] << " [--width=3840] [--height=2160] [--runs=5] [--threads=N] [--out=/tmp]\n";
+		return 1;
+	}
+
+	std::vector<uint8_t> pixels = make_frame(width, height);
+	size_t raw_bytes = pixels.size();
+	std::printf("%dx%d RGBA, %.1f MB raw, median of %d runs\n", width, height, raw_bytes/1e6, runs);
+
+	std::string path = out + "/pngbench_stb.png";
+	run("stbi_write_png", path, runs, raw_bytes, [&]{
+		return stbi_write_png(path.c_str(), width, height, 4, pixels.data(), 0) != 0;
+	});
+
+	JobSystem jobs(threads);
+	PngSettings fast;
+	fast.filter = PngFilter::none;
+	fast.level = 1;
+	struct Config {
+		const char *name;
+		PngSettings settings;
+		JobSystem *jobs;
+	};
+	std::vector<Config> configs = {
+		{"PngWriter adaptive, 1 thread", PngSettings(), nullptr},
+		{"PngWriter adaptive", PngSettings(), &jobs},
+		{"PngWriter fast, 1 thread", fast, nullptr},
+		{"PngWriter fast", fast, &jobs},
+	};
+	for(auto &config : configs) {
+		std::string name = config.name;
+		if(config.jobs)
+			name += ", " + std::to_string(threads) + (threads == 1 ? " thread pool" : " threads");
+		path = out + "/pngbench_" + std::to_string(&config - configs.data()) + ".png";
+		run(name, path, runs, raw_bytes, [&]{
+			return write_png(path, width, height, 4, pixels.data(), config.settings, config.jobs);
+		});
+	}
+	return 0;
+}
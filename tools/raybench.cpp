@@ -0,0 +1,124 @@
+// Rays per second of TerrainRaycast at different ray lengths, on one thread
+// and across the job system, against marching the height function in small
+// steps.
+//   raybench [--rays=20000] [--threads=N] [--area=2000] [--spacing=2] [--cells=256]
+//            [--regions=256] [--march-rays=200]
+// Rays start 2 units above the ground anywhere in [-area, area]^2 and look
+// out at a slight downward or upward angle, like line of sight checks
+// between units.
+#include <Jobs/JobSystem.hpp>
+#include <Options/Options.hpp>
+#include <Raycast/TerrainRaycast.hpp>
+#include <Terrain/Terrain.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::vector<TerrainRay> make_rays(size_t count, float area, float distance, unsigned seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> position(-area, area), azimuth(0.f, 6.2831853f), pitch(-0.15f, 0.05f);
+	std::vector<TerrainRay> rays(count);
+	for(auto &ray : rays) {
+		float x = position(random), y = position(random);
+		float a = azimuth(random), p = pitch(random);
+		ray = {
+			{x, y, std::max(terrain_height(x, y), terrain_water_level) + 2.f},
+			{std::cos(a)*std::cos(p), std::sin(a)*std::cos(p), std::sin(p)},
+			distance
+		};
+	}
+	return rays;
+}
+
+// The slow way: sample the height function every step along the ray.
+TerrainHit march(const TerrainRay &ray, float step)
+{
+	TerrainHit hit{};
+	for(float t=0.f;t<=ray.max_distance;t+=step) {
+		float x = ray.origin[0] + ray.direction[0]*t, y = ray.origin[1] + ray.direction[1]*t;
+		if(ray.origin[2] + ray.direction[2]*t <= terrain_height(x, y)) {
+			hit.hit = true;
+			hit.distance = t;
+			break;
+		}
+	}
+	return hit;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	Options options(argc, argv);
+	int count = options.get("rays", 20000);
+	int threads = options.get("threads", static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+	float area = options.get("area", 2000.f);
+	TerrainRaycast::Settings settings;
+	settings.spacing = options.get("spacing", 2.f);
+	settings.region_cells = options.get("cells", 256);
+	settings.max_regions = options.get("regions", 256);
+	int march_count = options.get("march-rays", 200);
+	if(!options.invalid().empty() || count <= 0 || threads <= 0 || area <= 0.f || settings.spacing <= 0.f || march_count < 0) {
+		std::cerr << "usage: " << argv[0] << " [--rays=20000] [--threads=N] [--area=2000] [--spacing=2] [--cells=256]\n"
+		          << "       [--regions=256] [--march-rays=200]\n";
+		return 1;
+	}
+
+	JobSystem jobs(threads);
+	std::printf("%d rays per length, %d job threads, %g unit cells, %u cells per region, up to %zu regions\n\n",
+		count, threads, settings.spacing, settings.region_cells, settings.max_regions);
+	std::printf("%8s %8s %12s %12s %12s %7s %9s %9s %12s %8s\n",
+		"length", "regions", "cold rays/s", "1 thread", "jobs", "hits", "nodes/ray", "cells/ray", "march rays/s", "agree");
+	for(float distance : {100.f, 1000.f, 5000.f, 20000.f}) {
+		// A fresh caster each time, so the cold pass builds its regions.
+		TerrainRaycast caster(settings);
+		std::vector<TerrainRay> rays = make_rays(count, area, distance, static_cast<unsigned>(distance));
+		std::vector<TerrainHit> hits(rays.size());
+
+		auto start = std::chrono::steady_clock::now();
+		caster.cast(rays.data(), hits.data(), hits.size(), &jobs);
+		double cold = seconds_since(start);
+
+		TerrainRaycast::Stats before = caster.stats();
+		start = std::chrono::steady_clock::now();
+		caster.cast(rays.data(), hits.data(), hits.size());
+		double serial = seconds_since(start);
+		TerrainRaycast::Stats after = caster.stats();
+
+		start = std::chrono::steady_clock::now();
+		caster.cast(rays.data(), hits.data(), hits.size(), &jobs);
+		double parallel = seconds_since(start);
+
+		size_t hit_count = std::count_if(hits.begin(), hits.end(), [](const TerrainHit &hit){return hit.hit;});
+		// Marching only agrees up to its step and the grid's triangulation,
+		// so hits count as agreeing within a few steps.
+		size_t marched = std::min<size_t>(march_count, rays.size()), agree = 0;
+		float step = settings.spacing*0.5f;
+		start = std::chrono::steady_clock::now();
+		for(size_t i=0;i<marched;++i) {
+			TerrainHit slow = march(rays[i], step);
+			agree += slow.hit == hits[i].hit && (!slow.hit || std::abs(slow.distance - hits[i].distance) < 4.f*settings.spacing);
+		}
+		double march_seconds = seconds_since(start);
+
+		std::printf("%8.0f %8llu %12.0f %12.0f %12.0f %6.1f%% %9.1f %9.1f %12.0f %7.1f%%\n",
+			distance, before.regions_built, count/cold, count/serial, count/parallel, 100.0*hit_count/count,
+			static_cast<double>(after.nodes_visited - before.nodes_visited)/count,
+			static_cast<double>(after.cells_tested - before.cells_tested)/count,
+			marched ? marched/march_seconds : 0.0, marched ? 100.0*agree/marched : 0.0);
+	}
+	return 0;
+}
@@ -0,0 +1,183 @@
+// Bakes the terrain height function into a tile file (TileFile.hpp) on all
+// cores, then spot-checks the result through a TileCache.
+//   tilebake [--out=terrain.tiles] [--x0=-8192] [--y0=-8192] [--x1=8192] [--y1=8192]
+//            [--min-lod=0] [--max-lod=4] [--tile-size=257] [--spacing=10]
+//            [--format=u16|f32] [--threads=N] [--check=10000]
+#include <Jobs/JobSystem.hpp>
+#include <Options/Options.hpp>
+#include <Terrain/Terrain.hpp>
+#include <TileCache/TileCache.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+uint64_t round_up(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1)/alignment*alignment;
+}
+
+bool write_all(int fd, const void *data, size_t size, uint64_t offset)
+{
+	const char *bytes = static_cast<const char*>(data);
+	while(size > 0) {
+		ssize_t written = pwrite(fd, bytes, size, offset);
+		if(written <= 0)
+			return false;
+		bytes += written;
+		size -= written;
+		offset += written;
+	}
+	return true;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	Options options(argc, argv);
+	std::string out = options.get("out", "terrain.tiles");
+	float x0 = options.get("x0", -8192.f), y0 = options.get("y0", -8192.f);
+	float x1 = options.get("x1", 8192.f), y1 = options.get("y1", 8192.f);
+	int min_lod = options.get("min-lod", 0), max_lod = options.get("max-lod", 4);
+	int tile_size = options.get("tile-size", 257);
+	float spacing = options.get("spacing", 10.f);
+	std::string format_name = options.get("format", "u16");
+	int threads = options.get("threads", static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+	int checks = options.get("check", 10000);
+	if(!options.invalid().empty() || x1 <= x0 || y1 <= y0 || min_lod < 0 || max_lod < min_lod || max_lod > 20
+	|| tile_size < 2 || tile_size > 4097 || spacing <= 0.f || threads <= 0 || checks < 0
+	|| (format_name != "u16" && format_name != "f32")) {
+		std::cerr << "usage: " << argv[0] << " [--out=terrain.tiles] [--x0=-8192] [--y0=-8192] [--x1=8192] [--y1=8192]\n"
+		          << "       [--min-lod=0] [--max-lod=4] [--tile-size=257] [--spacing=10]\n"
+		          << "       [--format=u16|f32] [--threads=N] [--check=10000]\n";
+		return 1;
+	}
+	TileFormat format = format_name == "u16" ? TileFormat::u16 : TileFormat::f32;
+
+	TileFileHeader header{};
+	std::memcpy(header.magic, tile_file_magic, sizeof(tile_file_magic));
+	header.version = tile_file_version;
+	header.format = format;
+	header.tile_size = tile_size;
+	header.min_lod = min_lod;
+	header.max_lod = max_lod;
+	header.spacing = spacing;
+	header.origin_x = x0;
+	header.origin_y = y0;
+	header.page_size = tile_file_page_size;
+	header.index_offset = round_up(sizeof(TileFileHeader), alignof(TileEntry));
+
+	// Every LOD covers the whole region, with tiles half as many per side
+	// as the LOD below.
+	std::vector<TileEntry> index;
+	for(int lod=min_lod;lod<=max_lod;++lod) {
+		double span = std::ldexp(static_cast<double>(spacing), lod)*(tile_size-1);
+		int columns = static_cast<int>(std::ceil((x1-x0)/span)), rows = static_cast<int>(std::ceil((y1-y0)/span));
+		for(int y=0;y<rows;++y)
+			for(int x=0;x<columns;++x)
+				index.push_back({x, y, static_cast<uint32_t>(lod), 0, 0.f, 0.f, 0});
+	}
+	size_t samples = static_cast<size_t>(tile_size)*tile_size;
+	size_t data_bytes = samples*tile_sample_bytes(format);
+	header.tile_count = index.size();
+	header.tile_stride = round_up(data_bytes, header.page_size);
+	uint64_t data_offset = round_up(header.index_offset + index.size()*sizeof(TileEntry), header.page_size);
+	for(size_t i=0;i<index.size();++i)
+		index[i].offset = data_offset + i*header.tile_stride;
+	header.size = data_offset + index.size()*header.tile_stride;
+
+	int fd = ::open(out.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd == -1 || ftruncate(fd, header.size) != 0) {
+		std::cerr << "Could not create " << out << "\n";
+		return 1;
+	}
+	std::printf("Baking %zu tiles of %dx%d %s samples, LOD %d to %d, %.1f MB\n",
+		index.size(), tile_size, tile_size, format_name.c_str(), min_lod, max_lod, header.size/1e6);
+
+	auto start = std::chrono::steady_clock::now();
+	std::atomic<bool> failed{false};
+	{
+		JobSystem jobs(threads);
+		jobs.parallel_for(0, index.size(), 1, [&](size_t first, size_t last) {
+			std::vector<float> heights(samples);
+			std::vector<uint16_t> quantised(format == TileFormat::u16 ? samples : 0);
+			for(size_t i=first;i<last;++i) {
+				TileEntry &entry = index[i];
+				float step = std::ldexp(spacing, entry.lod);
+				int64_t first_x = static_cast<int64_t>(entry.x)*(tile_size-1), first_y = static_cast<int64_t>(entry.y)*(tile_size-1);
+				float low = INFINITY, high = -INFINITY;
+				for(int y=0;y<tile_size;++y) {
+					float py = y0 + (first_y + y)*step;
+					for(int x=0;x<tile_size;++x) {
+						float height = terrain_height(x0 + (first_x + x)*step, py);
+						heights[static_cast<size_t>(y)*tile_size + x] = height;
+						low = std::min(low, height);
+						high = std::max(high, height);
+					}
+				}
+				entry.min = low;
+				entry.max = high;
+
+				const void *data = heights.data();
+				if(format == TileFormat::u16) {
+					float scale = high > low ? 65535.f/(high - low) : 0.f;
+					for(size_t s=0;s<samples;++s)
+						quantised[s] = static_cast<uint16_t>(std::lround((heights[s] - low)*scale));
+					data = quantised.data();
+				}
+				if(!write_all(fd, data, data_bytes, entry.offset))
+					failed = true;
+			}
+		});
+	}
+	bool ok = !failed
+	       && write_all(fd, &header, sizeof(header), 0)
+	       && write_all(fd, index.data(), index.size()*sizeof(TileEntry), header.index_offset);
+	ok = ::close(fd) == 0 && ok;
+	if(!ok) {
+		std::cerr << "Could not write " << out << "\n";
+		std::remove(out.c_str());
+		return 1;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::printf("%.2f s on %d thread%s, %.1f tiles/s, %.2f Msamples/s\n",
+		seconds, threads, threads == 1 ? "" : "s", index.size()/seconds, index.size()*samples/seconds/1e6);
+
+	if(checks == 0)
+		return 0;
+	TileCache cache;
+	std::string error;
+	if(!cache.open(out, 64, error)) {
+		std::cerr << error << "\n";
+		return 1;
+	}
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> along_x(x0, x1), along_y(y0, y1);
+	float step = std::ldexp(spacing, min_lod), max_error = 0.f;
+	for(int i=0;i<checks;++i) {
+		// Sample positions, where the baked value is exact up to quantisation.
+		float x = x0 + std::floor((along_x(random) - x0)/step)*step;
+		float y = y0 + std::floor((along_y(random) - y0)/step)*step;
+		float height;
+		if(!cache.height(x, y, min_lod, height)) {
+			std::cerr << "No tile at " << x << ", " << y << "\n";
+			return 1;
+		}
+		max_error = std::max(max_error, std::abs(height - terrain_height(x, y)));
+	}
+	TileCache::Stats stats = cache.stats();
+	std::printf("Checked %d samples at LOD %d: max error %.4f, %llu tile hits, %llu maps, %llu evictions\n",
+		checks, min_lod, max_error, stats.hits, stats.misses, stats.evictions);
+	return 0;
+}